@@ -0,0 +1,66 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+#define LIBRE_ARENA_ALIGNMENT 64
+
+typedef struct libre_allocator
+{
+    void *(*alloc)(void *user, size_t size);
+    void (*free)(void *user, void *pointer);
+    void *user;
+} libre_allocator_t;
+
+/*
+Bump-pointer arena for memory that lives for one frame. Allocations are aligned to LIBRE_ARENA_ALIGNMENT
+by default, freeing a single allocation does nothing and libre_arena_reset releases everything at once.
+*/
+typedef struct libre_arena
+{
+    unsigned char *data;
+    void *block;
+    size_t size, offset, peak;
+    libre_allocator_t allocator;
+} libre_arena_t;
+
+int libre_arena_create(libre_arena_t *arena, size_t size);
+void *libre_arena_alloc(libre_arena_t *arena, size_t size, size_t alignment);
+void libre_arena_reset(libre_arena_t *arena);
+void libre_arena_destroy(libre_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "opengl.h"
+
+typedef struct libre_atlas_node
+{
+    int x, y, width;
+} libre_atlas_node_t;
+
+/*
+Bottom left skyline over a width by height area. It only does the bookkeeping, so it can also lay out rectangles that
+never end up in a texture.
+*/
+typedef struct libre_atlas_skyline
+{
+    int width, height;
+    libre_atlas_node_t *nodes;
+    int node_count;
+    long used;
+} libre_atlas_skyline_t;
+
+/*
+Handles keep the slot in the low LIBRE_ATLAS_SLOT_BITS bits and the serial of the slot above them. The serial is
+bumped whenever the slot is released, so a stale handle stops matching once its slot is reused.
+*/
+#define LIBRE_ATLAS_SLOT_BITS 20
+#define LIBRE_ATLAS_SLOT_MASK ((1 << LIBRE_ATLAS_SLOT_BITS) - 1)
+#define LIBRE_ATLAS_SERIAL_MASK ((1 << (31 - LIBRE_ATLAS_SLOT_BITS)) - 1)
+
+typedef struct libre_atlas_entry
+{
+    int x, y, width, height;
+    int serial;
+    bool live;
+    uint64_t last_used;
+    uint8_t *pixels;
+} libre_atlas_entry_t;
+
+typedef struct libre_atlas_rect
+{
+    float u0, v0, u1, v1;
+} libre_atlas_rect_t;
+
+/*
+Images are packed with a bottom left skyline into one texture and keep a cpu copy, which is used to repack the atlas
+when it fills up. Repacking moves images, so uvs have to be looked up again whenever generation changes. A repack
+only replaces the layout when every live image fits into it. When repacking is not enough, images not touched
+during the current frame are evicted, least recently used first.
+*/
+typedef struct libre_atlas
+{
+    libre_opengl_texture_t texture;
+    int width, height, padding, channels;
+    bool evict;
+
+    libre_atlas_skyline_t skyline;
+
+    libre_atlas_entry_t *entries;
+    int entry_count, entry_capacity;
+
+    uint64_t frame, generation;
+} libre_atlas_t;
+
+int libre_atlas_skyline(int width, int height, libre_atlas_skyline_t *skyline);
+void libre_atlas_skyline_reset(libre_atlas_skyline_t *skyline);
+int libre_atlas_skyline_pack(libre_atlas_skyline_t *skyline, int width, int height, int *x, int *y);
+void libre_atlas_skyline_destroy(libre_atlas_skyline_t *skyline);
+
+int libre_atlas(libre_window_t window, int width, int height, GLenum internal_format, int padding, GLint filter, bool evict, libre_atlas_t *atlas);
+int libre_atlas_add(libre_atlas_t *atlas, int width, int height, const uint8_t *pixels);
+bool libre_atlas_contains(const libre_atlas_t *atlas, int handle);
+int libre_atlas_uv(libre_atlas_t *atlas, int handle, libre_atlas_rect_t *uv);
+void libre_atlas_remove(libre_atlas_t *atlas, int handle);
+int libre_atlas_defragment(libre_atlas_t *atlas);
+void libre_atlas_frame(libre_atlas_t *atlas);
+void libre_atlas_destroy(libre_atlas_t *atlas);
+
+#ifdef __cplusplus
+}
+#endif
@@ -33,18 +33,69 @@ extern "C"
 {
 #endif
 
+#include "arena.h"
+
 #define LIBRE_MATRIX_TYPE float
 
+#define LIBRE_MATRIX_UNINITIALIZED 1
+
 typedef struct libre_matrix
 {
    int rows, columns;
    LIBRE_MATRIX_TYPE *data;
+   const libre_allocator_t *allocator;
 } libre_matrix_t;
 
 #define LIBRE_MATRIX_GET(matrix, i, j) ((matrix).data[i * (matrix).columns + j])
 #define LIBRE_MATRIX_SET(matrix, i, j, x) ((matrix).data[i * (matrix).columns + j] = x)
 
+#define LIBRE_MATRIX_ISA_SCALAR 0
+#define LIBRE_MATRIX_ISA_SSE 1
+#define LIBRE_MATRIX_ISA_AVX2 2
+#define LIBRE_MATRIX_ISA_NEON 3
+
+#if defined(_MSC_VER)
+#define LIBRE_MATRIX_ALIGN(x) __declspec(align(x))
+#else
+#define LIBRE_MATRIX_ALIGN(x) __attribute__((aligned(x)))
+#endif
+
+/*
+Fixed-size value types. These use the same row-major layout as libre_matrix_t.data, never touch the heap and can be
+passed around by value.
+*/
+typedef struct libre_vec3
+{
+   LIBRE_MATRIX_TYPE x, y, z;
+} libre_vec3_t;
+
+typedef struct libre_vec4
+{
+   LIBRE_MATRIX_ALIGN(16) LIBRE_MATRIX_TYPE x;
+   LIBRE_MATRIX_TYPE y, z, w;
+} libre_vec4_t;
+
+typedef struct libre_mat3
+{
+   LIBRE_MATRIX_ALIGN(16) LIBRE_MATRIX_TYPE data[9];
+} libre_mat3_t;
+
+typedef struct libre_mat4
+{
+   LIBRE_MATRIX_ALIGN(16) LIBRE_MATRIX_TYPE data[16];
+} libre_mat4_t;
+
+int libre_matrix_isa(void);
+int libre_matrix_set_isa(int isa);
+
 int libre_matrix_create(libre_matrix_t *matrix, int rows, int columns);
+int libre_matrix_create_ex(libre_matrix_t *matrix, int rows, int columns, const libre_allocator_t *allocator, int flags);
+/*
+Allocator used by libre_matrix_create and by every function that creates its result, per thread. NULL means
+malloc and free.
+*/
+void libre_matrix_set_allocator(const libre_allocator_t *allocator);
+const libre_allocator_t *libre_matrix_get_allocator(void);
 void libre_matrix_destroy(libre_matrix_t matrix);
 void libre_matrix_print(libre_matrix_t matrix);
 libre_matrix_t libre_matrix_copy(libre_matrix_t matrix, int *result);
@@ -57,6 +108,40 @@ libre_matrix_t libre_matrix_projection_ortho(LIBRE_MATRIX_TYPE l, LIBRE_MATRIX_T
 libre_matrix_t libre_matrix_translation(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result);
 libre_matrix_t libre_matrix_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result);
 
+/*
+Batched 4x4 operations over contiguous arrays in the libre_matrix_t.data layout (row-major, 16 floats per
+matrix). libre_mat4_t arrays can be passed directly. Outputs may alias the inputs, including the shared matrix, it
+is read once before any output is written.
+*/
+int libre_matrix_batch_multiply(const LIBRE_MATRIX_TYPE *a, const LIBRE_MATRIX_TYPE *b, LIBRE_MATRIX_TYPE *destination, int count);
+int libre_matrix_batch_transform4(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *vectors, LIBRE_MATRIX_TYPE *destination, int count);
+int libre_matrix_batch_transform3(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *positions, LIBRE_MATRIX_TYPE *destination, int count);
+int libre_matrix_batch_transform_soa(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *x, const LIBRE_MATRIX_TYPE *y, const LIBRE_MATRIX_TYPE *z, LIBRE_MATRIX_TYPE *tx, LIBRE_MATRIX_TYPE *ty, LIBRE_MATRIX_TYPE *tz, LIBRE_MATRIX_TYPE *tw, int count);
+
+libre_vec3_t libre_vec3(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z);
+libre_vec4_t libre_vec4(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, LIBRE_MATRIX_TYPE w);
+
+libre_mat3_t libre_mat3_identity(void);
+libre_mat3_t libre_mat3_from_mat4(libre_mat4_t matrix);
+int libre_mat3_from_matrix(libre_matrix_t matrix, libre_mat3_t *destination);
+libre_matrix_t libre_mat3_to_matrix(libre_mat3_t matrix, libre_matrix_t *destination, int *result);
+libre_mat3_t libre_mat3_add(libre_mat3_t a, libre_mat3_t b);
+libre_mat3_t libre_mat3_scale(libre_mat3_t matrix, LIBRE_MATRIX_TYPE factor);
+libre_mat3_t libre_mat3_multiply(libre_mat3_t a, libre_mat3_t b);
+libre_vec3_t libre_mat3_transform(libre_mat3_t matrix, libre_vec3_t vector);
+
+libre_mat4_t libre_mat4_identity(void);
+int libre_mat4_from_matrix(libre_matrix_t matrix, libre_mat4_t *destination);
+libre_matrix_t libre_mat4_to_matrix(libre_mat4_t matrix, libre_matrix_t *destination, int *result);
+libre_mat4_t libre_mat4_add(libre_mat4_t a, libre_mat4_t b);
+libre_mat4_t libre_mat4_scale(libre_mat4_t matrix, LIBRE_MATRIX_TYPE factor);
+libre_mat4_t libre_mat4_multiply(libre_mat4_t a, libre_mat4_t b);
+libre_vec4_t libre_mat4_transform(libre_mat4_t matrix, libre_vec4_t vector);
+
+libre_mat4_t libre_mat4_projection_ortho(LIBRE_MATRIX_TYPE l, LIBRE_MATRIX_TYPE r, LIBRE_MATRIX_TYPE t, LIBRE_MATRIX_TYPE b, LIBRE_MATRIX_TYPE n, LIBRE_MATRIX_TYPE f);
+libre_mat4_t libre_mat4_translation(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z);
+libre_mat4_t libre_mat4_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z);
+
 #ifdef __cplusplus
 }
 #endif
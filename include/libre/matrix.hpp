@@ -0,0 +1,606 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "matrix.h"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/*
+Header-only C++ wrapper over libre_matrix_t. Arithmetic builds expression objects that are evaluated once,
+element by element, when they are assigned, so chains like s * A + B or A * B + C need no temporaries.
+fixed_matrix<R, C> has its dimensions at compile time and lives on the stack, which lets 4x4 chains unroll
+completely. Operands of a product that are themselves expressions are evaluated first, into a
+fixed_matrix when their size is known at compile time and into a heap matrix otherwise.
+*/
+namespace libre
+{
+    typedef LIBRE_MATRIX_TYPE scalar;
+
+    static const int dynamic = -1;
+
+    template <typename Derived>
+    class expression
+    {
+    public:
+        const Derived &derived() const { return static_cast<const Derived &>(*this); }
+    };
+
+    template <int Rows, int Columns>
+    class fixed_matrix;
+    class matrix;
+    template <typename Left, typename Right>
+    class sum;
+    template <typename Left, typename Right>
+    class difference;
+    template <typename Expression>
+    class scaled;
+    template <typename Left, typename Right>
+    class product;
+
+    template <typename T>
+    struct traits;
+
+    template <int Rows, int Columns>
+    struct traits<fixed_matrix<Rows, Columns>>
+    {
+        static const int rows = Rows, columns = Columns;
+        static const bool leaf = true, has_product = false;
+    };
+
+    template <>
+    struct traits<matrix>
+    {
+        static const int rows = dynamic, columns = dynamic;
+        static const bool leaf = true, has_product = false;
+    };
+
+    namespace detail
+    {
+        template <int A, int B>
+        struct merge
+        {
+            static_assert(A == dynamic || B == dynamic || A == B, "libre: matrix dimensions do not match");
+            static const int value = A != dynamic ? A : B;
+        };
+
+        template <typename Left, typename Right>
+        struct elementwise_traits
+        {
+            static const int rows = merge<traits<Left>::rows, traits<Right>::rows>::value;
+            static const int columns = merge<traits<Left>::columns, traits<Right>::columns>::value;
+            static const bool leaf = false, has_product = traits<Left>::has_product || traits<Right>::has_product;
+        };
+
+        template <typename T>
+        struct plain
+        {
+            typedef typename std::conditional<traits<T>::rows != dynamic && traits<T>::columns != dynamic, fixed_matrix<traits<T>::rows, traits<T>::columns>, matrix>::type type;
+        };
+
+        // leaves are held by reference, expressions by value so that they outlive the full expression
+        template <typename T>
+        struct stored
+        {
+            typedef typename std::conditional<traits<T>::leaf, const T &, T>::type type;
+        };
+
+        // product operands are read many times, so anything that is not a leaf is evaluated once up front
+        template <typename T>
+        struct evaluated
+        {
+            typedef typename std::conditional<traits<T>::leaf, const T &, typename plain<T>::type>::type type;
+        };
+
+        template <int K>
+        struct dot
+        {
+            template <typename Left, typename Right>
+            static scalar run(const Left &left, const Right &right, int i, int j, int inner)
+            {
+                return dot<K - 1>::run(left, right, i, j, inner) + left(i, K - 1) * right(K - 1, j);
+            }
+        };
+
+        template <>
+        struct dot<0>
+        {
+            template <typename Left, typename Right>
+            static scalar run(const Left &, const Right &, int, int, int)
+            {
+                return 0;
+            }
+        };
+
+        template <>
+        struct dot<dynamic>
+        {
+            template <typename Left, typename Right>
+            static scalar run(const Left &left, const Right &right, int i, int j, int inner)
+            {
+                scalar value = 0;
+                for (int k = 0; k < inner; k++)
+                    value += left(i, k) * right(k, j);
+                return value;
+            }
+        };
+
+        template <int Columns, int N>
+        struct unroll
+        {
+            template <typename Expression>
+            static void run(scalar *destination, const Expression &expression)
+            {
+                unroll<Columns, N - 1>::run(destination, expression);
+                destination[N - 1] = expression((N - 1) / Columns, (N - 1) % Columns);
+            }
+        };
+
+        template <int Columns>
+        struct unroll<Columns, 0>
+        {
+            template <typename Expression>
+            static void run(scalar *, const Expression &)
+            {
+            }
+        };
+
+        template <typename Destination, typename Expression>
+        void evaluate(Destination &destination, const Expression &expression, std::true_type)
+        {
+            unroll<traits<Destination>::columns, traits<Destination>::rows * traits<Destination>::columns>::run(destination.data(), expression);
+        }
+
+        template <typename Destination, typename Expression>
+        void evaluate(Destination &destination, const Expression &expression, std::false_type)
+        {
+            scalar *data = destination.data();
+            int rows = destination.rows(), columns = destination.columns();
+
+            for (int i = 0; i < rows; i++)
+                for (int j = 0; j < columns; j++)
+                    data[i * columns + j] = expression(i, j);
+        }
+
+        template <typename Destination, typename Expression>
+        void evaluate(Destination &destination, const Expression &expression)
+        {
+            static const bool small = traits<Destination>::rows != dynamic && traits<Destination>::rows * traits<Destination>::columns <= 16;
+            evaluate(destination, expression, std::integral_constant<bool, small>());
+        }
+
+        template <typename Destination, typename Expression>
+        void assign(Destination &destination, const Expression &expression);
+    }
+
+    template <int Rows, int Columns>
+    class fixed_matrix : public expression<fixed_matrix<Rows, Columns>>
+    {
+        static_assert(Rows > 0 && Columns > 0, "libre: fixed_matrix dimensions must be positive");
+
+    public:
+        fixed_matrix()
+        {
+            std::memset(data_, 0, sizeof(data_));
+        }
+
+        explicit fixed_matrix(const scalar *data)
+        {
+            std::memcpy(data_, data, sizeof(data_));
+        }
+
+        template <typename Expression>
+        fixed_matrix(const expression<Expression> &other)
+        {
+            *this = other;
+        }
+
+        template <typename Expression>
+        fixed_matrix &operator=(const expression<Expression> &other)
+        {
+            detail::assign(*this, other.derived());
+            return *this;
+        }
+
+        static fixed_matrix identity()
+        {
+            fixed_matrix result;
+            for (int i = 0; i < Rows && i < Columns; i++)
+                result(i, i) = 1;
+            return result;
+        }
+
+        int rows() const { return Rows; }
+        int columns() const { return Columns; }
+
+        scalar operator()(int i, int j) const { return data_[i * Columns + j]; }
+        scalar &operator()(int i, int j) { return data_[i * Columns + j]; }
+
+        const scalar *data() const { return data_; }
+        scalar *data() { return data_; }
+
+        bool references(const scalar *data) const { return data == data_; }
+
+        // a non-owning view for the C API, it must not be passed to libre_matrix_destroy
+        libre_matrix_t view()
+        {
+            libre_matrix_t matrix = {Rows, Columns, data_, NULL};
+            return matrix;
+        }
+
+    private:
+        alignas(16) scalar data_[Rows * Columns];
+    };
+
+    typedef fixed_matrix<3, 3> mat3;
+    typedef fixed_matrix<4, 4> mat4;
+
+    class matrix : public expression<matrix>
+    {
+    public:
+        matrix() : matrix_() {}
+
+        matrix(int rows, int columns) : matrix_()
+        {
+            if (libre_matrix_create(&matrix_, rows, columns))
+                throw std::bad_alloc();
+        }
+
+        matrix(const matrix &other) : matrix_()
+        {
+            int result;
+            matrix_ = libre_matrix_copy(other.matrix_, &result);
+            if (result)
+                throw std::bad_alloc();
+        }
+
+        matrix(matrix &&other) : matrix_(other.matrix_)
+        {
+            other.matrix_ = libre_matrix_t();
+        }
+
+        template <typename Expression>
+        matrix(const expression<Expression> &other) : matrix_()
+        {
+            *this = other;
+        }
+
+        ~matrix()
+        {
+            if (matrix_.data)
+                libre_matrix_destroy(matrix_);
+        }
+
+        // takes ownership of a matrix created by the C API
+        static matrix adopt(libre_matrix_t other)
+        {
+            matrix result;
+            result.matrix_ = other;
+            return result;
+        }
+
+        matrix &operator=(const matrix &other)
+        {
+            if (this != &other)
+            {
+                matrix copy(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        matrix &operator=(matrix &&other)
+        {
+            swap(other);
+            return *this;
+        }
+
+        template <typename Expression>
+        matrix &operator=(const expression<Expression> &other)
+        {
+            detail::assign(*this, other.derived());
+            return *this;
+        }
+
+        void resize(int rows, int columns)
+        {
+            if (matrix_.data && matrix_.rows == rows && matrix_.columns == columns)
+                return;
+
+            matrix resized(rows, columns);
+            swap(resized);
+        }
+
+        void swap(matrix &other)
+        {
+            std::swap(matrix_, other.matrix_);
+        }
+
+        libre_matrix_t release()
+        {
+            libre_matrix_t released = matrix_;
+            matrix_ = libre_matrix_t();
+            return released;
+        }
+
+        int rows() const { return matrix_.rows; }
+        int columns() const { return matrix_.columns; }
+
+        scalar operator()(int i, int j) const { return matrix_.data[i * matrix_.columns + j]; }
+        scalar &operator()(int i, int j) { return matrix_.data[i * matrix_.columns + j]; }
+
+        const scalar *data() const { return matrix_.data; }
+        scalar *data() { return matrix_.data; }
+
+        bool references(const scalar *data) const { return data == matrix_.data; }
+
+        const libre_matrix_t &get() const { return matrix_; }
+
+    private:
+        libre_matrix_t matrix_;
+    };
+
+    template <typename Left, typename Right>
+    struct traits<sum<Left, Right>> : detail::elementwise_traits<Left, Right>
+    {
+    };
+
+    template <typename Left, typename Right>
+    struct traits<difference<Left, Right>> : detail::elementwise_traits<Left, Right>
+    {
+    };
+
+    template <typename Expression>
+    struct traits<scaled<Expression>>
+    {
+        static const int rows = traits<Expression>::rows, columns = traits<Expression>::columns;
+        static const bool leaf = false, has_product = traits<Expression>::has_product;
+    };
+
+    template <typename Left, typename Right>
+    struct traits<product<Left, Right>>
+    {
+        static const int rows = traits<Left>::rows, columns = traits<Right>::columns;
+        static const int inner = detail::merge<traits<Left>::columns, traits<Right>::rows>::value;
+        static const bool leaf = false, has_product = true;
+    };
+
+    template <typename Left, typename Right>
+    class sum : public expression<sum<Left, Right>>
+    {
+    public:
+        sum(const Left &left, const Right &right) : left_(left), right_(right)
+        {
+            if (left_.rows() != right_.rows() || left_.columns() != right_.columns())
+                throw std::invalid_argument("libre: matrix dimensions do not match");
+        }
+
+        int rows() const { return left_.rows(); }
+        int columns() const { return left_.columns(); }
+        scalar operator()(int i, int j) const { return left_(i, j) + right_(i, j); }
+        bool references(const scalar *data) const { return left_.references(data) || right_.references(data); }
+
+        const Left &left() const { return left_; }
+        const Right &right() const { return right_; }
+
+    private:
+        typename detail::stored<Left>::type left_;
+        typename detail::stored<Right>::type right_;
+    };
+
+    template <typename Left, typename Right>
+    class difference : public expression<difference<Left, Right>>
+    {
+    public:
+        difference(const Left &left, const Right &right) : left_(left), right_(right)
+        {
+            if (left_.rows() != right_.rows() || left_.columns() != right_.columns())
+                throw std::invalid_argument("libre: matrix dimensions do not match");
+        }
+
+        int rows() const { return left_.rows(); }
+        int columns() const { return left_.columns(); }
+        scalar operator()(int i, int j) const { return left_(i, j) - right_(i, j); }
+        bool references(const scalar *data) const { return left_.references(data) || right_.references(data); }
+
+    private:
+        typename detail::stored<Left>::type left_;
+        typename detail::stored<Right>::type right_;
+    };
+
+    template <typename Expression>
+    class scaled : public expression<scaled<Expression>>
+    {
+    public:
+        scaled(scalar factor, const Expression &expression) : factor_(factor), expression_(expression) {}
+
+        int rows() const { return expression_.rows(); }
+        int columns() const { return expression_.columns(); }
+        scalar operator()(int i, int j) const { return factor_ * expression_(i, j); }
+        bool references(const scalar *data) const { return expression_.references(data); }
+
+    private:
+        scalar factor_;
+        typename detail::stored<Expression>::type expression_;
+    };
+
+    template <typename Left, typename Right>
+    class product : public expression<product<Left, Right>>
+    {
+    public:
+        product(const Left &left, const Right &right) : left_(left), right_(right)
+        {
+            if (left_.columns() != right_.rows())
+                throw std::invalid_argument("libre: matrix dimensions do not match");
+        }
+
+        int rows() const { return left_.rows(); }
+        int columns() const { return right_.columns(); }
+
+        scalar operator()(int i, int j) const
+        {
+            return detail::dot<traits<product>::inner>::run(left_, right_, i, j, left_.columns());
+        }
+
+        bool references(const scalar *data) const { return left_.references(data) || right_.references(data); }
+
+        const typename std::remove_reference<typename detail::evaluated<Left>::type>::type &left() const { return left_; }
+        const typename std::remove_reference<typename detail::evaluated<Right>::type>::type &right() const { return right_; }
+
+    private:
+        typename detail::evaluated<Left>::type left_;
+        typename detail::evaluated<Right>::type right_;
+    };
+
+    template <typename Left, typename Right>
+    sum<Left, Right> operator+(const expression<Left> &left, const expression<Right> &right)
+    {
+        return sum<Left, Right>(left.derived(), right.derived());
+    }
+
+    template <typename Left, typename Right>
+    difference<Left, Right> operator-(const expression<Left> &left, const expression<Right> &right)
+    {
+        return difference<Left, Right>(left.derived(), right.derived());
+    }
+
+    template <typename Expression>
+    scaled<Expression> operator*(scalar factor, const expression<Expression> &expression)
+    {
+        return scaled<Expression>(factor, expression.derived());
+    }
+
+    template <typename Expression>
+    scaled<Expression> operator*(const expression<Expression> &expression, scalar factor)
+    {
+        return scaled<Expression>(factor, expression.derived());
+    }
+
+    template <typename Left, typename Right>
+    product<Left, Right> operator*(const expression<Left> &left, const expression<Right> &right)
+    {
+        return product<Left, Right>(left.derived(), right.derived());
+    }
+
+    namespace detail
+    {
+        template <typename Destination>
+        void prepare(Destination &destination, int rows, int columns)
+        {
+            if (destination.rows() != rows || destination.columns() != columns)
+                throw std::invalid_argument("libre: matrix dimensions do not match");
+        }
+
+        inline void prepare(matrix &destination, int rows, int columns)
+        {
+            destination.resize(rows, columns);
+        }
+
+        template <typename Destination, typename Expression>
+        struct assigner
+        {
+            static void run(Destination &destination, const Expression &expression)
+            {
+                // a product reads other elements of its operands, so it cannot be written over one of them
+                if (traits<Expression>::has_product && expression.references(destination.data()))
+                {
+                    typename plain<Destination>::type temporary(expression);
+                    destination = std::move(temporary);
+                    return;
+                }
+
+                prepare(destination, expression.rows(), expression.columns());
+                evaluate(destination, expression);
+            }
+        };
+
+        // large dynamic products go through libre_matrix_multiply and its simd, blocked and threaded paths
+        inline bool multiply(matrix &destination, const product<matrix, matrix> &expression)
+        {
+            if (expression.references(destination.data()))
+                return false;
+
+            destination.resize(expression.rows(), expression.columns());
+
+            int result;
+            libre_matrix_t target = destination.get();
+            libre_matrix_multiply(expression.left().get(), expression.right().get(), &target, &result);
+            return result == 0;
+        }
+
+        template <>
+        struct assigner<matrix, product<matrix, matrix>>
+        {
+            static void run(matrix &destination, const product<matrix, matrix> &expression)
+            {
+                if (multiply(destination, expression))
+                    return;
+
+                matrix temporary;
+                if (!multiply(temporary, expression))
+                    throw std::invalid_argument("libre: matrix dimensions do not match");
+                destination = std::move(temporary);
+            }
+        };
+
+        // a * b + c multiplies straight into the destination and adds c in a second pass over it
+        template <typename Right>
+        struct assigner<matrix, sum<product<matrix, matrix>, Right>>
+        {
+            static void run(matrix &destination, const sum<product<matrix, matrix>, Right> &expression)
+            {
+                if (expression.right().references(destination.data()) || !multiply(destination, expression.left()))
+                {
+                    matrix temporary(expression.rows(), expression.columns());
+                    evaluate(temporary, expression);
+                    destination = std::move(temporary);
+                    return;
+                }
+
+                scalar *data = destination.data();
+                const Right &right = expression.right();
+                int rows = destination.rows(), columns = destination.columns();
+
+                for (int i = 0; i < rows; i++)
+                    for (int j = 0; j < columns; j++)
+                        data[i * columns + j] += right(i, j);
+            }
+        };
+
+        template <typename Destination, typename Expression>
+        void assign(Destination &destination, const Expression &expression)
+        {
+            assigner<Destination, Expression>::run(destination, expression);
+        }
+    }
+}
@@ -33,8 +33,11 @@ extern "C"
 {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "matrix.h"
 #include "window.h"
 
 #ifdef _WIN32
@@ -44,40 +47,263 @@ extern "C"
 #include <GL/gl.h>
 #endif
 
+#define LIBRE_OPENGL_DIRTY_RANGES_MAX 16
+
+typedef struct libre_opengl_range
+{
+    GLintptr begin, end;
+} libre_opengl_range_t;
+
+/*
+size is the number of bytes in use and capacity is the size of the gpu allocation. When a shadow is enabled, range
+updates only touch the cpu copy and the merged dirty ranges are uploaded by libre_opengl_buffer_object_flush.
+*/
 typedef struct libre_opengl_buffer_object
 {
     libre_window_t window;
     GLenum target;
     GLuint id;
-    GLsizeiptr size;
+    GLsizeiptr size, capacity;
+    uint8_t *shadow;
+    libre_opengl_range_t *dirty;
+    int dirty_count;
 } libre_opengl_buffer_object_t;
 
+#define LIBRE_OPENGL_STREAM_REGIONS_MAX 4
+
+/*
+A buffer split into ring regions that the cpu writes straight into. Each region is guarded by a fence, so
+a region is only written again once the gpu has finished the draws that read it.
+*/
+typedef struct libre_opengl_stream_buffer
+{
+    libre_opengl_buffer_object_t buffer_object;
+    GLsizeiptr region_size;
+    GLintptr offset;
+    int regions, region;
+    bool persistent;
+    uint8_t *mapping;
+    GLsync fences[LIBRE_OPENGL_STREAM_REGIONS_MAX];
+} libre_opengl_stream_buffer_t;
+
+/*
+Matches the layout that glMultiDrawElementsIndirect reads from a GL_DRAW_INDIRECT_BUFFER buffer object.
+*/
+typedef struct libre_opengl_draw_elements_command
+{
+    GLuint count, instance_count, first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+} libre_opengl_draw_elements_command_t;
+
 typedef struct libre_opengl_vao
 {
     libre_window_t window;
     GLuint id;
 } libre_opengl_vao_t;
 
+#define LIBRE_OPENGL_VARIABLE_UNIFORM 0
+#define LIBRE_OPENGL_VARIABLE_ATTRIBUTE 1
+#define LIBRE_OPENGL_VARIABLE_BLOCK 2
+
+/*
+location is the uniform or attribute location, or the index of a uniform block. For uniforms inside a block,
+block and offset give the block index and the byte offset, both are -1 for uniforms in the default block. size is
+the array length, or the data size in bytes for blocks.
+*/
+typedef struct libre_opengl_shader_variable
+{
+    char *name;
+    uint32_t hash;
+    int kind, next;
+    GLenum type;
+    GLint location, size, block, offset;
+} libre_opengl_shader_variable_t;
+
+typedef struct libre_opengl_shader_reflection
+{
+    libre_opengl_shader_variable_t *variables;
+    int count;
+    int *buckets;
+    int bucket_count;
+} libre_opengl_shader_reflection_t;
+
 typedef struct libre_opengl_shader
 {
     libre_window_t window;
     GLuint id;
+    libre_opengl_shader_reflection_t *reflection;
 } libre_opengl_shader_t;
 
+/*
+Writes values with std140 alignment into a caller supplied block, overflow is set instead of writing past the end.
+Matrices are written so that glsl sees the same matrix as the row-major libre types.
+*/
+typedef struct libre_opengl_std140
+{
+    uint8_t *data;
+    size_t size, offset;
+    bool overflow;
+} libre_opengl_std140_t;
+
+/*
+Per-frame uniform data, each push is one copy into the current region of a fenced streaming buffer plus one
+glBindBufferRange.
+*/
+typedef struct libre_opengl_uniform_ring
+{
+    libre_opengl_stream_buffer_t stream_buffer;
+    GLint alignment;
+    GLintptr head;
+    uint8_t *mapping;
+} libre_opengl_uniform_ring_t;
+
+#define LIBRE_OPENGL_SHADER_BUILD_FAILED -1
+#define LIBRE_OPENGL_SHADER_BUILD_PENDING 0
+#define LIBRE_OPENGL_SHADER_BUILD_READY 1
+
+/*
+A program whose compile and link have been submitted but not checked. Submitting a batch of builds before polling
+any of them lets the driver compile in parallel, and with KHR_parallel_shader_compile polling never blocks.
+*/
+typedef struct libre_opengl_shader_build
+{
+    libre_window_t window;
+    GLuint vertex_id, fragment_id, program;
+    int status;
+    char *log;
+    libre_opengl_shader_reflection_t *reflection;
+} libre_opengl_shader_build_t;
+
+typedef struct libre_opengl_shader_cache_stats
+{
+    int hits, misses, rejected, stored;
+    double hit_seconds, miss_seconds, saved_seconds;
+} libre_opengl_shader_cache_stats_t;
+
+/*
+Linked programs are stored in directory as driver binaries, keyed by a hash of both sources and the vendor,
+renderer and version strings. Binaries the driver rejects are deleted and the program is built from source again.
+*/
+typedef struct libre_opengl_shader_cache
+{
+    char *directory;
+    bool supported;
+    uint64_t driver;
+    libre_opengl_shader_cache_stats_t stats;
+} libre_opengl_shader_cache_t;
+
 typedef struct libre_opengl_texture
 {
     libre_window_t window;
     GLuint id;
+    GLsizei width, height, levels;
+    GLenum internal_format;
 } libre_opengl_texture_t;
 
+/*
+What a ktx or dds file holds, parsed without a context. offset is where the first level starts, levels is 0 when the
+mipmaps have to be generated and block_size is only set for dds files.
+*/
+typedef struct libre_opengl_texture_header
+{
+    GLenum internal_format, format, type;
+    GLsizei width, height, levels;
+    bool compressed;
+    GLsizei block_size;
+    size_t offset;
+} libre_opengl_texture_header_t;
+
+#define LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX 4
+
+/*
+Color and depth attachments are single level textures that can be sampled once rendering is done. With samples > 1
+rendering goes into multisampled renderbuffers on id, and libre_opengl_framebuffer_resolve blits them into the
+textures attached to resolve_id.
+*/
+typedef struct libre_opengl_framebuffer
+{
+    libre_window_t window;
+    GLuint id, resolve_id;
+    GLsizei width, height, samples;
+    int color_count;
+    libre_opengl_texture_t colors[LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX], depth;
+    GLuint color_renderbuffers[LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX], depth_renderbuffer;
+} libre_opengl_framebuffer_t;
+
+#define LIBRE_OPENGL_READBACK_SLOTS_MAX 4
+
+/*
+glReadPixels into a ring of pixel pack buffers. Each request is fenced and only mapped once the fence has signaled,
+so pixels requested in frame n are picked up a few frames later without the cpu waiting on the gpu.
+*/
+typedef struct libre_opengl_readback
+{
+    libre_window_t window;
+    GLenum format, type;
+    GLsizeiptr slot_size;
+    int slots, head, count;
+    libre_opengl_buffer_object_t pbos[LIBRE_OPENGL_READBACK_SLOTS_MAX];
+    GLsync fences[LIBRE_OPENGL_READBACK_SLOTS_MAX];
+    GLsizei widths[LIBRE_OPENGL_READBACK_SLOTS_MAX], heights[LIBRE_OPENGL_READBACK_SLOTS_MAX];
+} libre_opengl_readback_t;
+
+/*
+Calls made through libre on each context are tracked, and context switches, binds and program changes that would
+not change anything are skipped. Raw gl calls that change bindings have to be followed by
+libre_opengl_state_invalidate.
+*/
+typedef struct libre_opengl_state_counters
+{
+    uint64_t contexts, programs, vaos, buffers, textures, framebuffers;
+} libre_opengl_state_counters_t;
+
+/*
+Work submitted through libre on a context: draw calls (every command of an indirect draw counts) and the bytes handed
+to gl for buffers and textures.
+*/
+typedef struct libre_opengl_work_counters
+{
+    uint64_t draws, buffer_bytes, texture_bytes;
+} libre_opengl_work_counters_t;
+
+int libre_opengl_state_stats(libre_window_t window, libre_opengl_state_counters_t *issued, libre_opengl_state_counters_t *skipped);
+void libre_opengl_state_reset_stats(libre_window_t window);
+int libre_opengl_work_stats(libre_window_t window, libre_opengl_work_counters_t *work);
+void libre_opengl_state_invalidate(libre_window_t window);
+
 libre_opengl_buffer_object_t libre_opengl_buffer_object(libre_window_t window, GLenum target);
 void libre_opengl_buffer_object_bind(libre_opengl_buffer_object_t buffer_object);
-int libre_opengl_buffer_object_update(libre_opengl_buffer_object_t buffer_object, void *data, GLsizeiptr data_size);
+int libre_opengl_buffer_object_reserve(libre_opengl_buffer_object_t *buffer_object, GLsizeiptr capacity);
+int libre_opengl_buffer_object_update(libre_opengl_buffer_object_t *buffer_object, void *data, GLsizeiptr data_size);
+int libre_opengl_buffer_object_update_range(libre_opengl_buffer_object_t *buffer_object, GLintptr offset, const void *data, GLsizeiptr data_size);
+int libre_opengl_buffer_object_shadow(libre_opengl_buffer_object_t *buffer_object, bool enabled);
+int libre_opengl_buffer_object_flush(libre_opengl_buffer_object_t *buffer_object);
+int libre_opengl_buffer_object_update_matrices(libre_opengl_buffer_object_t *buffer_object, const libre_matrix_t *matrices, int count);
 void libre_opengl_buffer_object_destroy(libre_opengl_buffer_object_t buffer_object);
 
+int libre_opengl_stream_buffer(libre_window_t window, GLenum target, GLsizeiptr region_size, int regions, libre_opengl_stream_buffer_t *stream_buffer);
+void *libre_opengl_stream_buffer_map(libre_opengl_stream_buffer_t *stream_buffer);
+void libre_opengl_stream_buffer_unmap(libre_opengl_stream_buffer_t *stream_buffer);
+void libre_opengl_stream_buffer_wait(libre_opengl_stream_buffer_t *stream_buffer);
+void libre_opengl_stream_buffer_advance(libre_opengl_stream_buffer_t *stream_buffer);
+void libre_opengl_stream_buffer_destroy(libre_opengl_stream_buffer_t *stream_buffer);
+
 libre_opengl_vao_t libre_opengl_vao(libre_window_t window);
 void libre_opengl_vao_bind(libre_opengl_vao_t vao);
 void libre_opengl_vao_pointer(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLsizei stride, GLint offset);
+void libre_opengl_vao_pointer_ex(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset, GLuint divisor);
+void libre_opengl_vao_pointer_integer(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLsizei stride, GLintptr offset, GLuint divisor);
+/*
+Takes slots index to index + 3. The rows of a row-major libre matrix become the columns of the glsl mat4, so shaders
+transform with vector * matrix.
+*/
+void libre_opengl_vao_pointer_mat4(libre_opengl_vao_t vao, GLuint index, GLsizei stride, GLintptr offset, GLuint divisor);
+void libre_opengl_vao_divisor(libre_opengl_vao_t vao, GLuint index, GLuint divisor);
+
+void libre_opengl_draw_arrays_instanced(libre_opengl_vao_t vao, GLenum mode, GLint first, GLsizei count, GLsizei instances);
+void libre_opengl_draw_elements_instanced(libre_opengl_vao_t vao, GLenum mode, GLsizei count, GLenum type, GLintptr offset, GLsizei instances);
+int libre_opengl_multi_draw_elements_indirect(libre_opengl_vao_t vao, GLenum mode, GLenum type, libre_opengl_buffer_object_t *indirect, GLintptr offset, GLsizei draw_count, GLsizei stride);
 void libre_opengl_vao_destroy(libre_opengl_vao_t vao);
 
 int libre_opengl_shader(libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_t *shader);
@@ -85,10 +311,78 @@ void libre_opengl_shader_use(libre_opengl_shader_t shader);
 GLint libre_opengl_shader_attrib_location(libre_opengl_shader_t shader, char *name);
 void libre_opengl_shader_destroy(libre_opengl_shader_t shader);
 
+int libre_opengl_shader_reflect(libre_opengl_shader_t *shader);
+void libre_opengl_shader_reflection_destroy(libre_opengl_shader_reflection_t *reflection);
+const libre_opengl_shader_variable_t *libre_opengl_shader_variable(libre_opengl_shader_t shader, int kind, const char *name);
+GLint libre_opengl_shader_uniform_location(libre_opengl_shader_t shader, const char *name);
+int libre_opengl_shader_block_binding(libre_opengl_shader_t shader, const char *name, GLuint binding);
+
+void libre_opengl_std140(libre_opengl_std140_t *writer, void *data, size_t size);
+void libre_opengl_std140_align(libre_opengl_std140_t *writer, size_t alignment);
+void libre_opengl_std140_float(libre_opengl_std140_t *writer, float value);
+void libre_opengl_std140_int(libre_opengl_std140_t *writer, int32_t value);
+void libre_opengl_std140_vec2(libre_opengl_std140_t *writer, float x, float y);
+void libre_opengl_std140_vec3(libre_opengl_std140_t *writer, libre_vec3_t value);
+void libre_opengl_std140_vec4(libre_opengl_std140_t *writer, libre_vec4_t value);
+void libre_opengl_std140_mat3(libre_opengl_std140_t *writer, const libre_mat3_t *value);
+void libre_opengl_std140_mat4(libre_opengl_std140_t *writer, const libre_mat4_t *value);
+void libre_opengl_std140_float_array(libre_opengl_std140_t *writer, const float *values, int count);
+
+int libre_opengl_uniform_ring(libre_window_t window, GLsizeiptr frame_size, int frames, libre_opengl_uniform_ring_t *ring);
+void libre_opengl_uniform_ring_begin(libre_opengl_uniform_ring_t *ring);
+int libre_opengl_uniform_ring_push(libre_opengl_uniform_ring_t *ring, GLuint binding, const void *data, GLsizeiptr data_size);
+void libre_opengl_uniform_ring_end(libre_opengl_uniform_ring_t *ring);
+void libre_opengl_uniform_ring_destroy(libre_opengl_uniform_ring_t *ring);
+
+int libre_opengl_shader_build_begin(libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_build_t *build);
+int libre_opengl_shader_build_poll(libre_opengl_shader_build_t *build, libre_opengl_shader_t *shader);
+int libre_opengl_shader_build_wait(libre_opengl_shader_build_t *build, libre_opengl_shader_t *shader);
+const char *libre_opengl_shader_build_log(const libre_opengl_shader_build_t *build);
+void libre_opengl_shader_build_destroy(libre_opengl_shader_build_t *build);
+void libre_opengl_shader_compiler_threads(libre_window_t window, GLuint threads);
+
+int libre_opengl_shader_cache(libre_window_t window, const char *directory, libre_opengl_shader_cache_t *cache);
+int libre_opengl_shader_cached(libre_opengl_shader_cache_t *cache, libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_t *shader);
+libre_opengl_shader_cache_stats_t libre_opengl_shader_cache_stats(const libre_opengl_shader_cache_t *cache);
+void libre_opengl_shader_cache_destroy(libre_opengl_shader_cache_t *cache);
+
 libre_opengl_texture_t libre_opengl_texture(libre_window_t window, GLsizei width, GLsizei height, uint8_t *data, GLint wrap, GLint filter);
 void libre_opengl_texture_bind(libre_opengl_texture_t texture);
+void libre_opengl_texture_bind_unit(libre_opengl_texture_t texture, GLuint unit);
 void libre_opengl_texture_destroy(libre_opengl_texture_t texture);
 
+/*
+Immutable textures. levels == 0 allocates the whole mip chain, compressed formats need gl 4.2 or
+ARB_texture_storage, other formats fall back to a mutable texture with the same levels.
+*/
+GLsizei libre_opengl_texture_levels(GLsizei width, GLsizei height);
+int libre_opengl_texture_storage(libre_window_t window, GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels, GLint wrap, GLint filter, libre_opengl_texture_t *texture);
+int libre_opengl_texture_upload(libre_opengl_texture_t texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data);
+int libre_opengl_texture_upload_compressed(libre_opengl_texture_t texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLsizei data_size, const void *data);
+void libre_opengl_texture_generate_mipmaps(libre_opengl_texture_t texture);
+int libre_opengl_texture_ktx_header(const uint8_t *data, size_t data_size, libre_opengl_texture_header_t *header);
+int libre_opengl_texture_dds_header(const uint8_t *data, size_t data_size, libre_opengl_texture_header_t *header);
+int libre_opengl_texture_ktx(libre_window_t window, const uint8_t *data, size_t data_size, GLint wrap, GLint filter, libre_opengl_texture_t *texture);
+int libre_opengl_texture_dds(libre_window_t window, const uint8_t *data, size_t data_size, GLint wrap, GLint filter, libre_opengl_texture_t *texture);
+
+/*
+depth_format is 0 for a framebuffer without depth. Binding a framebuffer also sets the viewport to cover it. A NULL
+framebuffer reads from the default framebuffer of the window. Readback requests fail while every slot is still pending, poll and wait return 1 once the oldest request has
+been copied into pixels as tightly packed rows, poll returns 0 while it is still in flight and both return -1 when
+nothing is pending.
+*/
+int libre_opengl_framebuffer(libre_window_t window, GLsizei width, GLsizei height, const GLenum *color_formats, int color_count, GLenum depth_format, GLsizei samples, libre_opengl_framebuffer_t *framebuffer);
+void libre_opengl_framebuffer_bind(const libre_opengl_framebuffer_t *framebuffer);
+void libre_opengl_framebuffer_bind_default(libre_window_t window);
+void libre_opengl_framebuffer_resolve(const libre_opengl_framebuffer_t *framebuffer);
+void libre_opengl_framebuffer_destroy(libre_opengl_framebuffer_t *framebuffer);
+
+int libre_opengl_readback(libre_window_t window, GLsizei width, GLsizei height, GLenum format, GLenum type, int slots, libre_opengl_readback_t *readback);
+int libre_opengl_readback_request(libre_opengl_readback_t *readback, const libre_opengl_framebuffer_t *framebuffer, int attachment, GLint x, GLint y, GLsizei width, GLsizei height);
+int libre_opengl_readback_poll(libre_opengl_readback_t *readback, void *pixels, GLsizei *width, GLsizei *height);
+int libre_opengl_readback_wait(libre_opengl_readback_t *readback, void *pixels, GLsizei *width, GLsizei *height);
+void libre_opengl_readback_destroy(libre_opengl_readback_t *readback);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,109 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "opengl.h"
+
+#define LIBRE_PROFILER_FRAMES 4
+#define LIBRE_PROFILER_SCOPES_MAX 256
+#define LIBRE_PROFILER_DEPTH_MAX 32
+
+/*
+Times are in seconds since the profiler was created. gpu_begin and gpu_end are only set for gpu scopes, they come
+from timestamp queries that are moved onto the cpu clock with an offset measured at creation.
+*/
+typedef struct libre_profiler_scope
+{
+    const char *name;
+    int depth;
+    bool gpu;
+    double cpu_begin, cpu_end;
+    double gpu_begin, gpu_end;
+} libre_profiler_scope_t;
+
+/*
+binds counts every program, vao, buffer, texture and framebuffer bind that reached gl during the frame, the other
+counters are the work counters of the context over the same frame.
+*/
+typedef struct libre_profiler_frame
+{
+    uint64_t index;
+    double cpu_begin, cpu_end;
+    uint64_t draws, binds, buffer_bytes, texture_bytes;
+    int scope_count;
+    libre_profiler_scope_t scopes[LIBRE_PROFILER_SCOPES_MAX];
+} libre_profiler_frame_t;
+
+/*
+Frames are recorded into a ring and only reported once the queries of all their gpu scopes are available, usually
+two or three frames later, so reading results never waits on the gpu unless it falls a whole ring behind. gpu scopes
+use GL_TIMESTAMP queries instead of GL_TIME_ELAPSED because elapsed queries cannot be nested. Scope names are not
+copied and have to stay valid until the frame is reported, string literals are the usual choice.
+*/
+typedef struct libre_profiler
+{
+    libre_window_t window;
+    bool timer_queries;
+    double origin, gpu_offset;
+    uint64_t frame_index;
+    int frame, depth;
+    int stack[LIBRE_PROFILER_DEPTH_MAX];
+    bool recording, pending[LIBRE_PROFILER_FRAMES];
+    int last_query[LIBRE_PROFILER_FRAMES];
+    libre_profiler_frame_t *frames, *report;
+    bool reported;
+    GLuint *queries;
+    libre_opengl_state_counters_t issued;
+    libre_opengl_work_counters_t work;
+    FILE *trace;
+    bool trace_empty;
+} libre_profiler_t;
+
+int libre_profiler(libre_window_t window, libre_profiler_t *profiler);
+void libre_profiler_frame_begin(libre_profiler_t *profiler);
+void libre_profiler_frame_end(libre_profiler_t *profiler);
+void libre_profiler_push(libre_profiler_t *profiler, const char *name, bool gpu);
+void libre_profiler_pop(libre_profiler_t *profiler);
+const libre_profiler_frame_t *libre_profiler_report(const libre_profiler_t *profiler);
+int libre_profiler_trace(libre_profiler_t *profiler, const char *path);
+void libre_profiler_trace_string(FILE *file, const char *string);
+void libre_profiler_destroy(libre_profiler_t *profiler);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "matrix.h"
+
+typedef struct libre_quaternion
+{
+   LIBRE_MATRIX_ALIGN(16) LIBRE_MATRIX_TYPE w;
+   LIBRE_MATRIX_TYPE x, y, z;
+} libre_quaternion_t;
+
+libre_quaternion_t libre_quaternion(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z);
+libre_quaternion_t libre_quaternion_identity(void);
+libre_quaternion_t libre_quaternion_axis_angle(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, LIBRE_MATRIX_TYPE angle);
+
+LIBRE_MATRIX_TYPE libre_quaternion_dot(libre_quaternion_t a, libre_quaternion_t b);
+libre_quaternion_t libre_quaternion_normalize(libre_quaternion_t quaternion);
+libre_quaternion_t libre_quaternion_conjugate(libre_quaternion_t quaternion);
+libre_quaternion_t libre_quaternion_multiply(libre_quaternion_t a, libre_quaternion_t b);
+libre_vec3_t libre_quaternion_rotate(libre_quaternion_t quaternion, libre_vec3_t vector);
+
+libre_quaternion_t libre_quaternion_nlerp(libre_quaternion_t a, libre_quaternion_t b, LIBRE_MATRIX_TYPE t);
+libre_quaternion_t libre_quaternion_slerp(libre_quaternion_t a, libre_quaternion_t b, LIBRE_MATRIX_TYPE t);
+int libre_quaternion_nlerp_batch(const libre_quaternion_t *a, const libre_quaternion_t *b, const LIBRE_MATRIX_TYPE *t, libre_quaternion_t *destination, int count);
+
+/*
+The conversions expect unit quaternions and write 16 floats in the libre_matrix_t.data layout.
+*/
+void libre_quaternion_to_matrix(libre_quaternion_t quaternion, LIBRE_MATRIX_TYPE *destination);
+libre_mat4_t libre_quaternion_to_mat4(libre_quaternion_t quaternion);
+int libre_quaternion_to_matrix_batch(const libre_quaternion_t *quaternions, LIBRE_MATRIX_TYPE *destination, int count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,93 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "opengl.h"
+
+/*
+Vertex layout used by the renderer, the shaders have to read position from location 0, uv from location 1 and the
+normalized rgba color from location 2.
+*/
+typedef struct libre_renderer_vertex
+{
+    float x, y, z;
+    float u, v;
+    uint8_t r, g, b, a;
+} libre_renderer_vertex_t;
+
+typedef struct libre_renderer_command
+{
+    int layer, sequence;
+    GLuint shader, texture;
+    int first_index, index_count;
+} libre_renderer_command_t;
+
+typedef struct libre_renderer_stats
+{
+    int submissions, draws, vertices, indices;
+    int shader_changes, texture_changes;
+} libre_renderer_stats_t;
+
+/*
+Submissions are buffered for the whole frame, then sorted by layer, shader and texture and drawn with one call per
+run of equal state. Layers are drawn in increasing order, submissions inside a layer have no defined order.
+*/
+typedef struct libre_renderer
+{
+    libre_window_t window;
+    libre_opengl_stream_buffer_t vbo, ibo;
+    libre_opengl_vao_t vao;
+
+    libre_renderer_vertex_t *vertices;
+    uint32_t *indices;
+    libre_renderer_command_t *commands;
+    int max_vertices, max_indices;
+    int vertex_count, index_count, command_count, command_capacity;
+
+    libre_renderer_stats_t stats;
+} libre_renderer_t;
+
+int libre_renderer(libre_window_t window, int max_vertices, int max_indices, libre_renderer_t *renderer);
+void libre_renderer_begin(libre_renderer_t *renderer);
+int libre_renderer_submit(libre_renderer_t *renderer, int layer, libre_opengl_shader_t shader, libre_opengl_texture_t texture, const libre_renderer_vertex_t *vertices, int vertex_count, const uint32_t *indices, int index_count);
+int libre_renderer_quad(libre_renderer_t *renderer, int layer, libre_opengl_shader_t shader, libre_opengl_texture_t texture, float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color);
+void libre_renderer_flush(libre_renderer_t *renderer);
+libre_renderer_stats_t libre_renderer_end(libre_renderer_t *renderer);
+void libre_renderer_destroy(libre_renderer_t *renderer);
+
+#ifdef __cplusplus
+}
+#endif
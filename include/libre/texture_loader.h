@@ -0,0 +1,101 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "opengl.h"
+
+#define LIBRE_TEXTURE_LOADER_PBOS 3
+
+#define LIBRE_TEXTURE_LOADER_FAILED -1
+#define LIBRE_TEXTURE_LOADER_PENDING 0
+#define LIBRE_TEXTURE_LOADER_DONE 1
+
+/*
+Filled in by the decode callback on the loader thread. pixels is rgba8 and must come from malloc, the loader frees
+it once the upload is finished.
+*/
+typedef struct libre_texture_image
+{
+    GLsizei width, height;
+    uint8_t *pixels;
+} libre_texture_image_t;
+
+typedef int (*libre_texture_decode_t)(void *argument, libre_texture_image_t *image);
+
+typedef struct libre_texture_request
+{
+    libre_texture_decode_t decode;
+    void *argument;
+    GLint wrap, filter;
+
+    int status, result;
+    bool released;
+    GLsizei row;
+    libre_texture_image_t image;
+    libre_opengl_texture_t texture;
+
+    struct libre_texture_request *next;
+} libre_texture_request_t;
+
+/*
+Images are decoded on a worker thread and handed back to libre_texture_loader_update, which streams at most budget
+bytes per call through a ring of fenced pixel unpack buffers. Large images are split by rows over several frames.
+*/
+typedef struct libre_texture_loader
+{
+    libre_window_t window;
+    size_t budget, bytes_uploaded;
+
+    libre_opengl_buffer_object_t pbos[LIBRE_TEXTURE_LOADER_PBOS];
+    GLsync fences[LIBRE_TEXTURE_LOADER_PBOS];
+    int pbo;
+
+    libre_texture_request_t *head, *tail;
+    struct libre_texture_loader_worker *worker;
+} libre_texture_loader_t;
+
+int libre_texture_loader(libre_window_t window, size_t budget, libre_texture_loader_t *loader);
+libre_texture_request_t *libre_texture_loader_load(libre_texture_loader_t *loader, libre_texture_decode_t decode, void *argument, GLint wrap, GLint filter);
+size_t libre_texture_loader_update(libre_texture_loader_t *loader);
+int libre_texture_loader_poll(const libre_texture_request_t *request, libre_opengl_texture_t *texture);
+void libre_texture_loader_release(libre_texture_loader_t *loader, libre_texture_request_t *request);
+void libre_texture_loader_destroy(libre_texture_loader_t *loader);
+
+#ifdef __cplusplus
+}
+#endif
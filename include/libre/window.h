@@ -36,11 +36,52 @@ extern "C"
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
 
+/*
+window is NULL for a headless context, which lives on an egl display, context and surface instead (kept as void * so
+egl.h is not needed here). surface is EGL_NO_SURFACE when the driver supports surfaceless contexts, rendering then has
+to go into a framebuffer object. Glew has to be built with egl support for glewInit to work on a headless context.
+*/
 typedef struct libre_window
 {
     GLFWwindow *window;
+    void *display, *context, *surface;
+    int width, height;
 } libre_window_t;
 
+#define LIBRE_WINDOW_PACING_UNCAPPED 0
+#define LIBRE_WINDOW_PACING_VSYNC 1
+#define LIBRE_WINDOW_PACING_ADAPTIVE 2
+
+#define LIBRE_WINDOW_PACER_SAMPLES 256
+#define LIBRE_WINDOW_PACER_FRAMES_MAX 4
+
+/*
+Frame times in seconds over the last LIBRE_WINDOW_PACER_SAMPLES frames.
+*/
+typedef struct libre_window_frame_stats
+{
+    int count;
+    double last, min, avg, p99, max;
+} libre_window_frame_stats_t;
+
+/*
+Swaps a window at a steady rate. Adaptive vsync uses a swap interval of -1 where the driver supports tearing late
+frames and plain vsync otherwise. A rate above 0 caps the frame rate on top of any mode by sleeping until shortly
+before the deadline and spinning the rest of the way, the sleep margin follows how far sleeps overshoot. With
+frames_in_flight above 0 a fence is placed after every swap and the cpu waits until no more than that many frames
+are queued on the gpu, which keeps input latency down at the cost of some throughput.
+*/
+typedef struct libre_window_pacer
+{
+    libre_window_t window;
+    int mode, interval, frames_in_flight;
+    double period, deadline, margin, last;
+    void *fences[LIBRE_WINDOW_PACER_FRAMES_MAX];
+    int fence, fence_count;
+    double samples[LIBRE_WINDOW_PACER_SAMPLES];
+    int sample, sample_count;
+} libre_window_pacer_t;
+
 int libre_window_init(void);
 void libre_window_terminate(void);
 void libre_window_poll_events(void);
@@ -52,6 +93,17 @@ bool libre_window_should_close(libre_window_t window);
 void libre_window_destroy(libre_window_t window);
 void libre_window_swap_buffers(libre_window_t window);
 void libre_window_center(libre_window_t window);
+int libre_window_create_headless(libre_window_t *window, int width, int height);
+void libre_window_make_current(libre_window_t window);
+bool libre_window_is_current(libre_window_t window);
+void libre_window_get_size(libre_window_t window, int *width, int *height);
+int libre_window_swap_interval(libre_window_t window, int interval);
+
+int libre_window_pacer(libre_window_t window, int mode, double rate, int frames_in_flight, libre_window_pacer_t *pacer);
+void libre_window_pacer_rate(libre_window_pacer_t *pacer, double rate);
+void libre_window_pacer_swap(libre_window_pacer_t *pacer);
+libre_window_frame_stats_t libre_window_pacer_stats(const libre_window_pacer_t *pacer);
+void libre_window_pacer_destroy(libre_window_pacer_t *pacer);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,104 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "libre/arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *libre_arena_allocator_alloc(void *user, size_t size)
+{
+    return libre_arena_alloc(user, size, LIBRE_ARENA_ALIGNMENT);
+}
+
+static void libre_arena_allocator_free(void *user, void *pointer)
+{
+}
+
+int libre_arena_create(libre_arena_t *arena, size_t size)
+{
+    if (!arena)
+        return -1;
+    memset(arena, 0, sizeof(*arena));
+
+    arena->block = malloc(size + LIBRE_ARENA_ALIGNMENT);
+    if (!arena->block)
+        return -1;
+
+    uintptr_t address = ((uintptr_t)arena->block + LIBRE_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(LIBRE_ARENA_ALIGNMENT - 1);
+    arena->data = (unsigned char *)address;
+    arena->size = size;
+
+    arena->allocator.alloc = libre_arena_allocator_alloc;
+    arena->allocator.free = libre_arena_allocator_free;
+    arena->allocator.user = arena;
+
+    return 0;
+}
+
+void *libre_arena_alloc(libre_arena_t *arena, size_t size, size_t alignment)
+{
+    if (!arena || !arena->data)
+        return NULL;
+    if (alignment == 0)
+        alignment = LIBRE_ARENA_ALIGNMENT;
+    if (alignment & (alignment - 1))
+        return NULL;
+
+    // the block is only aligned to LIBRE_ARENA_ALIGNMENT, so larger alignments have to look at the address itself
+    uintptr_t address = (uintptr_t)arena->data + arena->offset;
+    uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned < address)
+        return NULL;
+
+    size_t offset = arena->offset + (size_t)(aligned - address);
+    if (offset > arena->size || size > arena->size - offset)
+        return NULL;
+
+    arena->offset = offset + size;
+    if (arena->offset > arena->peak)
+        arena->peak = arena->offset;
+
+    return arena->data + offset;
+}
+
+void libre_arena_reset(libre_arena_t *arena)
+{
+    if (arena)
+        arena->offset = 0;
+}
+
+void libre_arena_destroy(libre_arena_t *arena)
+{
+    if (!arena)
+        return;
+
+    free(arena->block);
+    memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,459 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/atlas.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int libre_atlas_skyline(int width, int height, libre_atlas_skyline_t *skyline)
+{
+    if (!skyline)
+        return -1;
+    memset(skyline, 0, sizeof(*skyline));
+
+    if (width <= 0 || height <= 0)
+        return -1;
+
+    // the skyline never has more segments than the area has columns
+    skyline->nodes = malloc(width * sizeof(*skyline->nodes));
+    if (!skyline->nodes)
+        return -1;
+
+    skyline->width = width;
+    skyline->height = height;
+    libre_atlas_skyline_reset(skyline);
+    return 0;
+}
+
+void libre_atlas_skyline_reset(libre_atlas_skyline_t *skyline)
+{
+    if (!skyline || !skyline->nodes)
+        return;
+
+    skyline->nodes[0].x = 0;
+    skyline->nodes[0].y = 0;
+    skyline->nodes[0].width = skyline->width;
+    skyline->node_count = 1;
+    skyline->used = 0;
+}
+
+static int libre_atlas_skyline_fit(const libre_atlas_skyline_t *skyline, int index, int width, int height)
+{
+    if (skyline->nodes[index].x + width > skyline->width)
+        return -1;
+
+    int y = skyline->nodes[index].y;
+    for (int remaining = width; remaining > 0; remaining -= skyline->nodes[index++].width)
+    {
+        if (skyline->nodes[index].y > y)
+            y = skyline->nodes[index].y;
+        if (y + height > skyline->height)
+            return -1;
+    }
+
+    return y;
+}
+
+int libre_atlas_skyline_pack(libre_atlas_skyline_t *skyline, int width, int height, int *x, int *y)
+{
+    if (!skyline || !skyline->nodes || width <= 0 || height <= 0 || !x || !y)
+        return -1;
+
+    int best = -1, best_y = 0, best_width = 0;
+    for (int i = 0; i < skyline->node_count; i++)
+    {
+        int fit = libre_atlas_skyline_fit(skyline, i, width, height);
+        if (fit < 0)
+            continue;
+
+        // lowest top edge first, then the narrowest segment to keep the skyline flat
+        if (best < 0 || fit < best_y || (fit == best_y && skyline->nodes[i].width < best_width))
+        {
+            best = i;
+            best_y = fit;
+            best_width = skyline->nodes[i].width;
+        }
+    }
+
+    if (best < 0 || skyline->node_count == skyline->width)
+        return -1;
+
+    libre_atlas_node_t *nodes = skyline->nodes;
+    memmove(&nodes[best + 1], &nodes[best], (skyline->node_count - best) * sizeof(*nodes));
+    skyline->node_count++;
+
+    *x = nodes[best].x;
+    *y = best_y;
+    nodes[best].y = best_y + height;
+    nodes[best].width = width;
+
+    // segments that are now covered by the new node are shortened or removed
+    for (int i = best + 1; i < skyline->node_count; i++)
+    {
+        int shrink = nodes[i - 1].x + nodes[i - 1].width - nodes[i].x;
+        if (shrink <= 0)
+            break;
+
+        nodes[i].x += shrink;
+        nodes[i].width -= shrink;
+        if (nodes[i].width > 0)
+            break;
+
+        memmove(&nodes[i], &nodes[i + 1], (skyline->node_count - i - 1) * sizeof(*nodes));
+        skyline->node_count--;
+        i--;
+    }
+
+    for (int i = 0; i < skyline->node_count - 1; i++)
+    {
+        if (nodes[i].y != nodes[i + 1].y)
+            continue;
+
+        nodes[i].width += nodes[i + 1].width;
+        memmove(&nodes[i + 1], &nodes[i + 2], (skyline->node_count - i - 2) * sizeof(*nodes));
+        skyline->node_count--;
+        i--;
+    }
+
+    skyline->used += (long)width * height;
+    return 0;
+}
+
+void libre_atlas_skyline_destroy(libre_atlas_skyline_t *skyline)
+{
+    if (!skyline)
+        return;
+
+    free(skyline->nodes);
+    memset(skyline, 0, sizeof(*skyline));
+}
+
+int libre_atlas(libre_window_t window, int width, int height, GLenum internal_format, int padding, GLint filter, bool evict, libre_atlas_t *atlas)
+{
+    if (!atlas)
+        return -1;
+    memset(atlas, 0, sizeof(*atlas));
+
+    if (width <= 0 || height <= 0 || padding < 0)
+        return -1;
+    if (internal_format == GL_R8)
+        atlas->channels = 1;
+    else if (internal_format == GL_RGBA8 || internal_format == GL_SRGB8_ALPHA8)
+        atlas->channels = 4;
+    else
+        return -1;
+
+    atlas->width = width;
+    atlas->height = height;
+    atlas->padding = padding;
+    atlas->evict = evict;
+
+    if (libre_atlas_skyline(width, height, &atlas->skyline))
+        return -1;
+
+    if (libre_opengl_texture_storage(window, internal_format, width, height, 1, GL_CLAMP_TO_EDGE, filter, &atlas->texture))
+    {
+        libre_atlas_destroy(atlas);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int libre_atlas_upload(libre_atlas_t *atlas, const libre_atlas_entry_t *entry)
+{
+    int padding = atlas->padding, channels = atlas->channels;
+    int width = entry->width + 2 * padding, height = entry->height + 2 * padding;
+
+    uint8_t *padded = malloc((size_t)width * height * channels);
+    if (!padded)
+        return -1;
+
+    // the border pixels are repeated into the padding so filtering never reads a neighbouring image
+    for (int y = 0; y < height; y++)
+    {
+        int source_y = y - padding < 0 ? 0 : y - padding >= entry->height ? entry->height - 1 : y - padding;
+        for (int x = 0; x < width; x++)
+        {
+            int source_x = x - padding < 0 ? 0 : x - padding >= entry->width ? entry->width - 1 : x - padding;
+            memcpy(&padded[((size_t)y * width + x) * channels], &entry->pixels[((size_t)source_y * entry->width + source_x) * channels], channels);
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int result = libre_opengl_texture_upload(atlas->texture, 0, entry->x - padding, entry->y - padding, width, height, channels == 1 ? GL_RED : GL_RGBA, GL_UNSIGNED_BYTE, padded);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    free(padded);
+    return result;
+}
+
+static int libre_atlas_place(libre_atlas_t *atlas, libre_atlas_entry_t *entry)
+{
+    int x, y;
+    if (libre_atlas_skyline_pack(&atlas->skyline, entry->width + 2 * atlas->padding, entry->height + 2 * atlas->padding, &x, &y))
+        return -1;
+
+    entry->x = x + atlas->padding;
+    entry->y = y + atlas->padding;
+    return libre_atlas_upload(atlas, entry);
+}
+
+int libre_atlas_defragment(libre_atlas_t *atlas)
+{
+    if (!atlas)
+        return -1;
+
+    size_t entries = atlas->entry_count > 0 ? atlas->entry_count : 1;
+    int *order = malloc(entries * sizeof(*order));
+    int *positions = malloc(entries * 2 * sizeof(*positions));
+    if (!order || !positions)
+    {
+        free(order);
+        free(positions);
+        return -1;
+    }
+
+    // taller images first packs a skyline much tighter than insertion order
+    int count = 0;
+    for (int i = 0; i < atlas->entry_count; i++)
+    {
+        if (!atlas->entries[i].live)
+            continue;
+
+        int j = count++;
+        while (j > 0 && atlas->entries[order[j - 1]].height < atlas->entries[i].height)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    // the new layout is packed into a scratch skyline first, a different order can in rare cases fit worse
+    libre_atlas_skyline_t skyline;
+    int placed = 0;
+    if (libre_atlas_skyline(atlas->width, atlas->height, &skyline) == 0)
+    {
+        for (; placed < count; placed++)
+        {
+            libre_atlas_entry_t *entry = &atlas->entries[order[placed]];
+            if (libre_atlas_skyline_pack(&skyline, entry->width + 2 * atlas->padding, entry->height + 2 * atlas->padding, &positions[2 * placed], &positions[2 * placed + 1]))
+                break;
+        }
+    }
+
+    if (placed < count || !skyline.nodes)
+    {
+        libre_atlas_skyline_destroy(&skyline);
+        free(positions);
+        free(order);
+        return -1;
+    }
+
+    libre_atlas_skyline_destroy(&atlas->skyline);
+    atlas->skyline = skyline;
+    atlas->generation++;
+
+    int result = 0;
+    for (int i = 0; i < count; i++)
+    {
+        libre_atlas_entry_t *entry = &atlas->entries[order[i]];
+        entry->x = positions[2 * i] + atlas->padding;
+        entry->y = positions[2 * i + 1] + atlas->padding;
+        if (libre_atlas_upload(atlas, entry))
+            result = -1;
+    }
+
+    free(positions);
+    free(order);
+    return result;
+}
+
+static void libre_atlas_release(libre_atlas_t *atlas, libre_atlas_entry_t *entry)
+{
+    free(entry->pixels);
+    entry->pixels = NULL;
+    entry->live = false;
+    entry->serial = (entry->serial + 1) & LIBRE_ATLAS_SERIAL_MASK;
+}
+
+static int libre_atlas_handle(const libre_atlas_t *atlas, const libre_atlas_entry_t *entry)
+{
+    return (entry->serial << LIBRE_ATLAS_SLOT_BITS) | (int)(entry - atlas->entries);
+}
+
+static libre_atlas_entry_t *libre_atlas_least_recently_used(libre_atlas_t *atlas)
+{
+    libre_atlas_entry_t *oldest = NULL;
+    for (int i = 0; i < atlas->entry_count; i++)
+    {
+        libre_atlas_entry_t *entry = &atlas->entries[i];
+        if (entry->live && entry->last_used < atlas->frame && (!oldest || entry->last_used < oldest->last_used))
+            oldest = entry;
+    }
+
+    return oldest;
+}
+
+int libre_atlas_add(libre_atlas_t *atlas, int width, int height, const uint8_t *pixels)
+{
+    if (!atlas || !pixels || width <= 0 || height <= 0)
+        return -1;
+    if (width + 2 * atlas->padding > atlas->width || height + 2 * atlas->padding > atlas->height)
+        return -1;
+
+    int handle = 0;
+    while (handle < atlas->entry_count && (atlas->entries[handle].live || atlas->entries[handle].pixels))
+        handle++;
+    if (handle > LIBRE_ATLAS_SLOT_MASK)
+        return -1;
+
+    if (handle == atlas->entry_capacity)
+    {
+        int capacity = atlas->entry_capacity ? atlas->entry_capacity * 2 : 64;
+        libre_atlas_entry_t *entries = realloc(atlas->entries, capacity * sizeof(*entries));
+        if (!entries)
+            return -1;
+
+        atlas->entries = entries;
+        atlas->entry_capacity = capacity;
+    }
+    if (handle == atlas->entry_count)
+    {
+        memset(&atlas->entries[handle], 0, sizeof(*atlas->entries));
+        atlas->entry_count++;
+    }
+
+    // the serial survives slot reuse, everything else starts over
+    libre_atlas_entry_t *entry = &atlas->entries[handle];
+    int serial = entry->serial;
+    memset(entry, 0, sizeof(*entry));
+    entry->serial = serial;
+    entry->width = width;
+    entry->height = height;
+    entry->last_used = atlas->frame;
+
+    size_t size = (size_t)width * height * atlas->channels;
+    entry->pixels = malloc(size);
+    if (!entry->pixels)
+        return -1;
+    memcpy(entry->pixels, pixels, size);
+
+    // the entry is not live yet, so repacking below leaves it out
+    if (libre_atlas_place(atlas, entry) == 0)
+    {
+        entry->live = true;
+        return libre_atlas_handle(atlas, entry);
+    }
+
+    while (true)
+    {
+        // a repack that does not fit keeps the old layout, which the new image did not fit into either
+        if (libre_atlas_defragment(atlas) == 0 && libre_atlas_place(atlas, entry) == 0)
+        {
+            entry->live = true;
+            return libre_atlas_handle(atlas, entry);
+        }
+
+        if (!atlas->evict)
+            break;
+
+        // evict at least the area that is needed before paying for another repack
+        long needed = (long)(width + 2 * atlas->padding) * (height + 2 * atlas->padding), freed = 0;
+        libre_atlas_entry_t *oldest;
+        while (freed < needed && (oldest = libre_atlas_least_recently_used(atlas)))
+        {
+            freed += (long)(oldest->width + 2 * atlas->padding) * (oldest->height + 2 * atlas->padding);
+            libre_atlas_release(atlas, oldest);
+        }
+
+        if (freed == 0)
+            break;
+    }
+
+    libre_atlas_release(atlas, entry);
+    return -1;
+}
+
+bool libre_atlas_contains(const libre_atlas_t *atlas, int handle)
+{
+    if (!atlas || handle < 0)
+        return false;
+
+    int slot = handle & LIBRE_ATLAS_SLOT_MASK;
+    return slot < atlas->entry_count && atlas->entries[slot].live && atlas->entries[slot].serial == handle >> LIBRE_ATLAS_SLOT_BITS;
+}
+
+int libre_atlas_uv(libre_atlas_t *atlas, int handle, libre_atlas_rect_t *uv)
+{
+    if (!libre_atlas_contains(atlas, handle) || !uv)
+        return -1;
+
+    libre_atlas_entry_t *entry = &atlas->entries[handle & LIBRE_ATLAS_SLOT_MASK];
+    entry->last_used = atlas->frame;
+
+    uv->u0 = (float)entry->x / atlas->width;
+    uv->v0 = (float)entry->y / atlas->height;
+    uv->u1 = (float)(entry->x + entry->width) / atlas->width;
+    uv->v1 = (float)(entry->y + entry->height) / atlas->height;
+
+    return 0;
+}
+
+void libre_atlas_remove(libre_atlas_t *atlas, int handle)
+{
+    // the space is only reclaimed by the next repack, the skyline cannot give it back
+    if (libre_atlas_contains(atlas, handle))
+        libre_atlas_release(atlas, &atlas->entries[handle & LIBRE_ATLAS_SLOT_MASK]);
+}
+
+void libre_atlas_frame(libre_atlas_t *atlas)
+{
+    if (atlas)
+        atlas->frame++;
+}
+
+void libre_atlas_destroy(libre_atlas_t *atlas)
+{
+    if (!atlas)
+        return;
+
+    for (int i = 0; i < atlas->entry_count; i++)
+        free(atlas->entries[i].pixels);
+    free(atlas->entries);
+    libre_atlas_skyline_destroy(&atlas->skyline);
+
+    if (atlas->texture.id)
+        libre_opengl_texture_destroy(atlas->texture);
+
+    memset(atlas, 0, sizeof(*atlas));
+}
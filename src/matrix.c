@@ -27,13 +27,24 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libre/matrix.h"
+#include "libre/pool.h"
+#include "matrix_kernel.h"
+#include "thread.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <stdbool.h>
+
+static LIBRE_THREAD_LOCAL const libre_allocator_t *libre_matrix_allocator = NULL;
 
 int libre_matrix_create(libre_matrix_t *matrix, int rows, int columns)
+{
+   return libre_matrix_create_ex(matrix, rows, columns, libre_matrix_allocator, 0);
+}
+
+int libre_matrix_create_ex(libre_matrix_t *matrix, int rows, int columns, const libre_allocator_t *allocator, int flags)
 {
    if (!matrix)
       return -1;
@@ -41,18 +52,35 @@ int libre_matrix_create(libre_matrix_t *matrix, int rows, int columns)
 
    matrix->rows = rows;
    matrix->columns = columns;
+   matrix->allocator = allocator;
 
-   matrix->data = malloc(sizeof(LIBRE_MATRIX_TYPE) * rows * columns);
+   size_t size = sizeof(LIBRE_MATRIX_TYPE) * rows * columns;
+   matrix->data = allocator ? allocator->alloc(allocator->user, size) : malloc(size);
    if (!matrix->data)
       return -1;
-   memset(matrix->data, 0, sizeof(LIBRE_MATRIX_TYPE) * rows * columns);
+
+   if (!(flags & LIBRE_MATRIX_UNINITIALIZED))
+      memset(matrix->data, 0, size);
 
    return 0;
 }
 
+void libre_matrix_set_allocator(const libre_allocator_t *allocator)
+{
+   libre_matrix_allocator = allocator;
+}
+
+const libre_allocator_t *libre_matrix_get_allocator(void)
+{
+   return libre_matrix_allocator;
+}
+
 void libre_matrix_destroy(libre_matrix_t matrix)
 {
-   free(matrix.data);
+   if (matrix.allocator)
+      matrix.allocator->free(matrix.allocator->user, matrix.data);
+   else
+      free(matrix.data);
    matrix.data = NULL;
 }
 
@@ -70,7 +98,7 @@ libre_matrix_t libre_matrix_copy(libre_matrix_t matrix, int *result)
 {
    libre_matrix_t copy = {0};
 
-   if (libre_matrix_create(&copy, matrix.rows, matrix.columns))
+   if (libre_matrix_create_ex(&copy, matrix.rows, matrix.columns, libre_matrix_allocator, LIBRE_MATRIX_UNINITIALIZED))
    {
       if (result)
          *result = -1;
@@ -84,6 +112,53 @@ libre_matrix_t libre_matrix_copy(libre_matrix_t matrix, int *result)
    return copy;
 }
 
+typedef struct libre_matrix_job
+{
+   const libre_matrix_kernel_t *kernel;
+   libre_matrix_t a, b, c;
+   LIBRE_MATRIX_TYPE factor;
+} libre_matrix_job_t;
+
+static void libre_matrix_add_rows(void *argument, int begin, int end)
+{
+   libre_matrix_job_t *job = argument;
+   const LIBRE_MATRIX_TYPE *a = job->a.data, *b = job->b.data;
+   LIBRE_MATRIX_TYPE *c = job->c.data;
+   int columns = job->c.columns;
+
+   for (int i = begin * columns; i < end * columns; i++)
+      c[i] = a[i] + b[i];
+}
+
+static void libre_matrix_scale_rows(void *argument, int begin, int end)
+{
+   libre_matrix_job_t *job = argument;
+   LIBRE_MATRIX_TYPE *c = job->c.data;
+   LIBRE_MATRIX_TYPE factor = job->factor;
+   int columns = job->c.columns;
+
+   for (int i = begin * columns; i < end * columns; i++)
+      c[i] *= factor;
+}
+
+static void libre_matrix_multiply_rows(void *argument, int begin, int end)
+{
+   libre_matrix_job_t *job = argument;
+   const LIBRE_MATRIX_TYPE *a = job->a.data + begin * job->a.columns;
+   LIBRE_MATRIX_TYPE *c = job->c.data + begin * job->c.columns;
+
+   job->kernel->multiply(end - begin, job->b.columns, job->a.columns, a, job->a.columns, job->b.data, job->b.columns, c, job->c.columns);
+}
+
+static int libre_matrix_grain(double work_per_row, double threshold)
+{
+   if (work_per_row <= 0)
+      return 1;
+
+   double grain = ceil(threshold / work_per_row);
+   return grain > 1 << 30 ? 1 << 30 : (int)grain;
+}
+
 libre_matrix_t libre_matrix_add(libre_matrix_t a, libre_matrix_t b, libre_matrix_t *destination, int *result)
 {
    libre_matrix_t sum = {0};
@@ -105,16 +180,18 @@ libre_matrix_t libre_matrix_add(libre_matrix_t a, libre_matrix_t b, libre_matrix
       }
       sum = *destination;
    }
-   else if (libre_matrix_create(&sum, a.rows, a.columns))
+   else if (libre_matrix_create_ex(&sum, a.rows, a.columns, libre_matrix_allocator, LIBRE_MATRIX_UNINITIALIZED))
    {
       if (result)
          *result = -1;
       return sum;
    }
 
-   for (int i = 0; i < a.rows; i++)
-      for (int j = 0; j < a.columns; j++)
-         LIBRE_MATRIX_SET(sum, i, j, LIBRE_MATRIX_GET(a, i, j) + LIBRE_MATRIX_GET(b, i, j));
+   libre_matrix_job_t job = {0};
+   job.a = a;
+   job.b = b;
+   job.c = sum;
+   libre_pool_parallel_for(a.rows, libre_matrix_grain(a.columns, LIBRE_MATRIX_PARALLEL_ELEMENTS), libre_matrix_add_rows, &job);
 
    if (result)
       *result = 0;
@@ -123,9 +200,10 @@ libre_matrix_t libre_matrix_add(libre_matrix_t a, libre_matrix_t b, libre_matrix
 
 void libre_matrix_scale(libre_matrix_t matrix, LIBRE_MATRIX_TYPE factor)
 {
-   for (int i = 0; i < matrix.rows; i++)
-      for (int j = 0; j < matrix.columns; j++)
-         LIBRE_MATRIX_SET(matrix, i, j, LIBRE_MATRIX_GET(matrix, i, j) * factor);
+   libre_matrix_job_t job = {0};
+   job.c = matrix;
+   job.factor = factor;
+   libre_pool_parallel_for(matrix.rows, libre_matrix_grain(matrix.columns, LIBRE_MATRIX_PARALLEL_ELEMENTS), libre_matrix_scale_rows, &job);
 }
 
 libre_matrix_t libre_matrix_multiply(libre_matrix_t a, libre_matrix_t b, libre_matrix_t *destination, int *result)
@@ -149,22 +227,28 @@ libre_matrix_t libre_matrix_multiply(libre_matrix_t a, libre_matrix_t b, libre_m
       }
       product = *destination;
    }
-   else if (libre_matrix_create(&product, a.rows, b.columns))
+   else if (libre_matrix_create_ex(&product, a.rows, b.columns, libre_matrix_allocator, LIBRE_MATRIX_UNINITIALIZED))
    {
       if (result)
          *result = -1;
       return product;
    }
 
-   for (int i = 0; i < product.rows; i++)
-      for (int j = 0; j < product.columns; j++)
-      {
-         LIBRE_MATRIX_TYPE sum = 0;
-         for (int k = 0; k < a.columns; k++)
-            sum += LIBRE_MATRIX_GET(a, i, k) * LIBRE_MATRIX_GET(b, k, j);
-
-         LIBRE_MATRIX_SET(product, i, j, sum);
-      }
+   const libre_matrix_kernel_t *kernel = libre_matrix_kernel();
+   if (a.rows == 4 && a.columns == 4 && b.columns == 4)
+      kernel->multiply4(a.data, b.data, product.data);
+   else
+   {
+      libre_matrix_job_t job = {0};
+      job.kernel = kernel;
+      job.a = a;
+      job.b = b;
+      job.c = product;
+      // large products are spread over the pool inside the gemm, so b is only packed once
+      bool gemm = (double)a.rows * b.columns * a.columns >= LIBRE_MATRIX_GEMM_THRESHOLD;
+      if (!gemm || libre_matrix_gemm(kernel, a.rows, b.columns, a.columns, a.data, a.columns, b.data, b.columns, product.data, product.columns))
+         libre_pool_parallel_for(a.rows, libre_matrix_grain((double)b.columns * a.columns, LIBRE_MATRIX_PARALLEL_FLOPS), libre_matrix_multiply_rows, &job);
+   }
 
    if (result)
       *result = 0;
@@ -173,59 +257,243 @@ libre_matrix_t libre_matrix_multiply(libre_matrix_t a, libre_matrix_t b, libre_m
 
 libre_matrix_t libre_matrix_projection_ortho(LIBRE_MATRIX_TYPE l, LIBRE_MATRIX_TYPE r, LIBRE_MATRIX_TYPE t, LIBRE_MATRIX_TYPE b, LIBRE_MATRIX_TYPE n, LIBRE_MATRIX_TYPE f, int *result)
 {
-   libre_matrix_t projection = {0};
-   if (libre_matrix_create(&projection, 4, 4))
+   return libre_mat4_to_matrix(libre_mat4_projection_ortho(l, r, t, b, n, f), NULL, result);
+}
+
+libre_matrix_t libre_matrix_translation(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result)
+{
+   return libre_mat4_to_matrix(libre_mat4_translation(x, y, z), NULL, result);
+}
+
+libre_matrix_t libre_matrix_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result)
+{
+   return libre_mat4_to_matrix(libre_mat4_rotation(w, x, y, z), NULL, result);
+}
+
+libre_vec3_t libre_vec3(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z)
+{
+   libre_vec3_t vector;
+   vector.x = x;
+   vector.y = y;
+   vector.z = z;
+
+   return vector;
+}
+
+libre_vec4_t libre_vec4(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, LIBRE_MATRIX_TYPE w)
+{
+   libre_vec4_t vector;
+   vector.x = x;
+   vector.y = y;
+   vector.z = z;
+   vector.w = w;
+
+   return vector;
+}
+
+libre_mat3_t libre_mat3_identity(void)
+{
+   libre_mat3_t identity = {{0}};
+   for (int i = 0; i < 3; i++)
+      identity.data[i * 3 + i] = (LIBRE_MATRIX_TYPE)1.0;
+
+   return identity;
+}
+
+libre_mat3_t libre_mat3_from_mat4(libre_mat4_t matrix)
+{
+   libre_mat3_t upper;
+   for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+         upper.data[i * 3 + j] = matrix.data[i * 4 + j];
+
+   return upper;
+}
+
+int libre_mat3_from_matrix(libre_matrix_t matrix, libre_mat3_t *destination)
+{
+   if (!destination || matrix.rows != 3 || matrix.columns != 3)
+      return -1;
+
+   memcpy(destination->data, matrix.data, sizeof(destination->data));
+   return 0;
+}
+
+libre_matrix_t libre_mat3_to_matrix(libre_mat3_t matrix, libre_matrix_t *destination, int *result)
+{
+   libre_matrix_t copy = {0};
+
+   if (destination)
+   {
+      if (destination->rows != 3 || destination->columns != 3)
+      {
+         if (result)
+            *result = -1;
+         return copy;
+      }
+      copy = *destination;
+   }
+   else if (libre_matrix_create_ex(&copy, 3, 3, libre_matrix_allocator, LIBRE_MATRIX_UNINITIALIZED))
    {
       if (result)
          *result = -1;
-      return projection;
+      return copy;
    }
 
-   LIBRE_MATRIX_SET(projection, 0, 0, (LIBRE_MATRIX_TYPE)2.0 / (r - l));
-   LIBRE_MATRIX_SET(projection, 1, 1, (LIBRE_MATRIX_TYPE)2.0 / (t - b));
-   LIBRE_MATRIX_SET(projection, 2, 2, (LIBRE_MATRIX_TYPE)2.0 / (f - n));
-   LIBRE_MATRIX_SET(projection, 3, 3, (LIBRE_MATRIX_TYPE)1.0);
-
-   LIBRE_MATRIX_SET(projection, 0, 3, -(r + l) / (r - l));
-   LIBRE_MATRIX_SET(projection, 1, 3, -(t + b) / (t - b));
-   LIBRE_MATRIX_SET(projection, 2, 3, -(f + n) / (f - n));
+   memcpy(copy.data, matrix.data, sizeof(matrix.data));
 
    if (result)
       *result = 0;
-   return projection;
+   return copy;
 }
 
-libre_matrix_t libre_matrix_translation(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result)
+libre_mat3_t libre_mat3_add(libre_mat3_t a, libre_mat3_t b)
+{
+   for (int i = 0; i < 9; i++)
+      a.data[i] += b.data[i];
+
+   return a;
+}
+
+libre_mat3_t libre_mat3_scale(libre_mat3_t matrix, LIBRE_MATRIX_TYPE factor)
+{
+   for (int i = 0; i < 9; i++)
+      matrix.data[i] *= factor;
+
+   return matrix;
+}
+
+libre_mat3_t libre_mat3_multiply(libre_mat3_t a, libre_mat3_t b)
+{
+   libre_mat3_t product;
+   for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+         product.data[i * 3 + j] = a.data[i * 3] * b.data[j] + a.data[i * 3 + 1] * b.data[3 + j] + a.data[i * 3 + 2] * b.data[6 + j];
+
+   return product;
+}
+
+libre_vec3_t libre_mat3_transform(libre_mat3_t matrix, libre_vec3_t vector)
+{
+   libre_vec3_t transformed;
+   transformed.x = matrix.data[0] * vector.x + matrix.data[1] * vector.y + matrix.data[2] * vector.z;
+   transformed.y = matrix.data[3] * vector.x + matrix.data[4] * vector.y + matrix.data[5] * vector.z;
+   transformed.z = matrix.data[6] * vector.x + matrix.data[7] * vector.y + matrix.data[8] * vector.z;
+
+   return transformed;
+}
+
+libre_mat4_t libre_mat4_identity(void)
 {
-   libre_matrix_t translation = {0};
-   if (libre_matrix_create(&translation, 4, 4))
+   libre_mat4_t identity = {{0}};
+   for (int i = 0; i < 4; i++)
+      identity.data[i * 4 + i] = (LIBRE_MATRIX_TYPE)1.0;
+
+   return identity;
+}
+
+int libre_mat4_from_matrix(libre_matrix_t matrix, libre_mat4_t *destination)
+{
+   if (!destination || matrix.rows != 4 || matrix.columns != 4)
+      return -1;
+
+   memcpy(destination->data, matrix.data, sizeof(destination->data));
+   return 0;
+}
+
+libre_matrix_t libre_mat4_to_matrix(libre_mat4_t matrix, libre_matrix_t *destination, int *result)
+{
+   libre_matrix_t copy = {0};
+
+   if (destination)
+   {
+      if (destination->rows != 4 || destination->columns != 4)
+      {
+         if (result)
+            *result = -1;
+         return copy;
+      }
+      copy = *destination;
+   }
+   else if (libre_matrix_create_ex(&copy, 4, 4, libre_matrix_allocator, LIBRE_MATRIX_UNINITIALIZED))
    {
       if (result)
          *result = -1;
-      return translation;
+      return copy;
    }
 
-   for (int i = 0; i < 4; i++)
-      LIBRE_MATRIX_SET(translation, i, i, (LIBRE_MATRIX_TYPE)1.0);
-
-   LIBRE_MATRIX_SET(translation, 0, 3, x);
-   LIBRE_MATRIX_SET(translation, 1, 3, y);
-   LIBRE_MATRIX_SET(translation, 2, 3, z);
+   memcpy(copy.data, matrix.data, sizeof(matrix.data));
 
    if (result)
       *result = 0;
+   return copy;
+}
+
+libre_mat4_t libre_mat4_add(libre_mat4_t a, libre_mat4_t b)
+{
+   for (int i = 0; i < 16; i++)
+      a.data[i] += b.data[i];
+
+   return a;
+}
+
+libre_mat4_t libre_mat4_scale(libre_mat4_t matrix, LIBRE_MATRIX_TYPE factor)
+{
+   for (int i = 0; i < 16; i++)
+      matrix.data[i] *= factor;
+
+   return matrix;
+}
+
+libre_mat4_t libre_mat4_multiply(libre_mat4_t a, libre_mat4_t b)
+{
+   libre_mat4_t product;
+   libre_matrix_kernel()->multiply4(a.data, b.data, product.data);
+
+   return product;
+}
+
+libre_vec4_t libre_mat4_transform(libre_mat4_t matrix, libre_vec4_t vector)
+{
+   libre_vec4_t transformed;
+   transformed.x = matrix.data[0] * vector.x + matrix.data[1] * vector.y + matrix.data[2] * vector.z + matrix.data[3] * vector.w;
+   transformed.y = matrix.data[4] * vector.x + matrix.data[5] * vector.y + matrix.data[6] * vector.z + matrix.data[7] * vector.w;
+   transformed.z = matrix.data[8] * vector.x + matrix.data[9] * vector.y + matrix.data[10] * vector.z + matrix.data[11] * vector.w;
+   transformed.w = matrix.data[12] * vector.x + matrix.data[13] * vector.y + matrix.data[14] * vector.z + matrix.data[15] * vector.w;
+
+   return transformed;
+}
+
+libre_mat4_t libre_mat4_projection_ortho(LIBRE_MATRIX_TYPE l, LIBRE_MATRIX_TYPE r, LIBRE_MATRIX_TYPE t, LIBRE_MATRIX_TYPE b, LIBRE_MATRIX_TYPE n, LIBRE_MATRIX_TYPE f)
+{
+   libre_mat4_t projection = {{0}};
+
+   projection.data[0] = (LIBRE_MATRIX_TYPE)2.0 / (r - l);
+   projection.data[5] = (LIBRE_MATRIX_TYPE)2.0 / (t - b);
+   projection.data[10] = (LIBRE_MATRIX_TYPE)2.0 / (f - n);
+   projection.data[15] = (LIBRE_MATRIX_TYPE)1.0;
+
+   projection.data[3] = -(r + l) / (r - l);
+   projection.data[7] = -(t + b) / (t - b);
+   projection.data[11] = -(f + n) / (f - n);
+
+   return projection;
+}
+
+libre_mat4_t libre_mat4_translation(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z)
+{
+   libre_mat4_t translation = libre_mat4_identity();
+
+   translation.data[3] = x;
+   translation.data[7] = y;
+   translation.data[11] = z;
+
    return translation;
 }
 
-libre_matrix_t libre_matrix_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, int *result)
+libre_mat4_t libre_mat4_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z)
 {
-   libre_matrix_t rotation = {0};
-   if (libre_matrix_create(&rotation, 4, 4))
-   {
-      if (result)
-         *result = -1;
-      return rotation;
-   }
+   libre_mat4_t rotation = {{0}};
 
    LIBRE_MATRIX_TYPE magnitude = 0;
    magnitude += w * w;
@@ -239,21 +507,19 @@ libre_matrix_t libre_matrix_rotation(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, L
    y /= magnitude;
    z /= magnitude;
 
-   LIBRE_MATRIX_SET(rotation, 0, 0, (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * y * y - 2.0 * z * z));
-   LIBRE_MATRIX_SET(rotation, 0, 1, (LIBRE_MATRIX_TYPE)(2.0 * x * y - 2.0 * z * w));
-   LIBRE_MATRIX_SET(rotation, 0, 2, (LIBRE_MATRIX_TYPE)(2.0 * x * z + 2.0 * y * w));
+   rotation.data[0] = (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * y * y - 2.0 * z * z);
+   rotation.data[1] = (LIBRE_MATRIX_TYPE)(2.0 * x * y - 2.0 * z * w);
+   rotation.data[2] = (LIBRE_MATRIX_TYPE)(2.0 * x * z + 2.0 * y * w);
 
-   LIBRE_MATRIX_SET(rotation, 1, 0, (LIBRE_MATRIX_TYPE)(2.0 * x * y + 2.0 * z * w));
-   LIBRE_MATRIX_SET(rotation, 1, 1, (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * x * x + 2.0 * z * z));
-   LIBRE_MATRIX_SET(rotation, 1, 2, (LIBRE_MATRIX_TYPE)(2.0 * y * z - 2.0 * x * w));
+   rotation.data[4] = (LIBRE_MATRIX_TYPE)(2.0 * x * y + 2.0 * z * w);
+   rotation.data[5] = (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * x * x - 2.0 * z * z);
+   rotation.data[6] = (LIBRE_MATRIX_TYPE)(2.0 * y * z - 2.0 * x * w);
 
-   LIBRE_MATRIX_SET(rotation, 2, 0, (LIBRE_MATRIX_TYPE)(2.0 * x * z - 2.0 * y * w));
-   LIBRE_MATRIX_SET(rotation, 2, 1, (LIBRE_MATRIX_TYPE)(2.0 * y * z + 2.0 * x * w));
-   LIBRE_MATRIX_SET(rotation, 2, 2, (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * x * x - 2.0 * y * y));
+   rotation.data[8] = (LIBRE_MATRIX_TYPE)(2.0 * x * z - 2.0 * y * w);
+   rotation.data[9] = (LIBRE_MATRIX_TYPE)(2.0 * y * z + 2.0 * x * w);
+   rotation.data[10] = (LIBRE_MATRIX_TYPE)(1.0 - 2.0 * x * x - 2.0 * y * y);
 
-   LIBRE_MATRIX_SET(rotation, 3, 3, (LIBRE_MATRIX_TYPE)1.0);
+   rotation.data[15] = (LIBRE_MATRIX_TYPE)1.0;
 
-   if (result)
-      *result = 0;
    return rotation;
 }
@@ -0,0 +1,251 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "matrix_kernel.h"
+
+/*
+This file is built with AVX2 and FMA code generation enabled, so nothing in here may run before
+libre_matrix_kernel() has confirmed that the CPU supports both.
+*/
+#if defined(LIBRE_MATRIX_X86) && defined(LIBRE_HAVE_AVX2)
+
+#include <immintrin.h>
+#include <stddef.h>
+
+static void libre_matrix_avx2_multiply4(const float *a, const float *b, float *c)
+{
+   __m128 b0 = _mm_loadu_ps(b);
+   __m128 b1 = _mm_loadu_ps(b + 4);
+   __m128 b2 = _mm_loadu_ps(b + 8);
+   __m128 b3 = _mm_loadu_ps(b + 12);
+
+   for (int i = 0; i < 4; i++)
+   {
+      __m128 row = _mm_mul_ps(_mm_set1_ps(a[i * 4]), b0);
+      row = _mm_fmadd_ps(_mm_set1_ps(a[i * 4 + 1]), b1, row);
+      row = _mm_fmadd_ps(_mm_set1_ps(a[i * 4 + 2]), b2, row);
+      row = _mm_fmadd_ps(_mm_set1_ps(a[i * 4 + 3]), b3, row);
+      _mm_storeu_ps(c + i * 4, row);
+   }
+}
+
+static void libre_matrix_avx2_multiply(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc)
+{
+   for (int i = 0; i < m; i++)
+   {
+      const float *a_row = a + i * lda;
+      float *c_row = c + i * ldc;
+
+      int j = 0;
+      for (; j + 32 <= n; j += 32)
+      {
+         __m256 sum0 = _mm256_setzero_ps();
+         __m256 sum1 = _mm256_setzero_ps();
+         __m256 sum2 = _mm256_setzero_ps();
+         __m256 sum3 = _mm256_setzero_ps();
+
+         for (int l = 0; l < k; l++)
+         {
+            __m256 x = _mm256_set1_ps(a_row[l]);
+            const float *b_row = b + l * ldb + j;
+
+            sum0 = _mm256_fmadd_ps(x, _mm256_loadu_ps(b_row), sum0);
+            sum1 = _mm256_fmadd_ps(x, _mm256_loadu_ps(b_row + 8), sum1);
+            sum2 = _mm256_fmadd_ps(x, _mm256_loadu_ps(b_row + 16), sum2);
+            sum3 = _mm256_fmadd_ps(x, _mm256_loadu_ps(b_row + 24), sum3);
+         }
+
+         _mm256_storeu_ps(c_row + j, sum0);
+         _mm256_storeu_ps(c_row + j + 8, sum1);
+         _mm256_storeu_ps(c_row + j + 16, sum2);
+         _mm256_storeu_ps(c_row + j + 24, sum3);
+      }
+
+      for (; j + 8 <= n; j += 8)
+      {
+         __m256 sum = _mm256_setzero_ps();
+         for (int l = 0; l < k; l++)
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(a_row[l]), _mm256_loadu_ps(b + l * ldb + j), sum);
+
+         _mm256_storeu_ps(c_row + j, sum);
+      }
+
+      for (; j < n; j++)
+      {
+         float sum = 0;
+         for (int l = 0; l < k; l++)
+            sum += a_row[l] * b[l * ldb + j];
+
+         c_row[j] = sum;
+      }
+   }
+}
+
+#define LIBRE_MATRIX_AVX2_GEMM_ROW(i)                  \
+   x = _mm256_broadcast_ss(a + i);                     \
+   c##i##0 = _mm256_fmadd_ps(x, b0, c##i##0);          \
+   c##i##1 = _mm256_fmadd_ps(x, b1, c##i##1);
+
+#define LIBRE_MATRIX_AVX2_GEMM_STORE(i)                                             \
+   _mm256_storeu_ps(c + i * ldc, _mm256_add_ps(_mm256_loadu_ps(c + i * ldc), c##i##0)); \
+   _mm256_storeu_ps(c + i * ldc + 8, _mm256_add_ps(_mm256_loadu_ps(c + i * ldc + 8), c##i##1));
+
+static void libre_matrix_avx2_gemm(int k, const float *a, const float *b, float *c, int ldc)
+{
+   __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+   __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+   __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+   __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+   __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+   __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+   for (int l = 0; l < k; l++)
+   {
+      __m256 b0 = _mm256_loadu_ps(b);
+      __m256 b1 = _mm256_loadu_ps(b + 8);
+      __m256 x;
+
+      LIBRE_MATRIX_AVX2_GEMM_ROW(0)
+      LIBRE_MATRIX_AVX2_GEMM_ROW(1)
+      LIBRE_MATRIX_AVX2_GEMM_ROW(2)
+      LIBRE_MATRIX_AVX2_GEMM_ROW(3)
+      LIBRE_MATRIX_AVX2_GEMM_ROW(4)
+      LIBRE_MATRIX_AVX2_GEMM_ROW(5)
+
+      a += 6;
+      b += 16;
+   }
+
+   LIBRE_MATRIX_AVX2_GEMM_STORE(0)
+   LIBRE_MATRIX_AVX2_GEMM_STORE(1)
+   LIBRE_MATRIX_AVX2_GEMM_STORE(2)
+   LIBRE_MATRIX_AVX2_GEMM_STORE(3)
+   LIBRE_MATRIX_AVX2_GEMM_STORE(4)
+   LIBRE_MATRIX_AVX2_GEMM_STORE(5)
+}
+
+static void libre_matrix_avx2_columns(const float *m, __m128 columns[4])
+{
+   columns[0] = _mm_loadu_ps(m);
+   columns[1] = _mm_loadu_ps(m + 4);
+   columns[2] = _mm_loadu_ps(m + 8);
+   columns[3] = _mm_loadu_ps(m + 12);
+   _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+static void libre_matrix_avx2_transform4(const float *m, const float *vectors, float *destination, int count)
+{
+   __m128 columns[4];
+   libre_matrix_avx2_columns(m, columns);
+
+   __m256 c0 = _mm256_set_m128(columns[0], columns[0]);
+   __m256 c1 = _mm256_set_m128(columns[1], columns[1]);
+   __m256 c2 = _mm256_set_m128(columns[2], columns[2]);
+   __m256 c3 = _mm256_set_m128(columns[3], columns[3]);
+
+   int p = 0;
+   for (; p + 2 <= count; p += 2)
+   {
+      __m256 v = _mm256_loadu_ps(vectors + p * 4);
+
+      __m256 d = _mm256_mul_ps(c0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+      d = _mm256_fmadd_ps(c1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), d);
+      d = _mm256_fmadd_ps(c2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), d);
+      d = _mm256_fmadd_ps(c3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), d);
+      _mm256_storeu_ps(destination + p * 4, d);
+   }
+
+   for (; p < count; p++)
+   {
+      __m128 v = _mm_loadu_ps(vectors + p * 4);
+
+      __m128 d = _mm_mul_ps(columns[0], _mm_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+      d = _mm_fmadd_ps(columns[1], _mm_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), d);
+      d = _mm_fmadd_ps(columns[2], _mm_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), d);
+      d = _mm_fmadd_ps(columns[3], _mm_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3)), d);
+      _mm_storeu_ps(destination + p * 4, d);
+   }
+}
+
+static void libre_matrix_avx2_transform3(const float *m, const float *positions, float *destination, int count)
+{
+   __m128 columns[4];
+   libre_matrix_avx2_columns(m, columns);
+
+   for (int p = 0; p < count; p++)
+   {
+      const float *v = positions + p * 3;
+
+      __m128 d = _mm_fmadd_ps(columns[0], _mm_set1_ps(v[0]), columns[3]);
+      d = _mm_fmadd_ps(columns[1], _mm_set1_ps(v[1]), d);
+      d = _mm_fmadd_ps(columns[2], _mm_set1_ps(v[2]), d);
+
+      _mm_storel_pi((__m64 *)(destination + p * 3), d);
+      _mm_store_ss(destination + p * 3 + 2, _mm_movehl_ps(d, d));
+   }
+}
+
+static void libre_matrix_avx2_transform_soa(const float *m, const float *x, const float *y, const float *z, float *tx, float *ty, float *tz, float *tw, int count)
+{
+   float *outputs[4] = {tx, ty, tz, tw};
+
+   int p = 0;
+   for (; p + 8 <= count; p += 8)
+   {
+      __m256 px = _mm256_loadu_ps(x + p);
+      __m256 py = _mm256_loadu_ps(y + p);
+      __m256 pz = _mm256_loadu_ps(z + p);
+
+      for (int i = 0; i < 4; i++)
+      {
+         if (!outputs[i])
+            continue;
+
+         __m256 d = _mm256_fmadd_ps(_mm256_set1_ps(m[i * 4]), px, _mm256_set1_ps(m[i * 4 + 3]));
+         d = _mm256_fmadd_ps(_mm256_set1_ps(m[i * 4 + 1]), py, d);
+         d = _mm256_fmadd_ps(_mm256_set1_ps(m[i * 4 + 2]), pz, d);
+         _mm256_storeu_ps(outputs[i] + p, d);
+      }
+   }
+
+   libre_matrix_kernel_scalar.transform_soa(m, x + p, y + p, z + p, tx + p, ty + p, tz + p, tw ? tw + p : NULL, count - p);
+}
+
+const libre_matrix_kernel_t libre_matrix_kernel_avx2 = {
+   LIBRE_MATRIX_ISA_AVX2,
+   libre_matrix_avx2_multiply4,
+   libre_matrix_avx2_multiply,
+   6,
+   16,
+   libre_matrix_avx2_gemm,
+   libre_matrix_avx2_transform4,
+   libre_matrix_avx2_transform3,
+   libre_matrix_avx2_transform_soa,
+};
+
+#endif
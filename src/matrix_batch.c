@@ -0,0 +1,133 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "libre/matrix.h"
+#include "libre/pool.h"
+#include "matrix_kernel.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define LIBRE_MATRIX_BATCH_GRAIN 4096
+
+typedef struct libre_matrix_batch
+{
+   const libre_matrix_kernel_t *kernel;
+   float matrix[16];
+   const float *inputs[3];
+   float *outputs[4];
+} libre_matrix_batch_t;
+
+static void libre_matrix_batch_multiply_range(void *argument, int begin, int end)
+{
+   libre_matrix_batch_t *batch = argument;
+
+   for (int i = begin; i < end; i++)
+      batch->kernel->multiply4(batch->matrix, batch->inputs[0] + i * 16, batch->outputs[0] + i * 16);
+}
+
+static void libre_matrix_batch_transform4_range(void *argument, int begin, int end)
+{
+   libre_matrix_batch_t *batch = argument;
+   batch->kernel->transform4(batch->matrix, batch->inputs[0] + begin * 4, batch->outputs[0] + begin * 4, end - begin);
+}
+
+static void libre_matrix_batch_transform3_range(void *argument, int begin, int end)
+{
+   libre_matrix_batch_t *batch = argument;
+   batch->kernel->transform3(batch->matrix, batch->inputs[0] + begin * 3, batch->outputs[0] + begin * 3, end - begin);
+}
+
+static void libre_matrix_batch_transform_soa_range(void *argument, int begin, int end)
+{
+   libre_matrix_batch_t *batch = argument;
+   float *tw = batch->outputs[3] ? batch->outputs[3] + begin : NULL;
+
+   batch->kernel->transform_soa(batch->matrix, batch->inputs[0] + begin, batch->inputs[1] + begin, batch->inputs[2] + begin, batch->outputs[0] + begin, batch->outputs[1] + begin, batch->outputs[2] + begin, tw, end - begin);
+}
+
+static int libre_matrix_batch_run(libre_matrix_batch_t *batch, const float *matrix, int count, int grain, libre_pool_function_t function)
+{
+   if (!matrix || count < 0)
+      return -1;
+
+   // the shared matrix is copied so outputs can overlap it, other threads would read it while it is written otherwise
+   batch->kernel = libre_matrix_kernel();
+   memcpy(batch->matrix, matrix, sizeof(batch->matrix));
+   libre_pool_parallel_for(count, grain, function, batch);
+   return 0;
+}
+
+int libre_matrix_batch_multiply(const LIBRE_MATRIX_TYPE *a, const LIBRE_MATRIX_TYPE *b, LIBRE_MATRIX_TYPE *destination, int count)
+{
+   if (!b || !destination)
+      return -1;
+
+   libre_matrix_batch_t batch = {0};
+   batch.inputs[0] = b;
+   batch.outputs[0] = destination;
+   return libre_matrix_batch_run(&batch, a, count, LIBRE_MATRIX_BATCH_GRAIN / 4, libre_matrix_batch_multiply_range);
+}
+
+int libre_matrix_batch_transform4(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *vectors, LIBRE_MATRIX_TYPE *destination, int count)
+{
+   if (!vectors || !destination)
+      return -1;
+
+   libre_matrix_batch_t batch = {0};
+   batch.inputs[0] = vectors;
+   batch.outputs[0] = destination;
+   return libre_matrix_batch_run(&batch, matrix, count, LIBRE_MATRIX_BATCH_GRAIN, libre_matrix_batch_transform4_range);
+}
+
+int libre_matrix_batch_transform3(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *positions, LIBRE_MATRIX_TYPE *destination, int count)
+{
+   if (!positions || !destination)
+      return -1;
+
+   libre_matrix_batch_t batch = {0};
+   batch.inputs[0] = positions;
+   batch.outputs[0] = destination;
+   return libre_matrix_batch_run(&batch, matrix, count, LIBRE_MATRIX_BATCH_GRAIN, libre_matrix_batch_transform3_range);
+}
+
+int libre_matrix_batch_transform_soa(const LIBRE_MATRIX_TYPE *matrix, const LIBRE_MATRIX_TYPE *x, const LIBRE_MATRIX_TYPE *y, const LIBRE_MATRIX_TYPE *z, LIBRE_MATRIX_TYPE *tx, LIBRE_MATRIX_TYPE *ty, LIBRE_MATRIX_TYPE *tz, LIBRE_MATRIX_TYPE *tw, int count)
+{
+   if (!x || !y || !z || !tx || !ty || !tz)
+      return -1;
+
+   libre_matrix_batch_t batch = {0};
+   batch.inputs[0] = x;
+   batch.inputs[1] = y;
+   batch.inputs[2] = z;
+   batch.outputs[0] = tx;
+   batch.outputs[1] = ty;
+   batch.outputs[2] = tz;
+   batch.outputs[3] = tw;
+   return libre_matrix_batch_run(&batch, matrix, count, LIBRE_MATRIX_BATCH_GRAIN, libre_matrix_batch_transform_soa_range);
+}
@@ -0,0 +1,209 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "libre/pool.h"
+#include "matrix_kernel.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIBRE_MATRIX_GEMM_ALIGNMENT 64
+#define LIBRE_MATRIX_GEMM_TILE 256
+
+static void *libre_matrix_gemm_alloc(size_t size)
+{
+   unsigned char *block = malloc(size + LIBRE_MATRIX_GEMM_ALIGNMENT + sizeof(void *));
+   if (!block)
+      return NULL;
+
+   uintptr_t address = (uintptr_t)(block + sizeof(void *));
+   address = (address + LIBRE_MATRIX_GEMM_ALIGNMENT - 1) & ~(uintptr_t)(LIBRE_MATRIX_GEMM_ALIGNMENT - 1);
+
+   ((void **)address)[-1] = block;
+   return (void *)address;
+}
+
+static void libre_matrix_gemm_free(void *pointer)
+{
+   if (pointer)
+      free(((void **)pointer)[-1]);
+}
+
+static void libre_matrix_gemm_pack_a(int mr, int mc, int kc, const float *a, int lda, float *packed)
+{
+   for (int i = 0; i < mc; i += mr)
+   {
+      int rows = mc - i < mr ? mc - i : mr;
+
+      for (int l = 0; l < kc; l++)
+      {
+         int r = 0;
+         for (; r < rows; r++)
+            packed[r] = a[(i + r) * lda + l];
+         for (; r < mr; r++)
+            packed[r] = 0;
+
+         packed += mr;
+      }
+   }
+}
+
+static void libre_matrix_gemm_pack_b(int nr, int kc, int nc, const float *b, int ldb, float *packed)
+{
+   for (int j = 0; j < nc; j += nr)
+   {
+      int columns = nc - j < nr ? nc - j : nr;
+
+      for (int l = 0; l < kc; l++)
+      {
+         const float *b_row = b + l * ldb + j;
+
+         int c = 0;
+         for (; c < columns; c++)
+            packed[c] = b_row[c];
+         for (; c < nr; c++)
+            packed[c] = 0;
+
+         packed += nr;
+      }
+   }
+}
+
+typedef struct libre_matrix_gemm_job
+{
+   const libre_matrix_kernel_t *kernel;
+   int m, mc_max, kc, nc;
+   const float *a;
+   int lda;
+   const float *b_packed;
+   float *c;
+   int ldc;
+   bool clear;
+   volatile int failed;
+} libre_matrix_gemm_job_t;
+
+static void libre_matrix_gemm_blocks(void *argument, int begin, int end)
+{
+   libre_matrix_gemm_job_t *job = argument;
+   const libre_matrix_kernel_t *kernel = job->kernel;
+   int mr = kernel->mr, nr = kernel->nr, kc = job->kc, nc = job->nc;
+
+   // every chunk packs its own blocks of a, the packed panel of b is shared and only read
+   float *a_packed = libre_matrix_gemm_alloc(sizeof(float) * job->mc_max * kc);
+   if (!a_packed)
+   {
+      job->failed = 1;
+      return;
+   }
+
+   for (int block = begin; block < end; block++)
+   {
+      int ic = block * job->mc_max;
+      int mc = job->m - ic < job->mc_max ? job->m - ic : job->mc_max;
+
+      if (job->clear)
+         for (int i = 0; i < mc; i++)
+            memset(job->c + (ic + i) * job->ldc, 0, sizeof(float) * nc);
+
+      libre_matrix_gemm_pack_a(mr, mc, kc, job->a + ic * job->lda, job->lda, a_packed);
+
+      for (int jr = 0; jr < nc; jr += nr)
+         for (int ir = 0; ir < mc; ir += mr)
+         {
+            const float *a_sliver = a_packed + ir * kc;
+            const float *b_sliver = job->b_packed + jr * kc;
+            float *c_tile = job->c + (ic + ir) * job->ldc + jr;
+
+            if (ir + mr <= mc && jr + nr <= nc)
+            {
+               kernel->gemm(kc, a_sliver, b_sliver, c_tile, job->ldc);
+               continue;
+            }
+
+            float tile[LIBRE_MATRIX_GEMM_TILE] = {0};
+            kernel->gemm(kc, a_sliver, b_sliver, tile, nr);
+
+            int rows = mc - ir < mr ? mc - ir : mr;
+            int columns = nc - jr < nr ? nc - jr : nr;
+            for (int i = 0; i < rows; i++)
+               for (int j = 0; j < columns; j++)
+                  c_tile[i * job->ldc + j] += tile[i * nr + j];
+         }
+   }
+
+   libre_matrix_gemm_free(a_packed);
+}
+
+int libre_matrix_gemm(const libre_matrix_kernel_t *kernel, int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc)
+{
+   int mr = kernel->mr, nr = kernel->nr;
+
+   int mc_max = (LIBRE_MATRIX_GEMM_MC + mr - 1) / mr * mr;
+   int nc_max = n < LIBRE_MATRIX_GEMM_NC ? (n + nr - 1) / nr * nr : LIBRE_MATRIX_GEMM_NC;
+   int kc_max = k < LIBRE_MATRIX_GEMM_KC ? k : LIBRE_MATRIX_GEMM_KC;
+
+   if (mr * nr > LIBRE_MATRIX_GEMM_TILE)
+      return -1;
+
+   float *b_packed = libre_matrix_gemm_alloc(sizeof(float) * kc_max * nc_max);
+   if (!b_packed)
+      return -1;
+
+   libre_matrix_gemm_job_t job = {0};
+   job.kernel = kernel;
+   job.m = m;
+   job.mc_max = mc_max;
+   job.lda = lda;
+   job.b_packed = b_packed;
+   job.ldc = ldc;
+
+   // b is packed once per panel and the row blocks of a are spread over the pool
+   int blocks = (m + mc_max - 1) / mc_max;
+   for (int jc = 0; jc < n && !job.failed; jc += nc_max)
+   {
+      int nc = n - jc < nc_max ? n - jc : nc_max;
+
+      for (int pc = 0; pc < k && !job.failed; pc += kc_max)
+      {
+         int kc = k - pc < kc_max ? k - pc : kc_max;
+         libre_matrix_gemm_pack_b(nr, kc, nc, b + pc * ldb + jc, ldb, b_packed);
+
+         job.kc = kc;
+         job.nc = nc;
+         job.a = a + pc;
+         job.c = c + jc;
+         job.clear = pc == 0;
+         libre_pool_parallel_for(blocks, 1, libre_matrix_gemm_blocks, &job);
+      }
+   }
+
+   libre_matrix_gemm_free(b_packed);
+   return job.failed ? -1 : 0;
+}
@@ -0,0 +1,140 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "matrix_kernel.h"
+
+#include <stddef.h>
+
+#ifdef LIBRE_MATRIX_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+static const libre_matrix_kernel_t *libre_matrix_kernel_current = NULL;
+
+#ifdef LIBRE_MATRIX_X86
+static void libre_matrix_cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+   int values[4];
+   __cpuidex(values, (int)leaf, (int)subleaf);
+   for (int i = 0; i < 4; i++)
+      registers[i] = (unsigned int)values[i];
+#else
+   registers[0] = registers[1] = registers[2] = registers[3] = 0;
+   __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static unsigned long long libre_matrix_xgetbv(unsigned int index)
+{
+#ifdef _MSC_VER
+   return _xgetbv(index);
+#else
+   unsigned int low, high;
+   __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(index));
+   return ((unsigned long long)high << 32) | low;
+#endif
+}
+
+static int libre_matrix_cpu_avx2(void)
+{
+   unsigned int registers[4];
+
+   libre_matrix_cpuid(0, 0, registers);
+   if (registers[0] < 7)
+      return 0;
+
+   libre_matrix_cpuid(1, 0, registers);
+   unsigned int fma = 1u << 12, osxsave = 1u << 27, avx = 1u << 28;
+   if ((registers[2] & (fma | osxsave | avx)) != (fma | osxsave | avx))
+      return 0;
+
+   // the os has to save the ymm registers on context switches
+   if ((libre_matrix_xgetbv(0) & 6) != 6)
+      return 0;
+
+   libre_matrix_cpuid(7, 0, registers);
+   return (registers[1] & (1u << 5)) ? 1 : 0;
+}
+#endif
+
+static const libre_matrix_kernel_t *libre_matrix_kernel_find(int isa)
+{
+   switch (isa)
+   {
+   case LIBRE_MATRIX_ISA_SCALAR:
+      return &libre_matrix_kernel_scalar;
+#ifdef LIBRE_MATRIX_X86
+   case LIBRE_MATRIX_ISA_SSE:
+      return &libre_matrix_kernel_sse;
+#ifdef LIBRE_HAVE_AVX2
+   case LIBRE_MATRIX_ISA_AVX2:
+      return libre_matrix_cpu_avx2() ? &libre_matrix_kernel_avx2 : NULL;
+#endif
+#endif
+#ifdef LIBRE_MATRIX_ARM64
+   case LIBRE_MATRIX_ISA_NEON:
+      return &libre_matrix_kernel_neon;
+#endif
+   default:
+      return NULL;
+   }
+}
+
+const libre_matrix_kernel_t *libre_matrix_kernel(void)
+{
+   if (libre_matrix_kernel_current)
+      return libre_matrix_kernel_current;
+
+   const libre_matrix_kernel_t *kernel = NULL;
+   int preferred[] = {LIBRE_MATRIX_ISA_AVX2, LIBRE_MATRIX_ISA_NEON, LIBRE_MATRIX_ISA_SSE};
+   for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]) && !kernel; i++)
+      kernel = libre_matrix_kernel_find(preferred[i]);
+
+   libre_matrix_kernel_current = kernel ? kernel : &libre_matrix_kernel_scalar;
+   return libre_matrix_kernel_current;
+}
+
+int libre_matrix_isa(void)
+{
+   return libre_matrix_kernel()->isa;
+}
+
+int libre_matrix_set_isa(int isa)
+{
+   const libre_matrix_kernel_t *kernel = libre_matrix_kernel_find(isa);
+   if (!kernel)
+      return -1;
+
+   libre_matrix_kernel_current = kernel;
+   return 0;
+}
@@ -0,0 +1,93 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "libre/matrix.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define LIBRE_MATRIX_X86
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define LIBRE_MATRIX_ARM64
+#endif
+
+/*
+Raw kernels behind the libre_matrix_t API. Matrices are dense and row-major, with the distance between two rows
+given by the ld* arguments so that sub-blocks can be passed without copying.
+*/
+typedef struct libre_matrix_kernel
+{
+   int isa;
+
+   // c = a * b for 4x4 matrices
+   void (*multiply4)(const float *a, const float *b, float *c);
+   // c = a * b where a is m x k, b is k x n and c is m x n
+   void (*multiply)(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc);
+
+   // register-blocked micro-kernel for libre_matrix_gemm: c[mr x nr] += a * b over k packed columns of a and rows of b
+   int mr, nr;
+   void (*gemm)(int k, const float *a, const float *b, float *c, int ldc);
+
+   // batched transforms of count points by the 4x4 matrix m, see libre_matrix_batch_*
+   void (*transform4)(const float *m, const float *vectors, float *destination, int count);
+   void (*transform3)(const float *m, const float *positions, float *destination, int count);
+   void (*transform_soa)(const float *m, const float *x, const float *y, const float *z, float *tx, float *ty, float *tz, float *tw, int count);
+} libre_matrix_kernel_t;
+
+extern const libre_matrix_kernel_t libre_matrix_kernel_scalar;
+#ifdef LIBRE_MATRIX_X86
+extern const libre_matrix_kernel_t libre_matrix_kernel_sse;
+#ifdef LIBRE_HAVE_AVX2
+extern const libre_matrix_kernel_t libre_matrix_kernel_avx2;
+#endif
+#endif
+#ifdef LIBRE_MATRIX_ARM64
+extern const libre_matrix_kernel_t libre_matrix_kernel_neon;
+#endif
+
+const libre_matrix_kernel_t *libre_matrix_kernel(void);
+
+/*
+Products with at least this many multiply-adds go through the cache-blocked GEMM, smaller ones through
+libre_matrix_kernel_t.multiply.
+*/
+#define LIBRE_MATRIX_GEMM_THRESHOLD (128.0 * 128.0 * 128.0)
+
+#define LIBRE_MATRIX_GEMM_MC 120
+#define LIBRE_MATRIX_GEMM_KC 256
+#define LIBRE_MATRIX_GEMM_NC 3072
+
+/*
+Row blocks handed to the pool are never smaller than these, so small inputs stay on the calling thread.
+*/
+#define LIBRE_MATRIX_PARALLEL_ELEMENTS 65536.0
+#define LIBRE_MATRIX_PARALLEL_FLOPS (128.0 * 128.0 * 128.0)
+
+int libre_matrix_gemm(const libre_matrix_kernel_t *kernel, int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc);
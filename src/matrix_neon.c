@@ -0,0 +1,221 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "matrix_kernel.h"
+
+#ifdef LIBRE_MATRIX_ARM64
+
+#include <arm_neon.h>
+#include <stddef.h>
+
+static void libre_matrix_neon_multiply4(const float *a, const float *b, float *c)
+{
+   float32x4_t b0 = vld1q_f32(b);
+   float32x4_t b1 = vld1q_f32(b + 4);
+   float32x4_t b2 = vld1q_f32(b + 8);
+   float32x4_t b3 = vld1q_f32(b + 12);
+
+   for (int i = 0; i < 4; i++)
+   {
+      float32x4_t a_row = vld1q_f32(a + i * 4);
+
+      float32x4_t row = vmulq_laneq_f32(b0, a_row, 0);
+      row = vfmaq_laneq_f32(row, b1, a_row, 1);
+      row = vfmaq_laneq_f32(row, b2, a_row, 2);
+      row = vfmaq_laneq_f32(row, b3, a_row, 3);
+      vst1q_f32(c + i * 4, row);
+   }
+}
+
+static void libre_matrix_neon_multiply(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc)
+{
+   for (int i = 0; i < m; i++)
+   {
+      const float *a_row = a + i * lda;
+      float *c_row = c + i * ldc;
+
+      int j = 0;
+      for (; j + 16 <= n; j += 16)
+      {
+         float32x4_t sum0 = vdupq_n_f32(0);
+         float32x4_t sum1 = vdupq_n_f32(0);
+         float32x4_t sum2 = vdupq_n_f32(0);
+         float32x4_t sum3 = vdupq_n_f32(0);
+
+         for (int l = 0; l < k; l++)
+         {
+            float x = a_row[l];
+            const float *b_row = b + l * ldb + j;
+
+            sum0 = vfmaq_n_f32(sum0, vld1q_f32(b_row), x);
+            sum1 = vfmaq_n_f32(sum1, vld1q_f32(b_row + 4), x);
+            sum2 = vfmaq_n_f32(sum2, vld1q_f32(b_row + 8), x);
+            sum3 = vfmaq_n_f32(sum3, vld1q_f32(b_row + 12), x);
+         }
+
+         vst1q_f32(c_row + j, sum0);
+         vst1q_f32(c_row + j + 4, sum1);
+         vst1q_f32(c_row + j + 8, sum2);
+         vst1q_f32(c_row + j + 12, sum3);
+      }
+
+      for (; j + 4 <= n; j += 4)
+      {
+         float32x4_t sum = vdupq_n_f32(0);
+         for (int l = 0; l < k; l++)
+            sum = vfmaq_n_f32(sum, vld1q_f32(b + l * ldb + j), a_row[l]);
+
+         vst1q_f32(c_row + j, sum);
+      }
+
+      for (; j < n; j++)
+      {
+         float sum = 0;
+         for (int l = 0; l < k; l++)
+            sum += a_row[l] * b[l * ldb + j];
+
+         c_row[j] = sum;
+      }
+   }
+}
+
+#define LIBRE_MATRIX_NEON_GEMM_ROW(i)                 \
+   c##i##0 = vfmaq_laneq_f32(c##i##0, b0, x, i);     \
+   c##i##1 = vfmaq_laneq_f32(c##i##1, b1, x, i);     \
+   c##i##2 = vfmaq_laneq_f32(c##i##2, b2, x, i);     \
+   c##i##3 = vfmaq_laneq_f32(c##i##3, b3, x, i);
+
+#define LIBRE_MATRIX_NEON_GEMM_STORE(i)                                         \
+   vst1q_f32(c + i * ldc, vaddq_f32(vld1q_f32(c + i * ldc), c##i##0));           \
+   vst1q_f32(c + i * ldc + 4, vaddq_f32(vld1q_f32(c + i * ldc + 4), c##i##1));   \
+   vst1q_f32(c + i * ldc + 8, vaddq_f32(vld1q_f32(c + i * ldc + 8), c##i##2));   \
+   vst1q_f32(c + i * ldc + 12, vaddq_f32(vld1q_f32(c + i * ldc + 12), c##i##3));
+
+static void libre_matrix_neon_gemm(int k, const float *a, const float *b, float *c, int ldc)
+{
+   float32x4_t c00 = vdupq_n_f32(0), c01 = vdupq_n_f32(0), c02 = vdupq_n_f32(0), c03 = vdupq_n_f32(0);
+   float32x4_t c10 = vdupq_n_f32(0), c11 = vdupq_n_f32(0), c12 = vdupq_n_f32(0), c13 = vdupq_n_f32(0);
+   float32x4_t c20 = vdupq_n_f32(0), c21 = vdupq_n_f32(0), c22 = vdupq_n_f32(0), c23 = vdupq_n_f32(0);
+   float32x4_t c30 = vdupq_n_f32(0), c31 = vdupq_n_f32(0), c32 = vdupq_n_f32(0), c33 = vdupq_n_f32(0);
+
+   for (int l = 0; l < k; l++)
+   {
+      float32x4_t x = vld1q_f32(a);
+      float32x4_t b0 = vld1q_f32(b);
+      float32x4_t b1 = vld1q_f32(b + 4);
+      float32x4_t b2 = vld1q_f32(b + 8);
+      float32x4_t b3 = vld1q_f32(b + 12);
+
+      LIBRE_MATRIX_NEON_GEMM_ROW(0)
+      LIBRE_MATRIX_NEON_GEMM_ROW(1)
+      LIBRE_MATRIX_NEON_GEMM_ROW(2)
+      LIBRE_MATRIX_NEON_GEMM_ROW(3)
+
+      a += 4;
+      b += 16;
+   }
+
+   LIBRE_MATRIX_NEON_GEMM_STORE(0)
+   LIBRE_MATRIX_NEON_GEMM_STORE(1)
+   LIBRE_MATRIX_NEON_GEMM_STORE(2)
+   LIBRE_MATRIX_NEON_GEMM_STORE(3)
+}
+
+static void libre_matrix_neon_transform4(const float *m, const float *vectors, float *destination, int count)
+{
+   // de-interleaving the rows of m gives its columns
+   float32x4x4_t columns = vld4q_f32(m);
+
+   for (int p = 0; p < count; p++)
+   {
+      float32x4_t v = vld1q_f32(vectors + p * 4);
+
+      float32x4_t d = vmulq_laneq_f32(columns.val[0], v, 0);
+      d = vfmaq_laneq_f32(d, columns.val[1], v, 1);
+      d = vfmaq_laneq_f32(d, columns.val[2], v, 2);
+      d = vfmaq_laneq_f32(d, columns.val[3], v, 3);
+      vst1q_f32(destination + p * 4, d);
+   }
+}
+
+static void libre_matrix_neon_transform3(const float *m, const float *positions, float *destination, int count)
+{
+   float32x4x4_t columns = vld4q_f32(m);
+
+   for (int p = 0; p < count; p++)
+   {
+      const float *v = positions + p * 3;
+
+      float32x4_t d = vfmaq_n_f32(columns.val[3], columns.val[0], v[0]);
+      d = vfmaq_n_f32(d, columns.val[1], v[1]);
+      d = vfmaq_n_f32(d, columns.val[2], v[2]);
+
+      vst1_f32(destination + p * 3, vget_low_f32(d));
+      vst1q_lane_f32(destination + p * 3 + 2, d, 2);
+   }
+}
+
+static void libre_matrix_neon_transform_soa(const float *m, const float *x, const float *y, const float *z, float *tx, float *ty, float *tz, float *tw, int count)
+{
+   float *outputs[4] = {tx, ty, tz, tw};
+
+   int p = 0;
+   for (; p + 4 <= count; p += 4)
+   {
+      float32x4_t px = vld1q_f32(x + p);
+      float32x4_t py = vld1q_f32(y + p);
+      float32x4_t pz = vld1q_f32(z + p);
+
+      for (int i = 0; i < 4; i++)
+      {
+         if (!outputs[i])
+            continue;
+
+         float32x4_t d = vfmaq_n_f32(vdupq_n_f32(m[i * 4 + 3]), px, m[i * 4]);
+         d = vfmaq_n_f32(d, py, m[i * 4 + 1]);
+         d = vfmaq_n_f32(d, pz, m[i * 4 + 2]);
+         vst1q_f32(outputs[i] + p, d);
+      }
+   }
+
+   libre_matrix_kernel_scalar.transform_soa(m, x + p, y + p, z + p, tx + p, ty + p, tz + p, tw ? tw + p : NULL, count - p);
+}
+
+const libre_matrix_kernel_t libre_matrix_kernel_neon = {
+   LIBRE_MATRIX_ISA_NEON,
+   libre_matrix_neon_multiply4,
+   libre_matrix_neon_multiply,
+   4,
+   16,
+   libre_matrix_neon_gemm,
+   libre_matrix_neon_transform4,
+   libre_matrix_neon_transform3,
+   libre_matrix_neon_transform_soa,
+};
+
+#endif
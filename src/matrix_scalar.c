@@ -0,0 +1,128 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "matrix_kernel.h"
+
+static void libre_matrix_scalar_multiply4(const float *a, const float *b, float *c)
+{
+   float product[16];
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+      {
+         float sum = 0;
+         for (int k = 0; k < 4; k++)
+            sum += a[i * 4 + k] * b[k * 4 + j];
+
+         product[i * 4 + j] = sum;
+      }
+
+   for (int i = 0; i < 16; i++)
+      c[i] = product[i];
+}
+
+static void libre_matrix_scalar_multiply(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc)
+{
+   for (int i = 0; i < m; i++)
+      for (int j = 0; j < n; j++)
+      {
+         float sum = 0;
+         for (int l = 0; l < k; l++)
+            sum += a[i * lda + l] * b[l * ldb + j];
+
+         c[i * ldc + j] = sum;
+      }
+}
+
+static void libre_matrix_scalar_gemm(int k, const float *a, const float *b, float *c, int ldc)
+{
+   float sum[4][4] = {{0}};
+
+   for (int l = 0; l < k; l++)
+   {
+      for (int i = 0; i < 4; i++)
+         for (int j = 0; j < 4; j++)
+            sum[i][j] += a[i] * b[j];
+
+      a += 4;
+      b += 4;
+   }
+
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         c[i * ldc + j] += sum[i][j];
+}
+
+static void libre_matrix_scalar_transform4(const float *m, const float *vectors, float *destination, int count)
+{
+   for (int p = 0; p < count; p++)
+   {
+      float v[4] = {vectors[p * 4], vectors[p * 4 + 1], vectors[p * 4 + 2], vectors[p * 4 + 3]};
+      float *d = destination + p * 4;
+
+      for (int i = 0; i < 4; i++)
+         d[i] = m[i * 4] * v[0] + m[i * 4 + 1] * v[1] + m[i * 4 + 2] * v[2] + m[i * 4 + 3] * v[3];
+   }
+}
+
+static void libre_matrix_scalar_transform3(const float *m, const float *positions, float *destination, int count)
+{
+   for (int p = 0; p < count; p++)
+   {
+      float v[3] = {positions[p * 3], positions[p * 3 + 1], positions[p * 3 + 2]};
+      float *d = destination + p * 3;
+
+      for (int i = 0; i < 3; i++)
+         d[i] = m[i * 4] * v[0] + m[i * 4 + 1] * v[1] + m[i * 4 + 2] * v[2] + m[i * 4 + 3];
+   }
+}
+
+static void libre_matrix_scalar_transform_soa(const float *m, const float *x, const float *y, const float *z, float *tx, float *ty, float *tz, float *tw, int count)
+{
+   for (int p = 0; p < count; p++)
+   {
+      float px = x[p], py = y[p], pz = z[p];
+
+      tx[p] = m[0] * px + m[1] * py + m[2] * pz + m[3];
+      ty[p] = m[4] * px + m[5] * py + m[6] * pz + m[7];
+      tz[p] = m[8] * px + m[9] * py + m[10] * pz + m[11];
+      if (tw)
+         tw[p] = m[12] * px + m[13] * py + m[14] * pz + m[15];
+   }
+}
+
+const libre_matrix_kernel_t libre_matrix_kernel_scalar = {
+   LIBRE_MATRIX_ISA_SCALAR,
+   libre_matrix_scalar_multiply4,
+   libre_matrix_scalar_multiply,
+   4,
+   4,
+   libre_matrix_scalar_gemm,
+   libre_matrix_scalar_transform4,
+   libre_matrix_scalar_transform3,
+   libre_matrix_scalar_transform_soa,
+};
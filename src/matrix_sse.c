@@ -0,0 +1,230 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "matrix_kernel.h"
+
+#ifdef LIBRE_MATRIX_X86
+
+#include <emmintrin.h>
+#include <stddef.h>
+
+static void libre_matrix_sse_multiply4(const float *a, const float *b, float *c)
+{
+   __m128 b0 = _mm_loadu_ps(b);
+   __m128 b1 = _mm_loadu_ps(b + 4);
+   __m128 b2 = _mm_loadu_ps(b + 8);
+   __m128 b3 = _mm_loadu_ps(b + 12);
+
+   for (int i = 0; i < 4; i++)
+   {
+      __m128 row = _mm_mul_ps(_mm_set1_ps(a[i * 4]), b0);
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 1]), b1));
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 2]), b2));
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[i * 4 + 3]), b3));
+      _mm_storeu_ps(c + i * 4, row);
+   }
+}
+
+static void libre_matrix_sse_multiply(int m, int n, int k, const float *a, int lda, const float *b, int ldb, float *c, int ldc)
+{
+   for (int i = 0; i < m; i++)
+   {
+      const float *a_row = a + i * lda;
+      float *c_row = c + i * ldc;
+
+      int j = 0;
+      for (; j + 16 <= n; j += 16)
+      {
+         __m128 sum0 = _mm_setzero_ps();
+         __m128 sum1 = _mm_setzero_ps();
+         __m128 sum2 = _mm_setzero_ps();
+         __m128 sum3 = _mm_setzero_ps();
+
+         for (int l = 0; l < k; l++)
+         {
+            __m128 x = _mm_set1_ps(a_row[l]);
+            const float *b_row = b + l * ldb + j;
+
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(x, _mm_loadu_ps(b_row)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(x, _mm_loadu_ps(b_row + 4)));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(x, _mm_loadu_ps(b_row + 8)));
+            sum3 = _mm_add_ps(sum3, _mm_mul_ps(x, _mm_loadu_ps(b_row + 12)));
+         }
+
+         _mm_storeu_ps(c_row + j, sum0);
+         _mm_storeu_ps(c_row + j + 4, sum1);
+         _mm_storeu_ps(c_row + j + 8, sum2);
+         _mm_storeu_ps(c_row + j + 12, sum3);
+      }
+
+      for (; j + 4 <= n; j += 4)
+      {
+         __m128 sum = _mm_setzero_ps();
+         for (int l = 0; l < k; l++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a_row[l]), _mm_loadu_ps(b + l * ldb + j)));
+
+         _mm_storeu_ps(c_row + j, sum);
+      }
+
+      for (; j < n; j++)
+      {
+         float sum = 0;
+         for (int l = 0; l < k; l++)
+            sum += a_row[l] * b[l * ldb + j];
+
+         c_row[j] = sum;
+      }
+   }
+}
+
+static void libre_matrix_sse_gemm(int k, const float *a, const float *b, float *c, int ldc)
+{
+   __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+   __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+   __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+   __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+
+   for (int l = 0; l < k; l++)
+   {
+      __m128 b0 = _mm_loadu_ps(b);
+      __m128 b1 = _mm_loadu_ps(b + 4);
+      __m128 x;
+
+      x = _mm_set1_ps(a[0]);
+      c00 = _mm_add_ps(c00, _mm_mul_ps(x, b0));
+      c01 = _mm_add_ps(c01, _mm_mul_ps(x, b1));
+      x = _mm_set1_ps(a[1]);
+      c10 = _mm_add_ps(c10, _mm_mul_ps(x, b0));
+      c11 = _mm_add_ps(c11, _mm_mul_ps(x, b1));
+      x = _mm_set1_ps(a[2]);
+      c20 = _mm_add_ps(c20, _mm_mul_ps(x, b0));
+      c21 = _mm_add_ps(c21, _mm_mul_ps(x, b1));
+      x = _mm_set1_ps(a[3]);
+      c30 = _mm_add_ps(c30, _mm_mul_ps(x, b0));
+      c31 = _mm_add_ps(c31, _mm_mul_ps(x, b1));
+
+      a += 4;
+      b += 8;
+   }
+
+   _mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), c00));
+   _mm_storeu_ps(c + 4, _mm_add_ps(_mm_loadu_ps(c + 4), c01));
+   c += ldc;
+   _mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), c10));
+   _mm_storeu_ps(c + 4, _mm_add_ps(_mm_loadu_ps(c + 4), c11));
+   c += ldc;
+   _mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), c20));
+   _mm_storeu_ps(c + 4, _mm_add_ps(_mm_loadu_ps(c + 4), c21));
+   c += ldc;
+   _mm_storeu_ps(c, _mm_add_ps(_mm_loadu_ps(c), c30));
+   _mm_storeu_ps(c + 4, _mm_add_ps(_mm_loadu_ps(c + 4), c31));
+}
+
+static void libre_matrix_sse_columns(const float *m, __m128 columns[4])
+{
+   columns[0] = _mm_loadu_ps(m);
+   columns[1] = _mm_loadu_ps(m + 4);
+   columns[2] = _mm_loadu_ps(m + 8);
+   columns[3] = _mm_loadu_ps(m + 12);
+   _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+static void libre_matrix_sse_transform4(const float *m, const float *vectors, float *destination, int count)
+{
+   __m128 columns[4];
+   libre_matrix_sse_columns(m, columns);
+
+   for (int p = 0; p < count; p++)
+   {
+      __m128 v = _mm_loadu_ps(vectors + p * 4);
+
+      __m128 d = _mm_mul_ps(columns[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+      d = _mm_add_ps(d, _mm_mul_ps(columns[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+      d = _mm_add_ps(d, _mm_mul_ps(columns[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+      d = _mm_add_ps(d, _mm_mul_ps(columns[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+      _mm_storeu_ps(destination + p * 4, d);
+   }
+}
+
+static void libre_matrix_sse_transform3(const float *m, const float *positions, float *destination, int count)
+{
+   __m128 columns[4];
+   libre_matrix_sse_columns(m, columns);
+
+   for (int p = 0; p < count; p++)
+   {
+      const float *v = positions + p * 3;
+
+      __m128 d = _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(v[0])), columns[3]);
+      d = _mm_add_ps(d, _mm_mul_ps(columns[1], _mm_set1_ps(v[1])));
+      d = _mm_add_ps(d, _mm_mul_ps(columns[2], _mm_set1_ps(v[2])));
+
+      _mm_storel_pi((__m64 *)(destination + p * 3), d);
+      _mm_store_ss(destination + p * 3 + 2, _mm_movehl_ps(d, d));
+   }
+}
+
+static void libre_matrix_sse_transform_soa(const float *m, const float *x, const float *y, const float *z, float *tx, float *ty, float *tz, float *tw, int count)
+{
+   float *outputs[4] = {tx, ty, tz, tw};
+
+   int p = 0;
+   for (; p + 4 <= count; p += 4)
+   {
+      __m128 px = _mm_loadu_ps(x + p);
+      __m128 py = _mm_loadu_ps(y + p);
+      __m128 pz = _mm_loadu_ps(z + p);
+
+      for (int i = 0; i < 4; i++)
+      {
+         if (!outputs[i])
+            continue;
+
+         __m128 d = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[i * 4]), px), _mm_set1_ps(m[i * 4 + 3]));
+         d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(m[i * 4 + 1]), py));
+         d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(m[i * 4 + 2]), pz));
+         _mm_storeu_ps(outputs[i] + p, d);
+      }
+   }
+
+   libre_matrix_kernel_scalar.transform_soa(m, x + p, y + p, z + p, tx + p, ty + p, tz + p, tw ? tw + p : NULL, count - p);
+}
+
+const libre_matrix_kernel_t libre_matrix_kernel_sse = {
+   LIBRE_MATRIX_ISA_SSE,
+   libre_matrix_sse_multiply4,
+   libre_matrix_sse_multiply,
+   4,
+   8,
+   libre_matrix_sse_gemm,
+   libre_matrix_sse_transform4,
+   libre_matrix_sse_transform3,
+   libre_matrix_sse_transform_soa,
+};
+
+#endif
@@ -29,10 +29,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <GL/glew.h>
 
 #include "libre/opengl.h"
+#include "opengl_state.h"
+#include "thread.h"
 
 #include <GLFW/glfw3.h>
 #include <string.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -41,9 +45,19 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <GL/gl.h>
 #endif
 
+#define LIBRE_OPENGL_SHADER_CACHE_MAGIC 0x4250524cu
+
+typedef struct libre_opengl_shader_cache_header
+{
+    uint32_t magic;
+    GLenum format;
+    uint64_t key;
+    uint32_t size, reserved;
+} libre_opengl_shader_cache_header_t;
+
 libre_opengl_buffer_object_t libre_opengl_buffer_object(libre_window_t window, GLenum target)
 {
-    glfwMakeContextCurrent(window.window);
+    libre_opengl_state(window);
 
     libre_opengl_buffer_object_t buffer_object = {0};
     buffer_object.window = window;
@@ -54,30 +68,406 @@ libre_opengl_buffer_object_t libre_opengl_buffer_object(libre_window_t window, G
     return buffer_object;
 }
 
+static GLenum libre_opengl_buffer_object_target(const libre_opengl_buffer_object_t *buffer_object)
+{
+    // indirect buffers can still be filled and read on contexts that cannot bind them for drawing
+    if (buffer_object->target == GL_DRAW_INDIRECT_BUFFER && !(GLEW_VERSION_4_0 || GLEW_ARB_draw_indirect))
+        return GL_COPY_READ_BUFFER;
+
+    return buffer_object->target;
+}
+
 void libre_opengl_buffer_object_bind(libre_opengl_buffer_object_t buffer_object)
 {
-    glfwMakeContextCurrent(buffer_object.window.window);
-    glBindBuffer(buffer_object.target, buffer_object.id);
+    libre_opengl_state_t *state = libre_opengl_state(buffer_object.window);
+    libre_opengl_state_buffer(state, libre_opengl_buffer_object_target(&buffer_object), buffer_object.id);
+}
+
+static GLsizeiptr libre_opengl_buffer_object_grow(GLsizeiptr capacity, GLsizeiptr required)
+{
+    if (capacity < 64)
+        capacity = 64;
+    while (capacity < required)
+        capacity += capacity / 2;
+
+    return capacity;
+}
+
+static int libre_opengl_buffer_object_resize_shadow(libre_opengl_buffer_object_t *buffer_object, GLsizeiptr capacity)
+{
+    if (!buffer_object->shadow)
+        return 0;
+
+    uint8_t *shadow = realloc(buffer_object->shadow, capacity);
+    if (!shadow)
+        return -1;
+
+    buffer_object->shadow = shadow;
+    return 0;
+}
+
+int libre_opengl_buffer_object_reserve(libre_opengl_buffer_object_t *buffer_object, GLsizeiptr capacity)
+{
+    if (!buffer_object || capacity < 0)
+        return -1;
+    if (capacity <= buffer_object->capacity)
+        return 0;
+
+    if (libre_opengl_buffer_object_resize_shadow(buffer_object, capacity))
+        return -1;
+
+    GLenum target = libre_opengl_buffer_object_target(buffer_object);
+    libre_opengl_state_t *state = libre_opengl_state(buffer_object->window);
+    libre_opengl_state_buffer(state, target, buffer_object->id);
+
+    // keep the buffer name so vaos that reference it stay valid, the contents are copied through a temporary buffer
+    GLuint temporary = 0;
+    if (buffer_object->size > 0 && !buffer_object->shadow)
+    {
+        glGenBuffers(1, &temporary);
+        libre_opengl_state_buffer(state, GL_COPY_WRITE_BUFFER, temporary);
+        glBufferData(GL_COPY_WRITE_BUFFER, buffer_object->size, NULL, GL_STREAM_COPY);
+        glCopyBufferSubData(target, GL_COPY_WRITE_BUFFER, 0, 0, buffer_object->size);
+    }
+
+    glBufferData(target, capacity, NULL, GL_DYNAMIC_DRAW);
+    buffer_object->capacity = capacity;
+
+    if (temporary)
+    {
+        glCopyBufferSubData(GL_COPY_WRITE_BUFFER, target, 0, 0, buffer_object->size);
+        glDeleteBuffers(1, &temporary);
+        libre_opengl_state_delete_buffer(state, temporary);
+    }
+    else if (buffer_object->shadow && buffer_object->size > 0)
+    {
+        glBufferSubData(target, 0, buffer_object->size, buffer_object->shadow);
+        buffer_object->dirty_count = 0;
+        libre_opengl_state_count(buffer_object->window, 0, buffer_object->size, 0);
+    }
+
+    return 0;
+}
+
+int libre_opengl_buffer_object_update(libre_opengl_buffer_object_t *buffer_object, void *data, GLsizeiptr data_size)
+{
+    if (!buffer_object || !data || data_size == 0)
+        return -1;
+
+    if (data_size > buffer_object->capacity)
+    {
+        GLsizeiptr capacity = libre_opengl_buffer_object_grow(buffer_object->capacity, data_size);
+        if (libre_opengl_buffer_object_resize_shadow(buffer_object, capacity))
+            return -1;
+
+        // the old contents are replaced anyway, so there is nothing to preserve
+        libre_opengl_buffer_object_bind(*buffer_object);
+        glBufferData(libre_opengl_buffer_object_target(buffer_object), capacity, NULL, GL_DYNAMIC_DRAW);
+        buffer_object->capacity = capacity;
+    }
+    buffer_object->size = data_size;
+
+    if (buffer_object->shadow)
+    {
+        memcpy(buffer_object->shadow, data, data_size);
+        buffer_object->dirty_count = 0;
+    }
+
+    libre_opengl_buffer_object_bind(*buffer_object);
+    glBufferSubData(libre_opengl_buffer_object_target(buffer_object), 0, data_size, data);
+    libre_opengl_state_count(buffer_object->window, 0, data_size, 0);
+
+    return 0;
+}
+
+static void libre_opengl_buffer_object_mark(libre_opengl_buffer_object_t *buffer_object, GLintptr begin, GLintptr end)
+{
+    libre_opengl_range_t *dirty = buffer_object->dirty;
+    int count = buffer_object->dirty_count;
+
+    // ranges are kept sorted and disjoint, anything touching the new range is absorbed into it
+    int first = 0;
+    while (first < count && dirty[first].end < begin)
+        first++;
+
+    int last = first;
+    while (last < count && dirty[last].begin <= end)
+    {
+        if (dirty[last].begin < begin)
+            begin = dirty[last].begin;
+        if (dirty[last].end > end)
+            end = dirty[last].end;
+        last++;
+    }
+
+    memmove(&dirty[first + 1], &dirty[last], (count - last) * sizeof(*dirty));
+    dirty[first].begin = begin;
+    dirty[first].end = end;
+    count += 1 - (last - first);
+
+    if (count == LIBRE_OPENGL_DIRTY_RANGES_MAX)
+    {
+        // out of slots, merge the two neighbours with the smallest gap
+        int closest = 0;
+        for (int i = 1; i < count - 1; i++)
+            if (dirty[i + 1].begin - dirty[i].end < dirty[closest + 1].begin - dirty[closest].end)
+                closest = i;
+
+        dirty[closest].end = dirty[closest + 1].end;
+        memmove(&dirty[closest + 1], &dirty[closest + 2], (count - closest - 2) * sizeof(*dirty));
+        count--;
+    }
+
+    buffer_object->dirty_count = count;
+}
+
+int libre_opengl_buffer_object_update_range(libre_opengl_buffer_object_t *buffer_object, GLintptr offset, const void *data, GLsizeiptr data_size)
+{
+    if (!buffer_object || !data || offset < 0 || data_size <= 0)
+        return -1;
+
+    GLsizeiptr end = offset + data_size;
+    if (end > buffer_object->capacity && libre_opengl_buffer_object_reserve(buffer_object, libre_opengl_buffer_object_grow(buffer_object->capacity, end)))
+        return -1;
+    if (end > buffer_object->size)
+        buffer_object->size = end;
+
+    if (buffer_object->shadow)
+    {
+        memcpy(buffer_object->shadow + offset, data, data_size);
+        libre_opengl_buffer_object_mark(buffer_object, offset, end);
+        return 0;
+    }
+
+    libre_opengl_buffer_object_bind(*buffer_object);
+    glBufferSubData(libre_opengl_buffer_object_target(buffer_object), offset, data_size, data);
+    libre_opengl_state_count(buffer_object->window, 0, data_size, 0);
+
+    return 0;
+}
+
+int libre_opengl_buffer_object_shadow(libre_opengl_buffer_object_t *buffer_object, bool enabled)
+{
+    if (!buffer_object)
+        return -1;
+
+    if (!enabled)
+    {
+        libre_opengl_buffer_object_flush(buffer_object);
+
+        free(buffer_object->shadow);
+        free(buffer_object->dirty);
+        buffer_object->shadow = NULL;
+        buffer_object->dirty = NULL;
+        buffer_object->dirty_count = 0;
+        return 0;
+    }
+
+    if (buffer_object->shadow)
+        return 0;
+
+    buffer_object->shadow = malloc(buffer_object->capacity > 0 ? buffer_object->capacity : 1);
+    buffer_object->dirty = malloc(LIBRE_OPENGL_DIRTY_RANGES_MAX * sizeof(*buffer_object->dirty));
+    if (!buffer_object->shadow || !buffer_object->dirty)
+    {
+        free(buffer_object->shadow);
+        free(buffer_object->dirty);
+        buffer_object->shadow = NULL;
+        buffer_object->dirty = NULL;
+        return -1;
+    }
+    buffer_object->dirty_count = 0;
+
+    if (buffer_object->size > 0)
+    {
+        libre_opengl_buffer_object_bind(*buffer_object);
+        glGetBufferSubData(libre_opengl_buffer_object_target(buffer_object), 0, buffer_object->size, buffer_object->shadow);
+    }
+
+    return 0;
 }
 
-int libre_opengl_buffer_object_update(libre_opengl_buffer_object_t buffer_object, void *data, GLsizeiptr data_size)
+int libre_opengl_buffer_object_flush(libre_opengl_buffer_object_t *buffer_object)
 {
-    if (!data || data_size == 0)
+    if (!buffer_object)
         return -1;
-    buffer_object.size = data_size;
+    if (buffer_object->dirty_count == 0)
+        return 0;
 
-    libre_opengl_buffer_object_bind(buffer_object);
-    glBufferData(buffer_object.target, data_size, data, GL_STREAM_DRAW);
+    libre_opengl_buffer_object_bind(*buffer_object);
+    uint64_t bytes = 0;
+    for (int i = 0; i < buffer_object->dirty_count; i++)
+    {
+        libre_opengl_range_t range = buffer_object->dirty[i];
+        glBufferSubData(libre_opengl_buffer_object_target(buffer_object), range.begin, range.end - range.begin, buffer_object->shadow + range.begin);
+        bytes += range.end - range.begin;
+    }
+    buffer_object->dirty_count = 0;
+    libre_opengl_state_count(buffer_object->window, 0, bytes, 0);
 
     return 0;
 }
 
+int libre_opengl_buffer_object_update_matrices(libre_opengl_buffer_object_t *buffer_object, const libre_matrix_t *matrices, int count)
+{
+    if (!buffer_object || !matrices || count <= 0)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+        if (matrices[i].rows != 4 || matrices[i].columns != 4 || !matrices[i].data)
+            return -1;
+
+    GLsizeiptr matrix_size = 16 * sizeof(float);
+    GLsizeiptr data_size = count * matrix_size;
+    if (data_size > buffer_object->capacity && libre_opengl_buffer_object_reserve(buffer_object, libre_opengl_buffer_object_grow(buffer_object->capacity, data_size)))
+        return -1;
+    buffer_object->size = data_size;
+
+    if (buffer_object->shadow)
+    {
+        for (int i = 0; i < count; i++)
+            memcpy(buffer_object->shadow + i * matrix_size, matrices[i].data, matrix_size);
+        libre_opengl_buffer_object_mark(buffer_object, 0, data_size);
+        return 0;
+    }
+
+    // each matrix owns its own allocation, so they are gathered straight into the mapped buffer
+    libre_opengl_buffer_object_bind(*buffer_object);
+    uint8_t *dest = glMapBufferRange(libre_opengl_buffer_object_target(buffer_object), 0, data_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dest)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+        memcpy(dest + i * matrix_size, matrices[i].data, matrix_size);
+    libre_opengl_state_count(buffer_object->window, 0, data_size, 0);
+
+    return glUnmapBuffer(libre_opengl_buffer_object_target(buffer_object)) == GL_TRUE ? 0 : -1;
+}
+
 void libre_opengl_buffer_object_destroy(libre_opengl_buffer_object_t buffer_object)
 {
-    glfwMakeContextCurrent(buffer_object.window.window);
+    libre_opengl_state_t *state = libre_opengl_state(buffer_object.window);
 
-    glBindBuffer(buffer_object.target, 0);
     glDeleteBuffers(1, &buffer_object.id);
+    libre_opengl_state_delete_buffer(state, buffer_object.id);
+
+    free(buffer_object.shadow);
+    free(buffer_object.dirty);
+}
+
+int libre_opengl_stream_buffer(libre_window_t window, GLenum target, GLsizeiptr region_size, int regions, libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer)
+        return -1;
+    memset(stream_buffer, 0, sizeof(*stream_buffer));
+
+    if (region_size <= 0 || regions < 1 || regions > LIBRE_OPENGL_STREAM_REGIONS_MAX)
+        return -1;
+
+    stream_buffer->buffer_object = libre_opengl_buffer_object(window, target);
+    stream_buffer->buffer_object.size = region_size * regions;
+    stream_buffer->buffer_object.capacity = stream_buffer->buffer_object.size;
+    stream_buffer->region_size = region_size;
+    stream_buffer->regions = regions;
+
+    libre_opengl_buffer_object_bind(stream_buffer->buffer_object);
+    target = libre_opengl_buffer_object_target(&stream_buffer->buffer_object);
+
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, stream_buffer->buffer_object.size, NULL, flags);
+
+        stream_buffer->mapping = glMapBufferRange(target, 0, stream_buffer->buffer_object.size, flags);
+        if (!stream_buffer->mapping)
+        {
+            libre_opengl_buffer_object_destroy(stream_buffer->buffer_object);
+            memset(stream_buffer, 0, sizeof(*stream_buffer));
+            return -1;
+        }
+        stream_buffer->persistent = true;
+    }
+    else
+        glBufferData(target, stream_buffer->buffer_object.size, NULL, GL_STREAM_DRAW);
+
+    return 0;
+}
+
+void libre_opengl_stream_buffer_wait(libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer)
+        return;
+
+    libre_opengl_state(stream_buffer->buffer_object.window);
+
+    GLsync fence = stream_buffer->fences[stream_buffer->region];
+    if (fence)
+    {
+        GLenum status;
+        do
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        while (status == GL_TIMEOUT_EXPIRED);
+
+        glDeleteSync(fence);
+        stream_buffer->fences[stream_buffer->region] = NULL;
+    }
+
+    stream_buffer->offset = stream_buffer->region * stream_buffer->region_size;
+}
+
+void *libre_opengl_stream_buffer_map(libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer)
+        return NULL;
+
+    libre_opengl_stream_buffer_wait(stream_buffer);
+    if (stream_buffer->persistent)
+        return stream_buffer->mapping + stream_buffer->offset;
+
+    // the fence already guarantees that the gpu is done with this range, so the driver does not need to sync
+    libre_opengl_buffer_object_bind(stream_buffer->buffer_object);
+    return glMapBufferRange(libre_opengl_buffer_object_target(&stream_buffer->buffer_object), stream_buffer->offset, stream_buffer->region_size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void libre_opengl_stream_buffer_unmap(libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer || stream_buffer->persistent)
+        return;
+
+    libre_opengl_buffer_object_bind(stream_buffer->buffer_object);
+    glUnmapBuffer(libre_opengl_buffer_object_target(&stream_buffer->buffer_object));
+}
+
+void libre_opengl_stream_buffer_advance(libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer)
+        return;
+
+    libre_opengl_state(stream_buffer->buffer_object.window);
+
+    stream_buffer->fences[stream_buffer->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream_buffer->region = (stream_buffer->region + 1) % stream_buffer->regions;
+}
+
+void libre_opengl_stream_buffer_destroy(libre_opengl_stream_buffer_t *stream_buffer)
+{
+    if (!stream_buffer)
+        return;
+
+    libre_opengl_state(stream_buffer->buffer_object.window);
+
+    for (int i = 0; i < stream_buffer->regions; i++)
+        if (stream_buffer->fences[i])
+            glDeleteSync(stream_buffer->fences[i]);
+
+    if (stream_buffer->persistent)
+    {
+        libre_opengl_buffer_object_bind(stream_buffer->buffer_object);
+        glUnmapBuffer(libre_opengl_buffer_object_target(&stream_buffer->buffer_object));
+    }
+
+    libre_opengl_buffer_object_destroy(stream_buffer->buffer_object);
+    memset(stream_buffer, 0, sizeof(*stream_buffer));
 }
 
 libre_opengl_vao_t libre_opengl_vao(libre_window_t window)
@@ -85,6 +475,7 @@ libre_opengl_vao_t libre_opengl_vao(libre_window_t window)
     libre_opengl_vao_t vao = {0};
     vao.window = window;
 
+    libre_opengl_state(window);
     glGenVertexArrays(1, &vao.id);
 
     return vao;
@@ -92,100 +483,621 @@ libre_opengl_vao_t libre_opengl_vao(libre_window_t window)
 
 void libre_opengl_vao_bind(libre_opengl_vao_t vao)
 {
-    glBindVertexArray(vao.id);
+    libre_opengl_state_t *state = libre_opengl_state(vao.window);
+    libre_opengl_state_vao(state, vao.id);
 }
 
 void libre_opengl_vao_pointer(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLsizei stride, GLint offset)
+{
+    libre_opengl_vao_pointer_ex(vao, index, size, type, GL_FALSE, stride, offset, 0);
+}
+
+void libre_opengl_vao_pointer_ex(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset, GLuint divisor)
+{
+    libre_opengl_vao_bind(vao);
+    glEnableVertexAttribArray(index);
+
+    glVertexAttribPointer(index, size, type, normalized, stride, (void *)(size_t)offset);
+    glVertexAttribDivisor(index, divisor);
+}
+
+void libre_opengl_vao_pointer_integer(libre_opengl_vao_t vao, GLuint index, GLint size, GLenum type, GLsizei stride, GLintptr offset, GLuint divisor)
 {
     libre_opengl_vao_bind(vao);
     glEnableVertexAttribArray(index);
 
-    glVertexAttribPointer(index, size, type, GL_FALSE, stride, (void *)(size_t)offset);
+    glVertexAttribIPointer(index, size, type, stride, (void *)(size_t)offset);
+    glVertexAttribDivisor(index, divisor);
+}
+
+void libre_opengl_vao_pointer_mat4(libre_opengl_vao_t vao, GLuint index, GLsizei stride, GLintptr offset, GLuint divisor)
+{
+    if (stride == 0)
+        stride = 16 * sizeof(float);
+
+    for (GLuint i = 0; i < 4; i++)
+        libre_opengl_vao_pointer_ex(vao, index + i, 4, GL_FLOAT, GL_FALSE, stride, offset + i * 4 * sizeof(float), divisor);
+}
+
+void libre_opengl_vao_divisor(libre_opengl_vao_t vao, GLuint index, GLuint divisor)
+{
+    libre_opengl_vao_bind(vao);
+    glVertexAttribDivisor(index, divisor);
+}
+
+void libre_opengl_draw_arrays_instanced(libre_opengl_vao_t vao, GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+    libre_opengl_vao_bind(vao);
+    glDrawArraysInstanced(mode, first, count, instances);
+    libre_opengl_state_count(vao.window, 1, 0, 0);
+}
+
+void libre_opengl_draw_elements_instanced(libre_opengl_vao_t vao, GLenum mode, GLsizei count, GLenum type, GLintptr offset, GLsizei instances)
+{
+    libre_opengl_vao_bind(vao);
+    glDrawElementsInstanced(mode, count, type, (void *)(size_t)offset, instances);
+    libre_opengl_state_count(vao.window, 1, 0, 0);
+}
+
+static GLsizeiptr libre_opengl_index_size(GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_UNSIGNED_SHORT:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+static int libre_opengl_draw_elements_commands(GLenum mode, GLenum type, const uint8_t *commands, GLsizei draw_count, GLsizei stride)
+{
+    bool base_instance = GLEW_VERSION_4_2 || GLEW_ARB_base_instance;
+    GLsizeiptr index_size = libre_opengl_index_size(type);
+    int result = 0;
+
+    for (GLsizei i = 0; i < draw_count; i++)
+    {
+        const libre_opengl_draw_elements_command_t *command = (const libre_opengl_draw_elements_command_t *)(commands + i * stride);
+        if (command->count == 0 || command->instance_count == 0)
+            continue;
+
+        void *indices = (void *)(size_t)(command->first_index * index_size);
+        if (base_instance)
+            glDrawElementsInstancedBaseVertexBaseInstance(mode, command->count, type, indices, command->instance_count, command->base_vertex, command->base_instance);
+        else if (command->base_instance == 0)
+            glDrawElementsInstancedBaseVertex(mode, command->count, type, indices, command->instance_count, command->base_vertex);
+        else
+            result = -1;
+    }
+
+    return result;
+}
+
+int libre_opengl_multi_draw_elements_indirect(libre_opengl_vao_t vao, GLenum mode, GLenum type, libre_opengl_buffer_object_t *indirect, GLintptr offset, GLsizei draw_count, GLsizei stride)
+{
+    if (!indirect || indirect->target != GL_DRAW_INDIRECT_BUFFER || offset < 0 || draw_count < 0)
+        return -1;
+    if (stride == 0)
+        stride = sizeof(libre_opengl_draw_elements_command_t);
+    if (draw_count == 0)
+        return 0;
+
+    GLsizeiptr data_size = (GLsizeiptr)(draw_count - 1) * stride + sizeof(libre_opengl_draw_elements_command_t);
+    if (offset + data_size > indirect->size)
+        return -1;
+
+    libre_opengl_vao_bind(vao);
+    libre_opengl_state_count(vao.window, draw_count, 0, 0);
+
+    if (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect)
+    {
+        libre_opengl_buffer_object_flush(indirect);
+        libre_opengl_buffer_object_bind(*indirect);
+        glMultiDrawElementsIndirect(mode, type, (void *)(size_t)offset, draw_count, stride);
+        return 0;
+    }
+
+    if (GLEW_VERSION_4_0 || GLEW_ARB_draw_indirect)
+    {
+        libre_opengl_buffer_object_flush(indirect);
+        libre_opengl_buffer_object_bind(*indirect);
+        for (GLsizei i = 0; i < draw_count; i++)
+            glDrawElementsIndirect(mode, type, (void *)(size_t)(offset + i * stride));
+        return 0;
+    }
+
+    // without indirect draws the commands have to be walked on the cpu, the shadow saves a read back from the gpu
+    if (indirect->shadow)
+        return libre_opengl_draw_elements_commands(mode, type, indirect->shadow + offset, draw_count, stride);
+
+    libre_opengl_buffer_object_bind(*indirect);
+    const uint8_t *commands = glMapBufferRange(GL_COPY_READ_BUFFER, offset, data_size, GL_MAP_READ_BIT);
+    if (!commands)
+        return -1;
+
+    int result = libre_opengl_draw_elements_commands(mode, type, commands, draw_count, stride);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    return result;
 }
 
 void libre_opengl_vao_destroy(libre_opengl_vao_t vao)
 {
-    glBindVertexArray(0);
+    libre_opengl_state_t *state = libre_opengl_state(vao.window);
+
     glDeleteVertexArrays(1, &vao.id);
+    libre_opengl_state_delete_vao(state, vao.id);
+}
+
+static void libre_opengl_shader_build_delete(libre_opengl_shader_build_t *build)
+{
+    if (build->vertex_id)
+        glDeleteShader(build->vertex_id);
+    if (build->fragment_id)
+        glDeleteShader(build->fragment_id);
+    build->vertex_id = 0;
+    build->fragment_id = 0;
+}
+
+static int libre_opengl_shader_build_begin_ex(libre_window_t window, char *vertex_shader, char *fragment_shader, bool retrievable, libre_opengl_shader_build_t *build)
+{
+    if (!build)
+        return -1;
+    memset(build, 0, sizeof(*build));
+
+    build->window = window;
+    build->status = LIBRE_OPENGL_SHADER_BUILD_FAILED;
+    if (!vertex_shader || !fragment_shader)
+        return -1;
+
+    libre_opengl_state(window);
+
+    build->vertex_id = glCreateShader(GL_VERTEX_SHADER);
+    build->fragment_id = glCreateShader(GL_FRAGMENT_SHADER);
+
+    glShaderSource(build->vertex_id, 1, (const char **)&vertex_shader, NULL);
+    glShaderSource(build->fragment_id, 1, (const char **)&fragment_shader, NULL);
+
+    glCompileShader(build->vertex_id);
+    glCompileShader(build->fragment_id);
+
+    // nothing is queried here, a failed compile simply makes the link fail and the logs are collected then
+    build->program = glCreateProgram();
+    if (retrievable)
+        glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(build->program, build->vertex_id);
+    glAttachShader(build->program, build->fragment_id);
+    glLinkProgram(build->program);
+
+    build->status = LIBRE_OPENGL_SHADER_BUILD_PENDING;
+    return 0;
+}
+
+static void libre_opengl_shader_build_append_log(libre_opengl_shader_build_t *build, const char *label, GLuint id, bool program)
+{
+    GLint length = 0;
+    if (program)
+        glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+    else
+        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+    if (length <= 1)
+        return;
+
+    size_t used = build->log ? strlen(build->log) : 0;
+    size_t label_length = strlen(label);
+    char *log = realloc(build->log, used + label_length + length + 2);
+    if (!log)
+        return;
+    build->log = log;
+
+    memcpy(log + used, label, label_length);
+    used += label_length;
+
+    GLsizei written = 0;
+    if (program)
+        glGetProgramInfoLog(id, length, &written, log + used);
+    else
+        glGetShaderInfoLog(id, length, &written, log + used);
+    used += written;
+
+    log[used++] = '\n';
+    log[used] = '\0';
+}
+
+int libre_opengl_shader_build_begin(libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_build_t *build)
+{
+    return libre_opengl_shader_build_begin_ex(window, vertex_shader, fragment_shader, false, build);
+}
+
+int libre_opengl_shader_build_poll(libre_opengl_shader_build_t *build, libre_opengl_shader_t *shader)
+{
+    if (!build)
+        return LIBRE_OPENGL_SHADER_BUILD_FAILED;
+    if (build->status != LIBRE_OPENGL_SHADER_BUILD_PENDING)
+        goto out;
+
+    libre_opengl_state(build->window);
+
+    GLint result = GL_TRUE;
+    if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)
+    {
+        glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &result);
+        if (result != GL_TRUE)
+            return LIBRE_OPENGL_SHADER_BUILD_PENDING;
+    }
+
+    // without the extension this query blocks until the driver is done
+    glGetProgramiv(build->program, GL_LINK_STATUS, &result);
+    if (result == GL_TRUE)
+    {
+        libre_opengl_shader_t reflected = {.window = build->window, .id = build->program};
+        libre_opengl_shader_reflect(&reflected);
+
+        build->reflection = reflected.reflection;
+        build->status = LIBRE_OPENGL_SHADER_BUILD_READY;
+    }
+    else
+    {
+        libre_opengl_shader_build_append_log(build, "vertex: ", build->vertex_id, false);
+        libre_opengl_shader_build_append_log(build, "fragment: ", build->fragment_id, false);
+        libre_opengl_shader_build_append_log(build, "program: ", build->program, true);
+
+        glDeleteProgram(build->program);
+        build->program = 0;
+        build->status = LIBRE_OPENGL_SHADER_BUILD_FAILED;
+    }
+
+    libre_opengl_shader_build_delete(build);
+
+out:
+    if (build->status == LIBRE_OPENGL_SHADER_BUILD_READY && shader)
+    {
+        memset(shader, 0, sizeof(*shader));
+        shader->window = build->window;
+        shader->id = build->program;
+        shader->reflection = build->reflection;
+    }
+
+    return build->status;
+}
+
+int libre_opengl_shader_build_wait(libre_opengl_shader_build_t *build, libre_opengl_shader_t *shader)
+{
+    if (!build)
+        return LIBRE_OPENGL_SHADER_BUILD_FAILED;
+
+    // the link status query blocks on its own, so there is no need to spin on the completion status
+    if (build->status == LIBRE_OPENGL_SHADER_BUILD_PENDING)
+    {
+        libre_opengl_state(build->window);
+
+        GLint result;
+        glGetProgramiv(build->program, GL_LINK_STATUS, &result);
+    }
+
+    int status;
+    while ((status = libre_opengl_shader_build_poll(build, shader)) == LIBRE_OPENGL_SHADER_BUILD_PENDING)
+        ;
+
+    return status;
+}
+
+const char *libre_opengl_shader_build_log(const libre_opengl_shader_build_t *build)
+{
+    return build && build->log ? build->log : "";
+}
+
+void libre_opengl_shader_build_destroy(libre_opengl_shader_build_t *build)
+{
+    if (!build)
+        return;
+
+    // a ready program belongs to the shader handed out by poll, anything else is still owned by the build
+    if (build->status == LIBRE_OPENGL_SHADER_BUILD_PENDING)
+    {
+        libre_opengl_state(build->window);
+        libre_opengl_shader_build_delete(build);
+        glDeleteProgram(build->program);
+    }
+
+    free(build->log);
+    memset(build, 0, sizeof(*build));
+}
+
+void libre_opengl_shader_compiler_threads(libre_window_t window, GLuint threads)
+{
+    libre_opengl_state(window);
+
+    if (GLEW_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(threads);
+    else if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(threads);
+}
+
+static int libre_opengl_shader_build(libre_window_t window, char *vertex_shader, char *fragment_shader, bool retrievable, libre_opengl_shader_t *shader)
+{
+    memset(shader, 0, sizeof(*shader));
+    shader->window = window;
+
+    libre_opengl_shader_build_t build;
+    if (libre_opengl_shader_build_begin_ex(window, vertex_shader, fragment_shader, retrievable, &build))
+        return -1;
+
+    int status = libre_opengl_shader_build_wait(&build, shader);
+    libre_opengl_shader_build_destroy(&build);
+
+    return status == LIBRE_OPENGL_SHADER_BUILD_READY ? 0 : -1;
 }
 
 int libre_opengl_shader(libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_t *shader)
 {
     if (!shader)
         return -1;
-    memset(shader, 0, sizeof(*shader));
 
-    shader->window = window;
+    return libre_opengl_shader_build(window, vertex_shader, fragment_shader, false, shader);
+}
+
+static uint64_t libre_opengl_fnv1a(uint64_t hash, const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static uint64_t libre_opengl_fnv1a_string(uint64_t hash, const char *string)
+{
+    // the terminator is hashed too, so moving text between strings changes the key
+    return libre_opengl_fnv1a(hash, string ? string : "", (string ? strlen(string) : 0) + 1);
+}
+
+int libre_opengl_shader_cache(libre_window_t window, const char *directory, libre_opengl_shader_cache_t *cache)
+{
+    if (!cache)
+        return -1;
+    memset(cache, 0, sizeof(*cache));
+
+    if (!directory)
+        return -1;
 
-    glfwMakeContextCurrent(shader->window.window);
+    cache->directory = malloc(strlen(directory) + 1);
+    if (!cache->directory)
+        return -1;
+    strcpy(cache->directory, directory);
 
-    GLuint vertex_id = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragment_id = glCreateShader(GL_FRAGMENT_SHADER);
+    libre_opengl_state(window);
 
-    glShaderSource(vertex_id, 1, (const char **)&vertex_shader, NULL);
-    glShaderSource(fragment_id, 1, (const char **)&fragment_shader, NULL);
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    cache->supported = formats > 0;
 
-    glCompileShader(vertex_id);
-    glCompileShader(fragment_id);
+    // binaries are only valid for the exact driver that produced them
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = libre_opengl_fnv1a_string(hash, (const char *)glGetString(GL_VENDOR));
+    hash = libre_opengl_fnv1a_string(hash, (const char *)glGetString(GL_RENDERER));
+    hash = libre_opengl_fnv1a_string(hash, (const char *)glGetString(GL_VERSION));
+    hash = libre_opengl_fnv1a_string(hash, (const char *)glGetString(GL_SHADING_LANGUAGE_VERSION));
+    cache->driver = hash;
 
-    GLint result;
-    glGetShaderiv(vertex_id, GL_COMPILE_STATUS, &result);
-    if (result != GL_TRUE)
+    return 0;
+}
+
+static char *libre_opengl_shader_cache_path(const libre_opengl_shader_cache_t *cache, uint64_t key, const char *suffix)
+{
+    size_t size = strlen(cache->directory) + 32;
+    char *path = malloc(size);
+    if (path)
+        snprintf(path, size, "%s/%016llx.%s", cache->directory, (unsigned long long)key, suffix);
+
+    return path;
+}
+
+static int libre_opengl_shader_cache_load(libre_opengl_shader_cache_t *cache, libre_window_t window, uint64_t key, libre_opengl_shader_t *shader)
+{
+    char *path = libre_opengl_shader_cache_path(cache, key, "bin");
+    if (!path)
+        return -1;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
     {
-        glDeleteShader(vertex_id);
-        glDeleteShader(fragment_id);
+        free(path);
         return -1;
     }
 
-    glGetShaderiv(fragment_id, GL_COMPILE_STATUS, &result);
-    if (result != GL_TRUE)
+    libre_opengl_shader_cache_header_t header;
+    uint8_t *binary = NULL;
+    int result = -1;
+
+    if (fread(&header, sizeof(header), 1, file) == 1 && header.magic == LIBRE_OPENGL_SHADER_CACHE_MAGIC && header.key == key && header.size > 0)
     {
-        glDeleteShader(vertex_id);
-        glDeleteShader(fragment_id);
-        return -1;
+        binary = malloc(header.size);
+        if (binary && fread(binary, 1, header.size, file) == header.size)
+        {
+            memset(shader, 0, sizeof(*shader));
+            shader->window = window;
+            shader->id = glCreateProgram();
+            glProgramBinary(shader->id, header.format, binary, (GLsizei)header.size);
+
+            GLint status = GL_FALSE;
+            glGetProgramiv(shader->id, GL_LINK_STATUS, &status);
+            if (status == GL_TRUE)
+            {
+                libre_opengl_shader_reflect(shader);
+                result = 0;
+            }
+            else
+            {
+                glDeleteProgram(shader->id);
+                shader->id = 0;
+            }
+        }
     }
 
-    shader->id = glCreateProgram();
-    glAttachShader(shader->id, vertex_id);
-    glAttachShader(shader->id, fragment_id);
-    glLinkProgram(shader->id);
+    free(binary);
+    fclose(file);
 
-    glGetProgramiv(shader->id, GL_LINK_STATUS, &result);
-    if (result != GL_TRUE)
+    // a binary the driver rejects will never load again, so it is dropped and rebuilt from source
+    if (result)
     {
-        glDeleteShader(vertex_id);
-        glDeleteShader(fragment_id);
+        remove(path);
+        cache->stats.rejected++;
+    }
+
+    free(path);
+    return result;
+}
+
+static void libre_opengl_shader_cache_store(libre_opengl_shader_cache_t *cache, uint64_t key, libre_opengl_shader_t shader)
+{
+    GLint size = 0;
+    glGetProgramiv(shader.id, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return;
+
+    uint8_t *binary = malloc(size);
+    char *temporary = libre_opengl_shader_cache_path(cache, key, "tmp");
+    char *path = libre_opengl_shader_cache_path(cache, key, "bin");
+    if (!binary || !temporary || !path)
+        goto out;
+
+    libre_opengl_shader_cache_header_t header = {0};
+    header.magic = LIBRE_OPENGL_SHADER_CACHE_MAGIC;
+    header.key = key;
+
+    GLsizei length = 0;
+    glGetProgramBinary(shader.id, size, &length, &header.format, binary);
+    if (length <= 0)
+        goto out;
+    header.size = (uint32_t)length;
+
+    // written to a temporary file first so a crash never leaves a truncated binary behind
+    FILE *file = fopen(temporary, "wb");
+    if (!file)
+        goto out;
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t)length;
+    if (fclose(file) || !written)
+    {
+        remove(temporary);
+        goto out;
+    }
+
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(temporary, path))
+        remove(temporary);
+    else
+        cache->stats.stored++;
+
+out:
+    free(path);
+    free(temporary);
+    free(binary);
+}
+
+int libre_opengl_shader_cached(libre_opengl_shader_cache_t *cache, libre_window_t window, char *vertex_shader, char *fragment_shader, libre_opengl_shader_t *shader)
+{
+    if (!cache || !shader || !vertex_shader || !fragment_shader)
         return -1;
+
+    if (!cache->supported)
+        return libre_opengl_shader(window, vertex_shader, fragment_shader, shader);
+
+    libre_opengl_state(window);
+
+    uint64_t key = cache->driver;
+    key = libre_opengl_fnv1a_string(key, vertex_shader);
+    key = libre_opengl_fnv1a_string(key, fragment_shader);
+
+    double start = libre_clock_seconds();
+    if (libre_opengl_shader_cache_load(cache, window, key, shader) == 0)
+    {
+        cache->stats.hits++;
+        cache->stats.hit_seconds += libre_clock_seconds() - start;
+        return 0;
     }
 
-    glDeleteShader(vertex_id);
-    glDeleteShader(fragment_id);
+    start = libre_clock_seconds();
+    if (libre_opengl_shader_build(window, vertex_shader, fragment_shader, true, shader))
+        return -1;
+
+    cache->stats.misses++;
+    cache->stats.miss_seconds += libre_clock_seconds() - start;
+
+    libre_opengl_shader_cache_store(cache, key, *shader);
     return 0;
 }
 
+libre_opengl_shader_cache_stats_t libre_opengl_shader_cache_stats(const libre_opengl_shader_cache_t *cache)
+{
+    libre_opengl_shader_cache_stats_t stats = {0};
+    if (!cache)
+        return stats;
+
+    // estimated from the average cost of the programs that did have to be built from source
+    stats = cache->stats;
+    if (stats.misses > 0)
+        stats.saved_seconds = stats.hits * (stats.miss_seconds / stats.misses) - stats.hit_seconds;
+
+    return stats;
+}
+
+void libre_opengl_shader_cache_destroy(libre_opengl_shader_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    free(cache->directory);
+    memset(cache, 0, sizeof(*cache));
+}
+
 void libre_opengl_shader_use(libre_opengl_shader_t shader)
 {
-    glfwMakeContextCurrent(shader.window.window);
-    glUseProgram(shader.id);
+    libre_opengl_state_t *state = libre_opengl_state(shader.window);
+    libre_opengl_state_program(state, shader.id);
 }
 
 GLint libre_opengl_shader_attrib_location(libre_opengl_shader_t shader, char *name)
 {
-    libre_opengl_shader_use(shader);
+    if (shader.reflection)
+    {
+        const libre_opengl_shader_variable_t *variable = libre_opengl_shader_variable(shader, LIBRE_OPENGL_VARIABLE_ATTRIBUTE, name);
+        return variable ? variable->location : -1;
+    }
+
+    libre_opengl_state(shader.window);
     return glGetAttribLocation(shader.id, name);
 }
 
 void libre_opengl_shader_destroy(libre_opengl_shader_t shader)
 {
+    libre_opengl_state_t *state = libre_opengl_state(shader.window);
+
     glDeleteProgram(shader.id);
+    libre_opengl_state_delete_program(state, shader.id);
+
+    libre_opengl_shader_reflection_destroy(shader.reflection);
 }
 
 libre_opengl_texture_t libre_opengl_texture(libre_window_t window, GLsizei width, GLsizei height, uint8_t *data, GLint wrap, GLint filter)
 {
     libre_opengl_texture_t texture = {0};
     texture.window = window;
+    texture.width = width;
+    texture.height = height;
+    texture.levels = libre_opengl_texture_levels(width, height);
+    texture.internal_format = GL_RGBA8;
 
-    glfwMakeContextCurrent(texture.window.window);
+    libre_opengl_state(texture.window);
 
     glCreateTextures(GL_TEXTURE_2D, 1, &texture.id);
     libre_opengl_texture_bind(texture);
@@ -195,17 +1107,28 @@ libre_opengl_texture_t libre_opengl_texture(libre_window_t window, GLsizei width
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
     glGenerateMipmap(GL_TEXTURE_2D);
+    if (data)
+        libre_opengl_state_count(texture.window, 0, 0, (uint64_t)width * height * 4);
 
     return texture;
 }
 
 void libre_opengl_texture_bind(libre_opengl_texture_t texture)
 {
-    glBindTexture(GL_TEXTURE_2D, texture.id);
+    libre_opengl_texture_bind_unit(texture, 0);
+}
+
+void libre_opengl_texture_bind_unit(libre_opengl_texture_t texture, GLuint unit)
+{
+    libre_opengl_state_t *state = libre_opengl_state(texture.window);
+    libre_opengl_state_active_texture(state, unit);
+    libre_opengl_state_texture(state, GL_TEXTURE_2D, texture.id);
 }
 
 void libre_opengl_texture_destroy(libre_opengl_texture_t texture)
 {
-    glBindTexture(GL_TEXTURE_2D, 0);
+    libre_opengl_state_t *state = libre_opengl_state(texture.window);
+
     glDeleteTextures(1, &texture.id);
+    libre_opengl_state_delete_texture(state, texture.id);
 }
@@ -0,0 +1,376 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/opengl.h"
+#include "opengl_state.h"
+
+#include <string.h>
+
+static GLenum libre_opengl_framebuffer_depth_attachment(GLenum depth_format)
+{
+    if (depth_format == GL_DEPTH24_STENCIL8 || depth_format == GL_DEPTH32F_STENCIL8)
+        return GL_DEPTH_STENCIL_ATTACHMENT;
+
+    return GL_DEPTH_ATTACHMENT;
+}
+
+static GLuint libre_opengl_framebuffer_renderbuffer(GLenum internal_format, GLsizei width, GLsizei height, GLsizei samples, GLenum attachment)
+{
+    GLuint renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internal_format, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
+
+    return renderbuffer;
+}
+
+static void libre_opengl_framebuffer_draw_buffers(int color_count)
+{
+    GLenum buffers[LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX];
+    for (int i = 0; i < color_count; i++)
+        buffers[i] = GL_COLOR_ATTACHMENT0 + i;
+
+    if (color_count > 0)
+        glDrawBuffers(color_count, buffers);
+    else
+    {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+}
+
+int libre_opengl_framebuffer(libre_window_t window, GLsizei width, GLsizei height, const GLenum *color_formats, int color_count, GLenum depth_format, GLsizei samples, libre_opengl_framebuffer_t *framebuffer)
+{
+    if (!framebuffer)
+        return -1;
+    memset(framebuffer, 0, sizeof(*framebuffer));
+
+    if (width <= 0 || height <= 0 || color_count < 0 || color_count > LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX || (color_count > 0 && !color_formats))
+        return -1;
+    if (color_count == 0 && !depth_format)
+        return -1;
+
+    libre_opengl_state_t *state = libre_opengl_state(window);
+
+    GLint max_samples = 0;
+    glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+    if (samples > max_samples)
+        samples = max_samples;
+    if (samples < 1)
+        samples = 1;
+
+    framebuffer->window = window;
+    framebuffer->width = width;
+    framebuffer->height = height;
+    framebuffer->samples = samples;
+    framebuffer->color_count = color_count;
+
+    // the textures always live on a single sampled framebuffer, multisampled rendering gets its own in front of it
+    GLuint texture_framebuffer;
+    glGenFramebuffers(1, &texture_framebuffer);
+    if (samples > 1)
+        framebuffer->resolve_id = texture_framebuffer;
+    else
+        framebuffer->id = texture_framebuffer;
+
+    libre_opengl_state_framebuffer(state, GL_FRAMEBUFFER, texture_framebuffer);
+    for (int i = 0; i < color_count; i++)
+    {
+        if (libre_opengl_texture_storage(window, color_formats[i], width, height, 1, GL_CLAMP_TO_EDGE, GL_LINEAR, &framebuffer->colors[i]))
+        {
+            libre_opengl_framebuffer_destroy(framebuffer);
+            return -1;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, framebuffer->colors[i].id, 0);
+    }
+
+    if (depth_format)
+    {
+        if (libre_opengl_texture_storage(window, depth_format, width, height, 1, GL_CLAMP_TO_EDGE, GL_NEAREST, &framebuffer->depth))
+        {
+            libre_opengl_framebuffer_destroy(framebuffer);
+            return -1;
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, libre_opengl_framebuffer_depth_attachment(depth_format), GL_TEXTURE_2D, framebuffer->depth.id, 0);
+    }
+
+    libre_opengl_framebuffer_draw_buffers(color_count);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        libre_opengl_framebuffer_destroy(framebuffer);
+        return -1;
+    }
+
+    if (samples == 1)
+        return 0;
+
+    glGenFramebuffers(1, &framebuffer->id);
+    libre_opengl_state_framebuffer(state, GL_FRAMEBUFFER, framebuffer->id);
+    for (int i = 0; i < color_count; i++)
+        framebuffer->color_renderbuffers[i] = libre_opengl_framebuffer_renderbuffer(color_formats[i], width, height, samples, GL_COLOR_ATTACHMENT0 + i);
+    if (depth_format)
+        framebuffer->depth_renderbuffer = libre_opengl_framebuffer_renderbuffer(depth_format, width, height, samples, libre_opengl_framebuffer_depth_attachment(depth_format));
+
+    libre_opengl_framebuffer_draw_buffers(color_count);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        libre_opengl_framebuffer_destroy(framebuffer);
+        return -1;
+    }
+
+    return 0;
+}
+
+void libre_opengl_framebuffer_bind(const libre_opengl_framebuffer_t *framebuffer)
+{
+    if (!framebuffer)
+        return;
+
+    libre_opengl_state_t *state = libre_opengl_state(framebuffer->window);
+    libre_opengl_state_framebuffer(state, GL_FRAMEBUFFER, framebuffer->id);
+    glViewport(0, 0, framebuffer->width, framebuffer->height);
+}
+
+void libre_opengl_framebuffer_bind_default(libre_window_t window)
+{
+    libre_opengl_state_t *state = libre_opengl_state(window);
+    libre_opengl_state_framebuffer(state, GL_FRAMEBUFFER, 0);
+
+    int width, height;
+    libre_window_get_size(window, &width, &height);
+    glViewport(0, 0, width, height);
+}
+
+void libre_opengl_framebuffer_resolve(const libre_opengl_framebuffer_t *framebuffer)
+{
+    if (!framebuffer || !framebuffer->resolve_id)
+        return;
+
+    libre_opengl_state_t *state = libre_opengl_state(framebuffer->window);
+    libre_opengl_state_framebuffer(state, GL_READ_FRAMEBUFFER, framebuffer->id);
+    libre_opengl_state_framebuffer(state, GL_DRAW_FRAMEBUFFER, framebuffer->resolve_id);
+
+    // a blit only copies the read buffer, so every color attachment is resolved on its own
+    GLenum buffers[LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX];
+    for (int i = 0; i < framebuffer->color_count; i++)
+    {
+        for (int j = 0; j < framebuffer->color_count; j++)
+            buffers[j] = i == j ? GL_COLOR_ATTACHMENT0 + i : GL_NONE;
+
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+        glDrawBuffers(framebuffer->color_count, buffers);
+        glBlitFramebuffer(0, 0, framebuffer->width, framebuffer->height, 0, 0, framebuffer->width, framebuffer->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+
+    if (framebuffer->depth_renderbuffer)
+    {
+        GLbitfield mask = GL_DEPTH_BUFFER_BIT;
+        if (libre_opengl_framebuffer_depth_attachment(framebuffer->depth.internal_format) == GL_DEPTH_STENCIL_ATTACHMENT)
+            mask |= GL_STENCIL_BUFFER_BIT;
+        glBlitFramebuffer(0, 0, framebuffer->width, framebuffer->height, 0, 0, framebuffer->width, framebuffer->height, mask, GL_NEAREST);
+    }
+
+    if (framebuffer->color_count > 0)
+    {
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        libre_opengl_framebuffer_draw_buffers(framebuffer->color_count);
+    }
+}
+
+void libre_opengl_framebuffer_destroy(libre_opengl_framebuffer_t *framebuffer)
+{
+    if (!framebuffer)
+        return;
+
+    libre_opengl_state_t *state = libre_opengl_state(framebuffer->window);
+
+    GLuint framebuffers[2] = {framebuffer->id, framebuffer->resolve_id};
+    for (int i = 0; i < 2; i++)
+        if (framebuffers[i])
+        {
+            glDeleteFramebuffers(1, &framebuffers[i]);
+            libre_opengl_state_delete_framebuffer(state, framebuffers[i]);
+        }
+
+    for (int i = 0; i < LIBRE_OPENGL_FRAMEBUFFER_COLORS_MAX; i++)
+    {
+        if (framebuffer->colors[i].id)
+            libre_opengl_texture_destroy(framebuffer->colors[i]);
+        if (framebuffer->color_renderbuffers[i])
+            glDeleteRenderbuffers(1, &framebuffer->color_renderbuffers[i]);
+    }
+
+    if (framebuffer->depth.id)
+        libre_opengl_texture_destroy(framebuffer->depth);
+    if (framebuffer->depth_renderbuffer)
+        glDeleteRenderbuffers(1, &framebuffer->depth_renderbuffer);
+
+    memset(framebuffer, 0, sizeof(*framebuffer));
+}
+
+int libre_opengl_readback(libre_window_t window, GLsizei width, GLsizei height, GLenum format, GLenum type, int slots, libre_opengl_readback_t *readback)
+{
+    if (!readback)
+        return -1;
+    memset(readback, 0, sizeof(*readback));
+
+    GLsizei pixel_size = libre_opengl_pixel_size(format, type);
+    if (width <= 0 || height <= 0 || pixel_size == 0 || slots < 1 || slots > LIBRE_OPENGL_READBACK_SLOTS_MAX)
+        return -1;
+
+    libre_opengl_state_t *state = libre_opengl_state(window);
+
+    readback->window = window;
+    readback->format = format;
+    readback->type = type;
+    readback->slot_size = (GLsizeiptr)width * height * pixel_size;
+    readback->slots = slots;
+
+    for (int i = 0; i < slots; i++)
+    {
+        readback->pbos[i] = libre_opengl_buffer_object(window, GL_PIXEL_PACK_BUFFER);
+        libre_opengl_buffer_object_bind(readback->pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, readback->slot_size, NULL, GL_STREAM_READ);
+        readback->pbos[i].size = readback->slot_size;
+        readback->pbos[i].capacity = readback->slot_size;
+    }
+    libre_opengl_state_buffer(state, GL_PIXEL_PACK_BUFFER, 0);
+
+    return 0;
+}
+
+int libre_opengl_readback_request(libre_opengl_readback_t *readback, const libre_opengl_framebuffer_t *framebuffer, int attachment, GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (!readback || readback->count == readback->slots || width <= 0 || height <= 0)
+        return -1;
+    if ((GLsizeiptr)width * height * libre_opengl_pixel_size(readback->format, readback->type) > readback->slot_size)
+        return -1;
+    if (framebuffer && (attachment < 0 || (readback->format != GL_DEPTH_COMPONENT && readback->format != GL_DEPTH_STENCIL && attachment >= framebuffer->color_count)))
+        return -1;
+
+    libre_opengl_state_t *state = libre_opengl_state(readback->window);
+
+    // multisampled framebuffers are read after libre_opengl_framebuffer_resolve
+    GLuint id = 0;
+    if (framebuffer)
+        id = framebuffer->resolve_id ? framebuffer->resolve_id : framebuffer->id;
+    libre_opengl_state_framebuffer(state, GL_READ_FRAMEBUFFER, id);
+    if (framebuffer && framebuffer->color_count > 0)
+        glReadBuffer(GL_COLOR_ATTACHMENT0 + attachment);
+
+    int slot = (readback->head + readback->count) % readback->slots;
+    libre_opengl_buffer_object_bind(readback->pbos[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, y, width, height, readback->format, readback->type, NULL);
+    libre_opengl_state_buffer(state, GL_PIXEL_PACK_BUFFER, 0);
+
+    readback->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback->widths[slot] = width;
+    readback->heights[slot] = height;
+    readback->count++;
+
+    return 0;
+}
+
+static int libre_opengl_readback_copy(libre_opengl_readback_t *readback, GLuint64 timeout, void *pixels, GLsizei *width, GLsizei *height)
+{
+    if (!readback || readback->count == 0)
+        return -1;
+
+    libre_opengl_state_t *state = libre_opengl_state(readback->window);
+
+    int slot = readback->head;
+    GLenum status;
+    do
+        status = glClientWaitSync(readback->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    while (status == GL_TIMEOUT_EXPIRED && timeout > 0);
+
+    if (status == GL_TIMEOUT_EXPIRED)
+        return 0;
+
+    glDeleteSync(readback->fences[slot]);
+    readback->fences[slot] = NULL;
+    readback->head = (readback->head + 1) % readback->slots;
+    readback->count--;
+
+    if (status == GL_WAIT_FAILED)
+        return -1;
+
+    GLsizeiptr size = (GLsizeiptr)readback->widths[slot] * readback->heights[slot] * libre_opengl_pixel_size(readback->format, readback->type);
+    int result = 1;
+    if (pixels)
+    {
+        libre_opengl_buffer_object_bind(readback->pbos[slot]);
+        void *mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (mapping)
+        {
+            memcpy(pixels, mapping, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+            result = -1;
+        libre_opengl_state_buffer(state, GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    if (width)
+        *width = readback->widths[slot];
+    if (height)
+        *height = readback->heights[slot];
+
+    return result;
+}
+
+int libre_opengl_readback_poll(libre_opengl_readback_t *readback, void *pixels, GLsizei *width, GLsizei *height)
+{
+    return libre_opengl_readback_copy(readback, 0, pixels, width, height);
+}
+
+int libre_opengl_readback_wait(libre_opengl_readback_t *readback, void *pixels, GLsizei *width, GLsizei *height)
+{
+    return libre_opengl_readback_copy(readback, 1000000, pixels, width, height);
+}
+
+void libre_opengl_readback_destroy(libre_opengl_readback_t *readback)
+{
+    if (!readback)
+        return;
+
+    libre_opengl_state(readback->window);
+
+    for (int i = 0; i < readback->slots; i++)
+    {
+        if (readback->fences[i])
+            glDeleteSync(readback->fences[i]);
+        libre_opengl_buffer_object_destroy(readback->pbos[i]);
+    }
+
+    memset(readback, 0, sizeof(*readback));
+}
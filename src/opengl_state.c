@@ -0,0 +1,404 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "opengl_state.h"
+#include "thread.h"
+
+#include <GLFW/glfw3.h>
+#include <string.h>
+
+static libre_opengl_state_t libre_opengl_states[LIBRE_OPENGL_STATE_CONTEXTS];
+static LIBRE_THREAD_LOCAL libre_opengl_state_t *libre_opengl_state_last;
+
+static const GLenum libre_opengl_state_buffer_targets[LIBRE_OPENGL_STATE_BUFFER_TARGETS] = {
+    GL_ARRAY_BUFFER,
+    GL_ELEMENT_ARRAY_BUFFER,
+    GL_COPY_READ_BUFFER,
+    GL_COPY_WRITE_BUFFER,
+    GL_PIXEL_PACK_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER,
+    GL_UNIFORM_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER,
+    GL_TEXTURE_BUFFER,
+    GL_QUERY_BUFFER,
+};
+
+static const GLenum libre_opengl_state_texture_targets[LIBRE_OPENGL_STATE_TEXTURE_TARGETS] = {
+    GL_TEXTURE_2D,
+    GL_TEXTURE_2D_ARRAY,
+    GL_TEXTURE_CUBE_MAP,
+    GL_TEXTURE_2D_MULTISAMPLE,
+};
+
+static int libre_opengl_state_buffer_index(GLenum target)
+{
+    for (int i = 0; i < LIBRE_OPENGL_STATE_BUFFER_TARGETS; i++)
+        if (libre_opengl_state_buffer_targets[i] == target)
+            return i;
+
+    return -1;
+}
+
+static int libre_opengl_state_texture_index(GLenum target)
+{
+    for (int i = 0; i < LIBRE_OPENGL_STATE_TEXTURE_TARGETS; i++)
+        if (libre_opengl_state_texture_targets[i] == target)
+            return i;
+
+    return -1;
+}
+
+static void libre_opengl_state_clear(libre_opengl_state_t *state)
+{
+    state->program = LIBRE_OPENGL_STATE_UNKNOWN;
+    state->vao = LIBRE_OPENGL_STATE_UNKNOWN;
+    state->draw_framebuffer = LIBRE_OPENGL_STATE_UNKNOWN;
+    state->read_framebuffer = LIBRE_OPENGL_STATE_UNKNOWN;
+    state->active_texture = LIBRE_OPENGL_STATE_UNKNOWN;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_BUFFER_TARGETS; i++)
+        state->buffers[i] = LIBRE_OPENGL_STATE_UNKNOWN;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_UNIFORM_BINDINGS; i++)
+        state->uniform_ranges[i].buffer = LIBRE_OPENGL_STATE_UNKNOWN;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_TEXTURE_UNITS; i++)
+        for (int j = 0; j < LIBRE_OPENGL_STATE_TEXTURE_TARGETS; j++)
+            state->textures[i][j] = LIBRE_OPENGL_STATE_UNKNOWN;
+}
+
+static void *libre_opengl_state_key(libre_window_t window)
+{
+    // glfw windows and headless contexts never share an address, so either one identifies the context
+    return window.window ? (void *)window.window : window.context;
+}
+
+static libre_opengl_state_t *libre_opengl_state_find(void *context, bool claim)
+{
+    if (!context)
+        return NULL;
+
+    libre_opengl_state_t *state = libre_opengl_state_last;
+    if (state && state->context == context)
+        return state;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_CONTEXTS; i++)
+        if (libre_opengl_states[i].context == context)
+            return libre_opengl_state_last = &libre_opengl_states[i];
+
+    if (!claim)
+        return NULL;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_CONTEXTS; i++)
+    {
+        state = &libre_opengl_states[i];
+        if (libre_atomic_compare_exchange_pointer((void *volatile *)&state->context, NULL, context))
+            continue;
+
+        libre_opengl_state_clear(state);
+        memset(&state->issued, 0, sizeof(state->issued));
+        memset(&state->skipped, 0, sizeof(state->skipped));
+        memset(&state->work, 0, sizeof(state->work));
+
+        return libre_opengl_state_last = state;
+    }
+
+    // every slot is taken, the context still works but nothing is cached
+    return NULL;
+}
+
+libre_opengl_state_t *libre_opengl_state(libre_window_t window)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), true);
+
+    if (libre_window_is_current(window))
+    {
+        if (state)
+            state->skipped.contexts++;
+        return state;
+    }
+
+    libre_window_make_current(window);
+    if (state)
+        state->issued.contexts++;
+
+    return state;
+}
+
+void libre_opengl_state_release(libre_window_t window)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (!state)
+        return;
+
+    if (libre_opengl_state_last == state)
+        libre_opengl_state_last = NULL;
+    state->context = NULL;
+}
+
+void libre_opengl_state_count(libre_window_t window, uint64_t draws, uint64_t buffer_bytes, uint64_t texture_bytes)
+{
+    // only looks the slot up, counting must not switch contexts or show up as a skipped switch
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (!state)
+        return;
+
+    state->work.draws += draws;
+    state->work.buffer_bytes += buffer_bytes;
+    state->work.texture_bytes += texture_bytes;
+}
+
+void libre_opengl_state_program(libre_opengl_state_t *state, GLuint program)
+{
+    if (state && state->program == program)
+    {
+        state->skipped.programs++;
+        return;
+    }
+
+    glUseProgram(program);
+    if (!state)
+        return;
+
+    state->program = program;
+    state->issued.programs++;
+}
+
+void libre_opengl_state_vao(libre_opengl_state_t *state, GLuint vao)
+{
+    if (state && state->vao == vao)
+    {
+        state->skipped.vaos++;
+        return;
+    }
+
+    glBindVertexArray(vao);
+    if (!state)
+        return;
+
+    // the element array binding belongs to the vao, so it changes along with it
+    state->vao = vao;
+    state->buffers[libre_opengl_state_buffer_index(GL_ELEMENT_ARRAY_BUFFER)] = LIBRE_OPENGL_STATE_UNKNOWN;
+    state->issued.vaos++;
+}
+
+void libre_opengl_state_buffer(libre_opengl_state_t *state, GLenum target, GLuint buffer)
+{
+    int index = libre_opengl_state_buffer_index(target);
+    if (state && index >= 0 && state->buffers[index] == buffer)
+    {
+        state->skipped.buffers++;
+        return;
+    }
+
+    glBindBuffer(target, buffer);
+    if (!state)
+        return;
+
+    if (index >= 0)
+        state->buffers[index] = buffer;
+    state->issued.buffers++;
+}
+
+void libre_opengl_state_buffer_range(libre_opengl_state_t *state, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    libre_opengl_state_range_t *range = NULL;
+    if (state && target == GL_UNIFORM_BUFFER && index < LIBRE_OPENGL_STATE_UNIFORM_BINDINGS)
+        range = &state->uniform_ranges[index];
+
+    if (range && range->buffer == buffer && range->offset == offset && range->size == size)
+    {
+        state->skipped.buffers++;
+        return;
+    }
+
+    glBindBufferRange(target, index, buffer, offset, size);
+    if (!state)
+        return;
+
+    // binding a range also replaces the generic binding of the target
+    int generic = libre_opengl_state_buffer_index(target);
+    if (generic >= 0)
+        state->buffers[generic] = buffer;
+    if (range)
+    {
+        range->buffer = buffer;
+        range->offset = offset;
+        range->size = size;
+    }
+    state->issued.buffers++;
+}
+
+void libre_opengl_state_active_texture(libre_opengl_state_t *state, GLuint unit)
+{
+    if (state && state->active_texture == unit)
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    if (state)
+        state->active_texture = unit;
+}
+
+void libre_opengl_state_texture(libre_opengl_state_t *state, GLenum target, GLuint texture)
+{
+    int index = libre_opengl_state_texture_index(target);
+    GLuint unit = state ? state->active_texture : LIBRE_OPENGL_STATE_UNKNOWN;
+    bool tracked = index >= 0 && unit < LIBRE_OPENGL_STATE_TEXTURE_UNITS;
+
+    if (state && tracked && state->textures[unit][index] == texture)
+    {
+        state->skipped.textures++;
+        return;
+    }
+
+    glBindTexture(target, texture);
+    if (!state)
+        return;
+
+    if (tracked)
+        state->textures[unit][index] = texture;
+    state->issued.textures++;
+}
+
+void libre_opengl_state_framebuffer(libre_opengl_state_t *state, GLenum target, GLuint framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+
+    if (state && (!draw || state->draw_framebuffer == framebuffer) && (!read || state->read_framebuffer == framebuffer))
+    {
+        state->skipped.framebuffers++;
+        return;
+    }
+
+    glBindFramebuffer(target, framebuffer);
+    if (!state)
+        return;
+
+    if (draw)
+        state->draw_framebuffer = framebuffer;
+    if (read)
+        state->read_framebuffer = framebuffer;
+    state->issued.framebuffers++;
+}
+
+void libre_opengl_state_delete_program(libre_opengl_state_t *state, GLuint program)
+{
+    // a deleted program stays in use until another one is made current, so only forget what was cached
+    if (state && state->program == program)
+        state->program = LIBRE_OPENGL_STATE_UNKNOWN;
+}
+
+void libre_opengl_state_delete_vao(libre_opengl_state_t *state, GLuint vao)
+{
+    if (state && state->vao == vao)
+    {
+        state->vao = 0;
+        state->buffers[libre_opengl_state_buffer_index(GL_ELEMENT_ARRAY_BUFFER)] = LIBRE_OPENGL_STATE_UNKNOWN;
+    }
+}
+
+void libre_opengl_state_delete_buffer(libre_opengl_state_t *state, GLuint buffer)
+{
+    if (!state)
+        return;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_BUFFER_TARGETS; i++)
+        if (state->buffers[i] == buffer)
+            state->buffers[i] = 0;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_UNIFORM_BINDINGS; i++)
+        if (state->uniform_ranges[i].buffer == buffer)
+            state->uniform_ranges[i].buffer = LIBRE_OPENGL_STATE_UNKNOWN;
+}
+
+void libre_opengl_state_delete_texture(libre_opengl_state_t *state, GLuint texture)
+{
+    if (!state)
+        return;
+
+    for (int i = 0; i < LIBRE_OPENGL_STATE_TEXTURE_UNITS; i++)
+        for (int j = 0; j < LIBRE_OPENGL_STATE_TEXTURE_TARGETS; j++)
+            if (state->textures[i][j] == texture)
+                state->textures[i][j] = 0;
+}
+
+void libre_opengl_state_delete_framebuffer(libre_opengl_state_t *state, GLuint framebuffer)
+{
+    // deleting a bound framebuffer reverts that binding to the default framebuffer
+    if (state && state->draw_framebuffer == framebuffer)
+        state->draw_framebuffer = 0;
+    if (state && state->read_framebuffer == framebuffer)
+        state->read_framebuffer = 0;
+}
+
+int libre_opengl_state_stats(libre_window_t window, libre_opengl_state_counters_t *issued, libre_opengl_state_counters_t *skipped)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (!state)
+        return -1;
+
+    if (issued)
+        *issued = state->issued;
+    if (skipped)
+        *skipped = state->skipped;
+
+    return 0;
+}
+
+void libre_opengl_state_reset_stats(libre_window_t window)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (!state)
+        return;
+
+    memset(&state->issued, 0, sizeof(state->issued));
+    memset(&state->skipped, 0, sizeof(state->skipped));
+    memset(&state->work, 0, sizeof(state->work));
+}
+
+int libre_opengl_work_stats(libre_window_t window, libre_opengl_work_counters_t *work)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (!state)
+        return -1;
+
+    if (work)
+        *work = state->work;
+
+    return 0;
+}
+
+void libre_opengl_state_invalidate(libre_window_t window)
+{
+    libre_opengl_state_t *state = libre_opengl_state_find(libre_opengl_state_key(window), false);
+    if (state)
+        libre_opengl_state_clear(state);
+}
@@ -0,0 +1,85 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "libre/opengl.h"
+#include "libre/window.h"
+
+#include <GLFW/glfw3.h>
+
+#define LIBRE_OPENGL_STATE_CONTEXTS 16
+#define LIBRE_OPENGL_STATE_BUFFER_TARGETS 10
+#define LIBRE_OPENGL_STATE_TEXTURE_TARGETS 4
+#define LIBRE_OPENGL_STATE_TEXTURE_UNITS 32
+#define LIBRE_OPENGL_STATE_UNIFORM_BINDINGS 16
+#define LIBRE_OPENGL_STATE_UNKNOWN ((GLuint)-1)
+
+typedef struct libre_opengl_state_range
+{
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} libre_opengl_state_range_t;
+
+/*
+Shadow of the bindings made through libre on one context. Entries start out unknown so the first bind is always
+issued, and anything that is not tracked (an unknown target or a unit past the end) is passed straight to gl.
+*/
+typedef struct libre_opengl_state
+{
+    void *context;
+    GLuint program, vao, draw_framebuffer, read_framebuffer;
+    GLuint buffers[LIBRE_OPENGL_STATE_BUFFER_TARGETS];
+    libre_opengl_state_range_t uniform_ranges[LIBRE_OPENGL_STATE_UNIFORM_BINDINGS];
+    GLuint active_texture;
+    GLuint textures[LIBRE_OPENGL_STATE_TEXTURE_UNITS][LIBRE_OPENGL_STATE_TEXTURE_TARGETS];
+    libre_opengl_state_counters_t issued, skipped;
+    libre_opengl_work_counters_t work;
+} libre_opengl_state_t;
+
+libre_opengl_state_t *libre_opengl_state(libre_window_t window);
+void libre_opengl_state_release(libre_window_t window);
+void libre_opengl_state_count(libre_window_t window, uint64_t draws, uint64_t buffer_bytes, uint64_t texture_bytes);
+GLsizei libre_opengl_pixel_size(GLenum format, GLenum type);
+
+void libre_opengl_state_program(libre_opengl_state_t *state, GLuint program);
+void libre_opengl_state_vao(libre_opengl_state_t *state, GLuint vao);
+void libre_opengl_state_buffer(libre_opengl_state_t *state, GLenum target, GLuint buffer);
+void libre_opengl_state_buffer_range(libre_opengl_state_t *state, GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void libre_opengl_state_active_texture(libre_opengl_state_t *state, GLuint unit);
+void libre_opengl_state_texture(libre_opengl_state_t *state, GLenum target, GLuint texture);
+void libre_opengl_state_framebuffer(libre_opengl_state_t *state, GLenum target, GLuint framebuffer);
+
+void libre_opengl_state_delete_program(libre_opengl_state_t *state, GLuint program);
+void libre_opengl_state_delete_vao(libre_opengl_state_t *state, GLuint vao);
+void libre_opengl_state_delete_buffer(libre_opengl_state_t *state, GLuint buffer);
+void libre_opengl_state_delete_texture(libre_opengl_state_t *state, GLuint texture);
+void libre_opengl_state_delete_framebuffer(libre_opengl_state_t *state, GLuint framebuffer);
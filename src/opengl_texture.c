@@ -0,0 +1,472 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/opengl.h"
+#include "opengl_state.h"
+
+#include <string.h>
+
+#define LIBRE_OPENGL_FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+typedef struct libre_opengl_pixel_format
+{
+    GLenum internal_format, format, type;
+} libre_opengl_pixel_format_t;
+
+static const libre_opengl_pixel_format_t libre_opengl_pixel_formats[] = {
+    {GL_R8, GL_RED, GL_UNSIGNED_BYTE},
+    {GL_RG8, GL_RG, GL_UNSIGNED_BYTE},
+    {GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE},
+    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+    {GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE},
+    {GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE},
+    {GL_R16F, GL_RED, GL_HALF_FLOAT},
+    {GL_RG16F, GL_RG, GL_HALF_FLOAT},
+    {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT},
+    {GL_R32F, GL_RED, GL_FLOAT},
+    {GL_RG32F, GL_RG, GL_FLOAT},
+    {GL_RGBA32F, GL_RGBA, GL_FLOAT},
+    {GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV},
+    {GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT},
+    {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT},
+    {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT},
+    {GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8},
+    {GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV},
+};
+
+static const libre_opengl_pixel_format_t *libre_opengl_pixel_format(GLenum internal_format)
+{
+    for (size_t i = 0; i < sizeof(libre_opengl_pixel_formats) / sizeof(*libre_opengl_pixel_formats); i++)
+        if (libre_opengl_pixel_formats[i].internal_format == internal_format)
+            return &libre_opengl_pixel_formats[i];
+
+    return NULL;
+}
+
+static GLint libre_opengl_texture_mag_filter(GLint filter)
+{
+    if (filter == GL_NEAREST || filter == GL_NEAREST_MIPMAP_NEAREST || filter == GL_NEAREST_MIPMAP_LINEAR)
+        return GL_NEAREST;
+
+    return GL_LINEAR;
+}
+
+static uint32_t libre_opengl_read_u32(const uint8_t *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+GLsizei libre_opengl_pixel_size(GLenum format, GLenum type)
+{
+    switch (type)
+    {
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+        return 8;
+    }
+
+    GLsizei components;
+    switch (format)
+    {
+    case GL_RED:
+    case GL_RED_INTEGER:
+    case GL_DEPTH_COMPONENT:
+    case GL_STENCIL_INDEX:
+        components = 1;
+        break;
+    case GL_RG:
+    case GL_RG_INTEGER:
+        components = 2;
+        break;
+    case GL_RGB:
+    case GL_BGR:
+    case GL_RGB_INTEGER:
+        components = 3;
+        break;
+    case GL_RGBA:
+    case GL_BGRA:
+    case GL_RGBA_INTEGER:
+        components = 4;
+        break;
+    default:
+        return 0;
+    }
+
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+    case GL_BYTE:
+        return components;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+    case GL_HALF_FLOAT:
+        return components * 2;
+    case GL_UNSIGNED_INT:
+    case GL_INT:
+    case GL_FLOAT:
+        return components * 4;
+    default:
+        return 0;
+    }
+}
+
+GLsizei libre_opengl_texture_levels(GLsizei width, GLsizei height)
+{
+    GLsizei size = width > height ? width : height;
+    GLsizei levels = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+int libre_opengl_texture_storage(libre_window_t window, GLenum internal_format, GLsizei width, GLsizei height, GLsizei levels, GLint wrap, GLint filter, libre_opengl_texture_t *texture)
+{
+    if (!texture)
+        return -1;
+    memset(texture, 0, sizeof(*texture));
+
+    if (width <= 0 || height <= 0 || levels < 0)
+        return -1;
+
+    GLsizei max_levels = libre_opengl_texture_levels(width, height);
+    if (levels == 0 || levels > max_levels)
+        levels = max_levels;
+
+    bool storage = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+    const libre_opengl_pixel_format_t *pixel_format = libre_opengl_pixel_format(internal_format);
+    if (!storage && !pixel_format)
+        return -1;
+
+    libre_opengl_state_t *state = libre_opengl_state(window);
+
+    texture->window = window;
+    texture->width = width;
+    texture->height = height;
+    texture->levels = levels;
+    texture->internal_format = internal_format;
+    glGenTextures(1, &texture->id);
+
+    libre_opengl_texture_bind(*texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, libre_opengl_texture_mag_filter(filter));
+
+    if (storage)
+    {
+        glTexStorage2D(GL_TEXTURE_2D, levels, internal_format, width, height);
+        return 0;
+    }
+
+    // a mutable texture is only complete when every level up to the max level exists
+    libre_opengl_state_buffer(state, GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    for (GLsizei i = 0; i < levels; i++)
+    {
+        GLsizei level_width = width >> i > 0 ? width >> i : 1;
+        GLsizei level_height = height >> i > 0 ? height >> i : 1;
+        glTexImage2D(GL_TEXTURE_2D, i, internal_format, level_width, level_height, 0, pixel_format->format, pixel_format->type, NULL);
+    }
+
+    return 0;
+}
+
+int libre_opengl_texture_upload(libre_opengl_texture_t texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *data)
+{
+    if (level < 0 || level >= texture.levels)
+        return -1;
+
+    libre_opengl_texture_bind(texture);
+    glTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, format, type, data);
+    libre_opengl_state_count(texture.window, 0, 0, (uint64_t)width * height * libre_opengl_pixel_size(format, type));
+
+    return 0;
+}
+
+int libre_opengl_texture_upload_compressed(libre_opengl_texture_t texture, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLsizei data_size, const void *data)
+{
+    if (level < 0 || level >= texture.levels)
+        return -1;
+
+    libre_opengl_texture_bind(texture);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, texture.internal_format, data_size, data);
+    libre_opengl_state_count(texture.window, 0, 0, data_size);
+
+    return 0;
+}
+
+void libre_opengl_texture_generate_mipmaps(libre_opengl_texture_t texture)
+{
+    libre_opengl_texture_bind(texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+}
+
+int libre_opengl_texture_ktx_header(const uint8_t *data, size_t data_size, libre_opengl_texture_header_t *header)
+{
+    static const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    if (!header)
+        return -1;
+    memset(header, 0, sizeof(*header));
+
+    if (!data || data_size < 64 || memcmp(data, identifier, sizeof(identifier)))
+        return -1;
+
+    uint32_t fields[13];
+    for (int i = 0; i < 13; i++)
+        fields[i] = libre_opengl_read_u32(data + 12 + i * 4);
+
+    uint32_t type = fields[1], format = fields[3], internal_format = fields[4];
+    uint32_t width = fields[6], height = fields[7], levels = fields[11];
+
+    // only little endian 2d textures, arrays, cube maps and volumes are not supported
+    if (fields[0] != 0x04030201 || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX || fields[8] != 0 || fields[9] != 0 || fields[10] != 1)
+        return -1;
+
+    // generated mipmaps need uncompressed data
+    if (levels == 0 && type == 0)
+        return -1;
+    if (fields[12] > data_size - 64)
+        return -1;
+
+    header->internal_format = internal_format;
+    header->format = format;
+    header->type = type;
+    header->width = (GLsizei)width;
+    header->height = (GLsizei)height;
+    header->levels = levels > INT32_MAX ? INT32_MAX : (GLsizei)levels;
+    header->compressed = type == 0;
+    header->offset = 64 + (size_t)fields[12];
+    return 0;
+}
+
+int libre_opengl_texture_ktx(libre_window_t window, const uint8_t *data, size_t data_size, GLint wrap, GLint filter, libre_opengl_texture_t *texture)
+{
+    if (!texture)
+        return -1;
+    memset(texture, 0, sizeof(*texture));
+
+    libre_opengl_texture_header_t header;
+    if (libre_opengl_texture_ktx_header(data, data_size, &header))
+        return -1;
+
+    bool generate = header.levels == 0;
+    if (libre_opengl_texture_storage(window, header.internal_format, header.width, header.height, header.levels, wrap, filter, texture))
+        return -1;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    size_t offset = header.offset;
+    for (GLsizei i = 0; i < (generate ? 1 : texture->levels); i++)
+    {
+        if (offset + 4 > data_size)
+            goto fail;
+
+        uint32_t image_size = libre_opengl_read_u32(data + offset);
+        offset += 4;
+        if (image_size > data_size - offset)
+            goto fail;
+
+        GLsizei level_width = header.width >> i > 0 ? header.width >> i : 1;
+        GLsizei level_height = header.height >> i > 0 ? header.height >> i : 1;
+        int result = header.compressed ? libre_opengl_texture_upload_compressed(*texture, i, 0, 0, level_width, level_height, image_size, data + offset) : libre_opengl_texture_upload(*texture, i, 0, 0, level_width, level_height, header.format, header.type, data + offset);
+        if (result)
+            goto fail;
+
+        offset += (image_size + 3) & ~(size_t)3;
+    }
+
+    if (generate)
+        libre_opengl_texture_generate_mipmaps(*texture);
+
+    return 0;
+
+fail:
+    libre_opengl_texture_destroy(*texture);
+    memset(texture, 0, sizeof(*texture));
+    return -1;
+}
+
+static GLenum libre_opengl_dds_format(uint32_t four_cc, uint32_t dxgi_format, GLsizei *block_size)
+{
+    *block_size = 16;
+
+    switch (four_cc)
+    {
+    case LIBRE_OPENGL_FOURCC('D', 'X', 'T', '1'):
+        *block_size = 8;
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case LIBRE_OPENGL_FOURCC('D', 'X', 'T', '3'):
+        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case LIBRE_OPENGL_FOURCC('D', 'X', 'T', '5'):
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case LIBRE_OPENGL_FOURCC('A', 'T', 'I', '1'):
+    case LIBRE_OPENGL_FOURCC('B', 'C', '4', 'U'):
+        *block_size = 8;
+        return GL_COMPRESSED_RED_RGTC1;
+    case LIBRE_OPENGL_FOURCC('A', 'T', 'I', '2'):
+    case LIBRE_OPENGL_FOURCC('B', 'C', '5', 'U'):
+        return GL_COMPRESSED_RG_RGTC2;
+    case LIBRE_OPENGL_FOURCC('D', 'X', '1', '0'):
+        break;
+    default:
+        return 0;
+    }
+
+    // dxgi formats from the dx10 extension header
+    switch (dxgi_format)
+    {
+    case 71:
+        *block_size = 8;
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case 72:
+        *block_size = 8;
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+    case 74:
+        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case 75:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;
+    case 77:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case 78:
+        return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    case 80:
+        *block_size = 8;
+        return GL_COMPRESSED_RED_RGTC1;
+    case 81:
+        *block_size = 8;
+        return GL_COMPRESSED_SIGNED_RED_RGTC1;
+    case 83:
+        return GL_COMPRESSED_RG_RGTC2;
+    case 84:
+        return GL_COMPRESSED_SIGNED_RG_RGTC2;
+    case 95:
+        return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;
+    case 96:
+        return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+    case 98:
+        return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case 99:
+        return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    default:
+        return 0;
+    }
+}
+
+int libre_opengl_texture_dds_header(const uint8_t *data, size_t data_size, libre_opengl_texture_header_t *header)
+{
+    if (!header)
+        return -1;
+    memset(header, 0, sizeof(*header));
+
+    if (!data || data_size < 128 || libre_opengl_read_u32(data) != LIBRE_OPENGL_FOURCC('D', 'D', 'S', ' '))
+        return -1;
+
+    uint32_t fields[31];
+    for (int i = 0; i < 31; i++)
+        fields[i] = libre_opengl_read_u32(data + 4 + i * 4);
+
+    uint32_t flags = fields[1], height = fields[2], width = fields[3];
+    uint32_t levels = (flags & 0x20000) && fields[6] > 0 ? fields[6] : 1;
+    uint32_t pixel_flags = fields[19], four_cc = fields[20], caps2 = fields[27];
+
+    // compressed 2d textures only, cube maps and volumes are rejected
+    if (fields[0] != 124 || !(pixel_flags & 0x4) || (caps2 & 0x200) || (caps2 & 0x200000) || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX)
+        return -1;
+
+    size_t offset = 128;
+    uint32_t dxgi_format = 0;
+    if (four_cc == LIBRE_OPENGL_FOURCC('D', 'X', '1', '0'))
+    {
+        if (data_size < 148)
+            return -1;
+
+        dxgi_format = libre_opengl_read_u32(data + 128);
+        if (libre_opengl_read_u32(data + 132) != 3 || libre_opengl_read_u32(data + 140) > 1)
+            return -1;
+        offset = 148;
+    }
+
+    GLsizei block_size;
+    GLenum internal_format = libre_opengl_dds_format(four_cc, dxgi_format, &block_size);
+    if (!internal_format)
+        return -1;
+
+    header->internal_format = internal_format;
+    header->width = (GLsizei)width;
+    header->height = (GLsizei)height;
+    header->levels = levels > INT32_MAX ? INT32_MAX : (GLsizei)levels;
+    header->compressed = true;
+    header->block_size = block_size;
+    header->offset = offset;
+    return 0;
+}
+
+int libre_opengl_texture_dds(libre_window_t window, const uint8_t *data, size_t data_size, GLint wrap, GLint filter, libre_opengl_texture_t *texture)
+{
+    if (!texture)
+        return -1;
+    memset(texture, 0, sizeof(*texture));
+
+    libre_opengl_texture_header_t header;
+    if (libre_opengl_texture_dds_header(data, data_size, &header))
+        return -1;
+
+    if (libre_opengl_texture_storage(window, header.internal_format, header.width, header.height, header.levels, wrap, filter, texture))
+        return -1;
+
+    size_t offset = header.offset;
+    for (GLsizei i = 0; i < texture->levels; i++)
+    {
+        GLsizei level_width = header.width >> i > 0 ? header.width >> i : 1;
+        GLsizei level_height = header.height >> i > 0 ? header.height >> i : 1;
+        size_t image_size = (size_t)((level_width + 3) / 4) * ((level_height + 3) / 4) * header.block_size;
+        if (image_size > data_size - offset)
+        {
+            libre_opengl_texture_destroy(*texture);
+            memset(texture, 0, sizeof(*texture));
+            return -1;
+        }
+
+        libre_opengl_texture_upload_compressed(*texture, i, 0, 0, level_width, level_height, (GLsizei)image_size, data + offset);
+        offset += image_size;
+    }
+
+    return 0;
+}
@@ -0,0 +1,403 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/opengl.h"
+#include "opengl_state.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t libre_opengl_shader_hash(int kind, const char *name)
+{
+    uint32_t hash = 0x811c9dc5u ^ (uint32_t)kind;
+    for (; *name; name++)
+    {
+        hash ^= (uint8_t)*name;
+        hash *= 0x01000193u;
+    }
+
+    return hash;
+}
+
+static int libre_opengl_shader_reflection_add(libre_opengl_shader_reflection_t *reflection, int kind, const char *name, GLenum type, GLint location, GLint size)
+{
+    libre_opengl_shader_variable_t *variable = &reflection->variables[reflection->count];
+    memset(variable, 0, sizeof(*variable));
+
+    // arrays are reported as name[0], they are looked up by the bare name
+    size_t length = strlen(name);
+    if (length > 3 && strcmp(name + length - 3, "[0]") == 0)
+        length -= 3;
+
+    variable->name = malloc(length + 1);
+    if (!variable->name)
+        return -1;
+    memcpy(variable->name, name, length);
+    variable->name[length] = '\0';
+
+    variable->hash = libre_opengl_shader_hash(kind, variable->name);
+    variable->kind = kind;
+    variable->type = type;
+    variable->location = location;
+    variable->size = size;
+    variable->block = -1;
+    variable->offset = -1;
+
+    int bucket = variable->hash & (reflection->bucket_count - 1);
+    variable->next = reflection->buckets[bucket];
+    reflection->buckets[bucket] = reflection->count++;
+
+    return 0;
+}
+
+int libre_opengl_shader_reflect(libre_opengl_shader_t *shader)
+{
+    if (!shader || !shader->id)
+        return -1;
+
+    libre_opengl_shader_reflection_destroy(shader->reflection);
+    shader->reflection = NULL;
+
+    libre_opengl_state(shader->window);
+
+    GLint uniforms = 0, attributes = 0, blocks = 0, uniform_length = 0, attribute_length = 0, block_length = 0;
+    glGetProgramiv(shader->id, GL_ACTIVE_UNIFORMS, &uniforms);
+    glGetProgramiv(shader->id, GL_ACTIVE_ATTRIBUTES, &attributes);
+    glGetProgramiv(shader->id, GL_ACTIVE_UNIFORM_BLOCKS, &blocks);
+    glGetProgramiv(shader->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &uniform_length);
+    glGetProgramiv(shader->id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &attribute_length);
+    glGetProgramiv(shader->id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &block_length);
+
+    libre_opengl_shader_reflection_t *reflection = calloc(1, sizeof(*reflection));
+    if (!reflection)
+        return -1;
+
+    int count = uniforms + attributes + blocks;
+    reflection->bucket_count = 8;
+    while (reflection->bucket_count < count * 2)
+        reflection->bucket_count *= 2;
+
+    GLint length = uniform_length;
+    if (attribute_length > length)
+        length = attribute_length;
+    if (block_length > length)
+        length = block_length;
+
+    char *name = malloc(length + 1);
+    GLint *uniform_blocks = malloc((uniforms > 0 ? uniforms : 1) * sizeof(*uniform_blocks));
+    GLint *uniform_offsets = malloc((uniforms > 0 ? uniforms : 1) * sizeof(*uniform_offsets));
+    reflection->variables = malloc((count > 0 ? count : 1) * sizeof(*reflection->variables));
+    reflection->buckets = malloc(reflection->bucket_count * sizeof(*reflection->buckets));
+    if (!name || !uniform_blocks || !uniform_offsets || !reflection->variables || !reflection->buckets)
+        goto fail;
+
+    for (int i = 0; i < reflection->bucket_count; i++)
+        reflection->buckets[i] = -1;
+
+    for (GLint i = 0; i < uniforms; i++)
+    {
+        GLuint index = i;
+        glGetActiveUniformsiv(shader->id, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform_blocks[i]);
+        glGetActiveUniformsiv(shader->id, 1, &index, GL_UNIFORM_OFFSET, &uniform_offsets[i]);
+
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(shader->id, index, length + 1, NULL, &size, &type, name);
+
+        GLint location = uniform_blocks[i] < 0 ? glGetUniformLocation(shader->id, name) : -1;
+        if (libre_opengl_shader_reflection_add(reflection, LIBRE_OPENGL_VARIABLE_UNIFORM, name, type, location, size))
+            goto fail;
+
+        libre_opengl_shader_variable_t *variable = &reflection->variables[reflection->count - 1];
+        variable->block = uniform_blocks[i];
+        variable->offset = uniform_blocks[i] < 0 ? -1 : uniform_offsets[i];
+    }
+
+    for (GLint i = 0; i < attributes; i++)
+    {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(shader->id, i, length + 1, NULL, &size, &type, name);
+
+        if (libre_opengl_shader_reflection_add(reflection, LIBRE_OPENGL_VARIABLE_ATTRIBUTE, name, type, glGetAttribLocation(shader->id, name), size))
+            goto fail;
+    }
+
+    for (GLint i = 0; i < blocks; i++)
+    {
+        GLint size = 0;
+        glGetActiveUniformBlockName(shader->id, i, length + 1, NULL, name);
+        glGetActiveUniformBlockiv(shader->id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+        if (libre_opengl_shader_reflection_add(reflection, LIBRE_OPENGL_VARIABLE_BLOCK, name, 0, i, size))
+            goto fail;
+    }
+
+    free(uniform_offsets);
+    free(uniform_blocks);
+    free(name);
+
+    shader->reflection = reflection;
+    return 0;
+
+fail:
+    free(uniform_offsets);
+    free(uniform_blocks);
+    free(name);
+    libre_opengl_shader_reflection_destroy(reflection);
+    return -1;
+}
+
+void libre_opengl_shader_reflection_destroy(libre_opengl_shader_reflection_t *reflection)
+{
+    if (!reflection)
+        return;
+
+    for (int i = 0; i < reflection->count; i++)
+        free(reflection->variables[i].name);
+    free(reflection->variables);
+    free(reflection->buckets);
+    free(reflection);
+}
+
+const libre_opengl_shader_variable_t *libre_opengl_shader_variable(libre_opengl_shader_t shader, int kind, const char *name)
+{
+    libre_opengl_shader_reflection_t *reflection = shader.reflection;
+    if (!reflection || !name)
+        return NULL;
+
+    uint32_t hash = libre_opengl_shader_hash(kind, name);
+    for (int i = reflection->buckets[hash & (reflection->bucket_count - 1)]; i >= 0; i = reflection->variables[i].next)
+    {
+        libre_opengl_shader_variable_t *variable = &reflection->variables[i];
+        if (variable->hash == hash && variable->kind == kind && strcmp(variable->name, name) == 0)
+            return variable;
+    }
+
+    return NULL;
+}
+
+GLint libre_opengl_shader_uniform_location(libre_opengl_shader_t shader, const char *name)
+{
+    if (!shader.reflection)
+    {
+        libre_opengl_state(shader.window);
+        return glGetUniformLocation(shader.id, name);
+    }
+
+    const libre_opengl_shader_variable_t *variable = libre_opengl_shader_variable(shader, LIBRE_OPENGL_VARIABLE_UNIFORM, name);
+    return variable ? variable->location : -1;
+}
+
+int libre_opengl_shader_block_binding(libre_opengl_shader_t shader, const char *name, GLuint binding)
+{
+    libre_opengl_state(shader.window);
+
+    GLuint index;
+    const libre_opengl_shader_variable_t *variable = libre_opengl_shader_variable(shader, LIBRE_OPENGL_VARIABLE_BLOCK, name);
+    if (variable)
+        index = variable->location;
+    else if (!shader.reflection)
+        index = glGetUniformBlockIndex(shader.id, name);
+    else
+        return -1;
+
+    if (index == GL_INVALID_INDEX)
+        return -1;
+
+    glUniformBlockBinding(shader.id, index, binding);
+    return 0;
+}
+
+void libre_opengl_std140(libre_opengl_std140_t *writer, void *data, size_t size)
+{
+    if (!writer)
+        return;
+
+    writer->data = data;
+    writer->size = data ? size : 0;
+    writer->offset = 0;
+    writer->overflow = false;
+}
+
+void libre_opengl_std140_align(libre_opengl_std140_t *writer, size_t alignment)
+{
+    writer->offset = (writer->offset + alignment - 1) & ~(alignment - 1);
+}
+
+static void libre_opengl_std140_write(libre_opengl_std140_t *writer, size_t alignment, const void *data, size_t size)
+{
+    libre_opengl_std140_align(writer, alignment);
+    if (writer->offset + size > writer->size)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->data + writer->offset, data, size);
+    writer->offset += size;
+}
+
+void libre_opengl_std140_float(libre_opengl_std140_t *writer, float value)
+{
+    libre_opengl_std140_write(writer, 4, &value, sizeof(value));
+}
+
+void libre_opengl_std140_int(libre_opengl_std140_t *writer, int32_t value)
+{
+    libre_opengl_std140_write(writer, 4, &value, sizeof(value));
+}
+
+void libre_opengl_std140_vec2(libre_opengl_std140_t *writer, float x, float y)
+{
+    float value[2] = {x, y};
+    libre_opengl_std140_write(writer, 8, value, sizeof(value));
+}
+
+void libre_opengl_std140_vec3(libre_opengl_std140_t *writer, libre_vec3_t value)
+{
+    // a vec3 is aligned like a vec4 but only takes 12 bytes, a following scalar fills the gap
+    float data[3] = {value.x, value.y, value.z};
+    libre_opengl_std140_write(writer, 16, data, sizeof(data));
+}
+
+void libre_opengl_std140_vec4(libre_opengl_std140_t *writer, libre_vec4_t value)
+{
+    float data[4] = {value.x, value.y, value.z, value.w};
+    libre_opengl_std140_write(writer, 16, data, sizeof(data));
+}
+
+void libre_opengl_std140_mat3(libre_opengl_std140_t *writer, const libre_mat3_t *value)
+{
+    // glsl matrices are column-major and every column is padded to a vec4
+    float data[12] = {0};
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++)
+            data[column * 4 + row] = value->data[row * 3 + column];
+
+    libre_opengl_std140_write(writer, 16, data, sizeof(data));
+}
+
+void libre_opengl_std140_mat4(libre_opengl_std140_t *writer, const libre_mat4_t *value)
+{
+    float data[16];
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 4; row++)
+            data[column * 4 + row] = value->data[row * 4 + column];
+
+    libre_opengl_std140_write(writer, 16, data, sizeof(data));
+}
+
+void libre_opengl_std140_float_array(libre_opengl_std140_t *writer, const float *values, int count)
+{
+    // every array element takes a whole vec4 slot in std140
+    for (int i = 0; i < count; i++)
+    {
+        float data[4] = {values[i], 0, 0, 0};
+        libre_opengl_std140_write(writer, 16, data, sizeof(data));
+    }
+}
+
+int libre_opengl_uniform_ring(libre_window_t window, GLsizeiptr frame_size, int frames, libre_opengl_uniform_ring_t *ring)
+{
+    if (!ring)
+        return -1;
+    memset(ring, 0, sizeof(*ring));
+
+    libre_opengl_state(window);
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ring->alignment);
+    if (ring->alignment <= 0)
+        ring->alignment = 256;
+
+    // regions start on an aligned offset too, so every range handed to glBindBufferRange is valid
+    frame_size = (frame_size + ring->alignment - 1) / ring->alignment * ring->alignment;
+    return libre_opengl_stream_buffer(window, GL_UNIFORM_BUFFER, frame_size, frames, &ring->stream_buffer);
+}
+
+void libre_opengl_uniform_ring_begin(libre_opengl_uniform_ring_t *ring)
+{
+    if (!ring)
+        return;
+
+    if (ring->stream_buffer.persistent)
+        ring->mapping = libre_opengl_stream_buffer_map(&ring->stream_buffer);
+    else
+        libre_opengl_stream_buffer_wait(&ring->stream_buffer);
+    ring->head = 0;
+}
+
+int libre_opengl_uniform_ring_push(libre_opengl_uniform_ring_t *ring, GLuint binding, const void *data, GLsizeiptr data_size)
+{
+    if (!ring || !data || data_size <= 0)
+        return -1;
+
+    GLintptr head = (ring->head + ring->alignment - 1) / ring->alignment * ring->alignment;
+    if (head + data_size > ring->stream_buffer.region_size)
+        return -1;
+
+    libre_opengl_stream_buffer_t *stream_buffer = &ring->stream_buffer;
+    GLintptr offset = stream_buffer->offset + head;
+
+    libre_opengl_state_t *state = libre_opengl_state(stream_buffer->buffer_object.window);
+    if (ring->mapping)
+        memcpy(ring->mapping + head, data, data_size);
+    else
+    {
+        // a mapped buffer cannot be read by draws, so without persistent mapping every push is a sub data upload
+        libre_opengl_buffer_object_bind(stream_buffer->buffer_object);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, data_size, data);
+    }
+    libre_opengl_state_count(stream_buffer->buffer_object.window, 0, data_size, 0);
+
+    libre_opengl_state_buffer_range(state, GL_UNIFORM_BUFFER, binding, stream_buffer->buffer_object.id, offset, data_size);
+    ring->head = head + data_size;
+
+    return 0;
+}
+
+void libre_opengl_uniform_ring_end(libre_opengl_uniform_ring_t *ring)
+{
+    if (!ring)
+        return;
+
+    libre_opengl_stream_buffer_advance(&ring->stream_buffer);
+    ring->mapping = NULL;
+}
+
+void libre_opengl_uniform_ring_destroy(libre_opengl_uniform_ring_t *ring)
+{
+    if (!ring)
+        return;
+
+    if (ring->stream_buffer.buffer_object.id)
+        libre_opengl_stream_buffer_destroy(&ring->stream_buffer);
+    memset(ring, 0, sizeof(*ring));
+}
@@ -0,0 +1,195 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "libre/pool.h"
+#include "thread.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct libre_pool
+{
+    int threads;
+    libre_thread_t *workers;
+
+    libre_mutex_t submit;
+    libre_mutex_t mutex;
+    libre_cond_t work;
+    libre_cond_t done;
+    bool stop;
+
+    unsigned long generation;
+    libre_pool_function_t function;
+    void *argument;
+    int count, chunk, chunks, next, finished;
+} libre_pool_t;
+
+static libre_pool_t libre_pool = {.threads = 1};
+static LIBRE_THREAD_LOCAL bool libre_pool_inside = false;
+
+static void libre_pool_run(void)
+{
+    while (libre_pool.next < libre_pool.chunks)
+    {
+        int chunk = libre_pool.next++;
+        libre_pool_function_t function = libre_pool.function;
+        void *argument = libre_pool.argument;
+        int begin = chunk * libre_pool.chunk;
+        int end = begin + libre_pool.chunk < libre_pool.count ? begin + libre_pool.chunk : libre_pool.count;
+
+        libre_mutex_unlock(&libre_pool.mutex);
+        libre_pool_inside = true;
+        function(argument, begin, end);
+        libre_pool_inside = false;
+        libre_mutex_lock(&libre_pool.mutex);
+
+        if (++libre_pool.finished == libre_pool.chunks)
+            libre_cond_broadcast(&libre_pool.done);
+    }
+}
+
+static void libre_pool_worker(void *argument)
+{
+    unsigned long generation = 0;
+
+    libre_mutex_lock(&libre_pool.mutex);
+    while (true)
+    {
+        while (!libre_pool.stop && libre_pool.generation == generation)
+            libre_cond_wait(&libre_pool.work, &libre_pool.mutex);
+        if (libre_pool.stop)
+            break;
+
+        generation = libre_pool.generation;
+        libre_pool_run();
+    }
+    libre_mutex_unlock(&libre_pool.mutex);
+}
+
+int libre_pool_init(int threads)
+{
+    if (libre_pool.workers)
+        return -1;
+
+    if (threads <= 0)
+        threads = libre_thread_hardware_concurrency();
+    if (threads <= 1)
+        return 0;
+
+    libre_pool.workers = malloc(sizeof(libre_thread_t) * (threads - 1));
+    if (!libre_pool.workers)
+        return -1;
+
+    libre_mutex_init(&libre_pool.submit);
+    libre_mutex_init(&libre_pool.mutex);
+    libre_cond_init(&libre_pool.work);
+    libre_cond_init(&libre_pool.done);
+    libre_pool.stop = false;
+    libre_pool.generation = 0;
+
+    // the calling thread takes part in every job, so only threads - 1 workers are needed
+    libre_pool.threads = 1;
+    for (int i = 0; i < threads - 1; i++)
+    {
+        if (libre_thread_create(&libre_pool.workers[i], libre_pool_worker, NULL))
+        {
+            libre_pool_terminate();
+            return -1;
+        }
+        libre_pool.threads++;
+    }
+
+    return 0;
+}
+
+void libre_pool_terminate(void)
+{
+    if (!libre_pool.workers)
+        return;
+
+    libre_mutex_lock(&libre_pool.mutex);
+    libre_pool.stop = true;
+    libre_cond_broadcast(&libre_pool.work);
+    libre_mutex_unlock(&libre_pool.mutex);
+
+    for (int i = 0; i < libre_pool.threads - 1; i++)
+        libre_thread_join(libre_pool.workers[i]);
+
+    libre_cond_destroy(&libre_pool.done);
+    libre_cond_destroy(&libre_pool.work);
+    libre_mutex_destroy(&libre_pool.mutex);
+    libre_mutex_destroy(&libre_pool.submit);
+
+    free(libre_pool.workers);
+    libre_pool.workers = NULL;
+    libre_pool.threads = 1;
+}
+
+int libre_pool_threads(void)
+{
+    return libre_pool.threads;
+}
+
+void libre_pool_parallel_for(int count, int grain, libre_pool_function_t function, void *argument)
+{
+    if (count <= 0)
+        return;
+    if (grain < 1)
+        grain = 1;
+
+    // a few chunks per thread keeps the threads balanced without making the chunks tiny
+    int chunk = (count + libre_pool.threads * 4 - 1) / (libre_pool.threads * 4);
+    if (chunk < grain)
+        chunk = grain;
+
+    if (libre_pool.threads <= 1 || libre_pool_inside || chunk >= count)
+    {
+        function(argument, 0, count);
+        return;
+    }
+
+    libre_mutex_lock(&libre_pool.submit);
+    libre_mutex_lock(&libre_pool.mutex);
+
+    libre_pool.function = function;
+    libre_pool.argument = argument;
+    libre_pool.count = count;
+    libre_pool.chunk = chunk;
+    libre_pool.chunks = (count + chunk - 1) / chunk;
+    libre_pool.next = 0;
+    libre_pool.finished = 0;
+    libre_pool.generation++;
+    libre_cond_broadcast(&libre_pool.work);
+
+    libre_pool_run();
+    while (libre_pool.finished < libre_pool.chunks)
+        libre_cond_wait(&libre_pool.done, &libre_pool.mutex);
+
+    libre_mutex_unlock(&libre_pool.mutex);
+    libre_mutex_unlock(&libre_pool.submit);
+}
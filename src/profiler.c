@@ -0,0 +1,367 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/profiler.h"
+#include "opengl_state.h"
+#include "thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static double libre_profiler_now(const libre_profiler_t *profiler)
+{
+    return libre_clock_seconds() - profiler->origin;
+}
+
+static GLuint *libre_profiler_queries(libre_profiler_t *profiler, int frame)
+{
+    return profiler->queries + frame * 2 * LIBRE_PROFILER_SCOPES_MAX;
+}
+
+int libre_profiler(libre_window_t window, libre_profiler_t *profiler)
+{
+    if (!profiler)
+        return -1;
+    memset(profiler, 0, sizeof(*profiler));
+
+    profiler->frames = calloc(LIBRE_PROFILER_FRAMES, sizeof(*profiler->frames));
+    profiler->report = calloc(1, sizeof(*profiler->report));
+    if (!profiler->frames || !profiler->report)
+    {
+        free(profiler->frames);
+        free(profiler->report);
+        memset(profiler, 0, sizeof(*profiler));
+        return -1;
+    }
+
+    libre_opengl_state(window);
+
+    profiler->window = window;
+    profiler->timer_queries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    profiler->origin = libre_clock_seconds();
+    for (int i = 0; i < LIBRE_PROFILER_FRAMES; i++)
+        profiler->last_query[i] = -1;
+
+    if (profiler->timer_queries)
+    {
+        GLsizei count = LIBRE_PROFILER_FRAMES * 2 * LIBRE_PROFILER_SCOPES_MAX;
+        profiler->queries = malloc(count * sizeof(*profiler->queries));
+        if (!profiler->queries)
+        {
+            libre_profiler_destroy(profiler);
+            return -1;
+        }
+        glGenQueries(count, profiler->queries);
+
+        // the timestamp is taken when the call reaches the gpu, which is close enough to line both clocks up
+        GLint64 timestamp;
+        glGetInteger64v(GL_TIMESTAMP, &timestamp);
+        profiler->gpu_offset = libre_profiler_now(profiler) - timestamp * 1e-9;
+    }
+
+    return 0;
+}
+
+static void libre_profiler_trace_separator(libre_profiler_t *profiler)
+{
+    fputs(profiler->trace_empty ? "\n" : ",\n", profiler->trace);
+    profiler->trace_empty = false;
+}
+
+void libre_profiler_trace_string(FILE *file, const char *string)
+{
+    if (!file)
+        return;
+
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)(string ? string : ""); *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            fprintf(file, "\\%c", *c);
+        else if (*c < 0x20)
+            fprintf(file, "\\u%04x", *c);
+        else
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+static void libre_profiler_trace_complete(libre_profiler_t *profiler, const char *name, int thread, double begin, double end)
+{
+    libre_profiler_trace_separator(profiler);
+    fputs("{\"name\":", profiler->trace);
+    libre_profiler_trace_string(profiler->trace, name);
+    fprintf(profiler->trace, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread, begin * 1e6, (end - begin) * 1e6);
+}
+
+static void libre_profiler_trace_frame(libre_profiler_t *profiler, const libre_profiler_frame_t *frame)
+{
+    // cpu scopes go on thread 1 and gpu scopes on thread 2, nesting is rebuilt by the viewer from the times
+    libre_profiler_trace_complete(profiler, "frame", 1, frame->cpu_begin, frame->cpu_end);
+    for (int i = 0; i < frame->scope_count; i++)
+    {
+        const libre_profiler_scope_t *scope = &frame->scopes[i];
+        libre_profiler_trace_complete(profiler, scope->name, 1, scope->cpu_begin, scope->cpu_end);
+        if (scope->gpu)
+            libre_profiler_trace_complete(profiler, scope->name, 2, scope->gpu_begin, scope->gpu_end);
+    }
+
+    libre_profiler_trace_separator(profiler);
+    fprintf(profiler->trace, "{\"name\":\"work\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"draws\":%llu,\"binds\":%llu,\"buffer_bytes\":%llu,\"texture_bytes\":%llu}}", frame->cpu_begin * 1e6, (unsigned long long)frame->draws, (unsigned long long)frame->binds, (unsigned long long)frame->buffer_bytes, (unsigned long long)frame->texture_bytes);
+}
+
+static bool libre_profiler_resolve(libre_profiler_t *profiler, int index, bool wait)
+{
+    if (!profiler->pending[index])
+        return false;
+
+    libre_profiler_frame_t *frame = &profiler->frames[index];
+    GLuint *queries = libre_profiler_queries(profiler, index);
+
+    // queries finish in order, so once the last one is available every result of the frame is
+    if (profiler->last_query[index] >= 0)
+    {
+        if (!wait)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[profiler->last_query[index]], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return false;
+        }
+
+        for (int i = 0; i < frame->scope_count; i++)
+        {
+            libre_profiler_scope_t *scope = &frame->scopes[i];
+            if (!scope->gpu)
+                continue;
+
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(queries[2 * i], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            scope->gpu_begin = begin * 1e-9 + profiler->gpu_offset;
+            scope->gpu_end = end * 1e-9 + profiler->gpu_offset;
+        }
+    }
+
+    profiler->pending[index] = false;
+    memcpy(profiler->report, frame, sizeof(*frame));
+    profiler->reported = true;
+
+    if (profiler->trace)
+        libre_profiler_trace_frame(profiler, frame);
+
+    return true;
+}
+
+void libre_profiler_frame_begin(libre_profiler_t *profiler)
+{
+    if (!profiler)
+        return;
+    if (profiler->recording)
+        libre_profiler_frame_end(profiler);
+
+    libre_opengl_state(profiler->window);
+
+    // the slot about to be reused holds the oldest frame, it is only waited on when the gpu is a whole ring behind
+    for (int i = 0; i < LIBRE_PROFILER_FRAMES; i++)
+    {
+        int index = (profiler->frame + i) % LIBRE_PROFILER_FRAMES;
+        if (profiler->pending[index] && !libre_profiler_resolve(profiler, index, i == 0))
+            break;
+    }
+
+    libre_profiler_frame_t *frame = &profiler->frames[profiler->frame];
+    frame->index = profiler->frame_index++;
+    frame->cpu_begin = libre_profiler_now(profiler);
+    frame->scope_count = 0;
+    profiler->last_query[profiler->frame] = -1;
+    profiler->depth = 0;
+
+    memset(&profiler->issued, 0, sizeof(profiler->issued));
+    memset(&profiler->work, 0, sizeof(profiler->work));
+    libre_opengl_state_stats(profiler->window, &profiler->issued, NULL);
+    libre_opengl_work_stats(profiler->window, &profiler->work);
+
+    profiler->recording = true;
+}
+
+void libre_profiler_frame_end(libre_profiler_t *profiler)
+{
+    if (!profiler || !profiler->recording)
+        return;
+
+    while (profiler->depth > 0)
+        libre_profiler_pop(profiler);
+
+    libre_profiler_frame_t *frame = &profiler->frames[profiler->frame];
+    frame->cpu_end = libre_profiler_now(profiler);
+
+    libre_opengl_state_counters_t issued = {0};
+    libre_opengl_work_counters_t work = {0};
+    libre_opengl_state_stats(profiler->window, &issued, NULL);
+    libre_opengl_work_stats(profiler->window, &work);
+
+    // the counters can be reset by the application during the frame, a reset only loses that frame
+    frame->binds = issued.programs + issued.vaos + issued.buffers + issued.textures + issued.framebuffers;
+    frame->binds -= profiler->issued.programs + profiler->issued.vaos + profiler->issued.buffers + profiler->issued.textures + profiler->issued.framebuffers;
+    frame->draws = work.draws - profiler->work.draws;
+    frame->buffer_bytes = work.buffer_bytes - profiler->work.buffer_bytes;
+    frame->texture_bytes = work.texture_bytes - profiler->work.texture_bytes;
+    if (work.draws < profiler->work.draws || work.buffer_bytes < profiler->work.buffer_bytes || work.texture_bytes < profiler->work.texture_bytes)
+        frame->draws = frame->binds = frame->buffer_bytes = frame->texture_bytes = 0;
+
+    profiler->pending[profiler->frame] = true;
+    profiler->frame = (profiler->frame + 1) % LIBRE_PROFILER_FRAMES;
+    profiler->recording = false;
+}
+
+void libre_profiler_push(libre_profiler_t *profiler, const char *name, bool gpu)
+{
+    if (!profiler || !profiler->recording)
+        return;
+
+    // scopes past either limit are not recorded, but still have to be popped
+    int index = -1;
+    libre_profiler_frame_t *frame = &profiler->frames[profiler->frame];
+    if (profiler->depth < LIBRE_PROFILER_DEPTH_MAX && frame->scope_count < LIBRE_PROFILER_SCOPES_MAX)
+    {
+        index = frame->scope_count++;
+
+        libre_profiler_scope_t *scope = &frame->scopes[index];
+        scope->name = name;
+        scope->depth = profiler->depth;
+        scope->gpu = gpu && profiler->timer_queries;
+        scope->cpu_begin = scope->cpu_end = libre_profiler_now(profiler);
+        scope->gpu_begin = scope->gpu_end = 0.0;
+
+        if (scope->gpu)
+        {
+            libre_opengl_state(profiler->window);
+            glQueryCounter(libre_profiler_queries(profiler, profiler->frame)[2 * index], GL_TIMESTAMP);
+            profiler->last_query[profiler->frame] = 2 * index;
+        }
+    }
+
+    if (profiler->depth < LIBRE_PROFILER_DEPTH_MAX)
+        profiler->stack[profiler->depth] = index;
+    profiler->depth++;
+}
+
+void libre_profiler_pop(libre_profiler_t *profiler)
+{
+    if (!profiler || !profiler->recording || profiler->depth == 0)
+        return;
+
+    profiler->depth--;
+    if (profiler->depth >= LIBRE_PROFILER_DEPTH_MAX)
+        return;
+
+    int index = profiler->stack[profiler->depth];
+    if (index < 0)
+        return;
+
+    libre_profiler_scope_t *scope = &profiler->frames[profiler->frame].scopes[index];
+    scope->cpu_end = libre_profiler_now(profiler);
+
+    if (scope->gpu)
+    {
+        libre_opengl_state(profiler->window);
+        glQueryCounter(libre_profiler_queries(profiler, profiler->frame)[2 * index + 1], GL_TIMESTAMP);
+        profiler->last_query[profiler->frame] = 2 * index + 1;
+    }
+}
+
+const libre_profiler_frame_t *libre_profiler_report(const libre_profiler_t *profiler)
+{
+    if (!profiler || !profiler->reported)
+        return NULL;
+
+    return profiler->report;
+}
+
+int libre_profiler_trace(libre_profiler_t *profiler, const char *path)
+{
+    if (!profiler)
+        return -1;
+
+    if (profiler->trace)
+    {
+        // frames still waiting on the gpu belong to this trace, oldest first
+        bool pending = false;
+        for (int i = 0; i < LIBRE_PROFILER_FRAMES; i++)
+            pending = pending || profiler->pending[i];
+        if (pending)
+        {
+            libre_opengl_state(profiler->window);
+            for (int i = 0; i < LIBRE_PROFILER_FRAMES; i++)
+                libre_profiler_resolve(profiler, (profiler->frame + i) % LIBRE_PROFILER_FRAMES, true);
+        }
+
+        fputs("\n]\n", profiler->trace);
+        fclose(profiler->trace);
+        profiler->trace = NULL;
+    }
+
+    if (!path)
+        return 0;
+
+    profiler->trace = fopen(path, "w");
+    if (!profiler->trace)
+        return -1;
+
+    fputs("[", profiler->trace);
+    profiler->trace_empty = true;
+
+    libre_profiler_trace_separator(profiler);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}}", profiler->trace);
+    libre_profiler_trace_separator(profiler);
+    fputs("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}", profiler->trace);
+
+    return 0;
+}
+
+void libre_profiler_destroy(libre_profiler_t *profiler)
+{
+    if (!profiler)
+        return;
+
+    libre_profiler_trace(profiler, NULL);
+
+    if (profiler->queries)
+    {
+        libre_opengl_state(profiler->window);
+        glDeleteQueries(LIBRE_PROFILER_FRAMES * 2 * LIBRE_PROFILER_SCOPES_MAX, profiler->queries);
+    }
+
+    free(profiler->queries);
+    free(profiler->frames);
+    free(profiler->report);
+    memset(profiler, 0, sizeof(*profiler));
+}
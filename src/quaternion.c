@@ -0,0 +1,203 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "libre/quaternion.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#define LIBRE_QUATERNION_SLERP_THRESHOLD ((LIBRE_MATRIX_TYPE)0.9995)
+
+libre_quaternion_t libre_quaternion(LIBRE_MATRIX_TYPE w, LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z)
+{
+   libre_quaternion_t quaternion;
+   quaternion.w = w;
+   quaternion.x = x;
+   quaternion.y = y;
+   quaternion.z = z;
+
+   return quaternion;
+}
+
+libre_quaternion_t libre_quaternion_identity(void)
+{
+   return libre_quaternion((LIBRE_MATRIX_TYPE)1.0, 0, 0, 0);
+}
+
+libre_quaternion_t libre_quaternion_axis_angle(LIBRE_MATRIX_TYPE x, LIBRE_MATRIX_TYPE y, LIBRE_MATRIX_TYPE z, LIBRE_MATRIX_TYPE angle)
+{
+   LIBRE_MATRIX_TYPE magnitude = (LIBRE_MATRIX_TYPE)sqrt(x * x + y * y + z * z);
+   if (magnitude == 0)
+      return libre_quaternion_identity();
+
+   LIBRE_MATRIX_TYPE s = (LIBRE_MATRIX_TYPE)sin(angle * 0.5) / magnitude;
+   return libre_quaternion((LIBRE_MATRIX_TYPE)cos(angle * 0.5), x * s, y * s, z * s);
+}
+
+LIBRE_MATRIX_TYPE libre_quaternion_dot(libre_quaternion_t a, libre_quaternion_t b)
+{
+   return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+libre_quaternion_t libre_quaternion_normalize(libre_quaternion_t quaternion)
+{
+   LIBRE_MATRIX_TYPE magnitude = libre_quaternion_dot(quaternion, quaternion);
+   if (magnitude == 0)
+      return libre_quaternion_identity();
+
+   LIBRE_MATRIX_TYPE inverse = (LIBRE_MATRIX_TYPE)(1.0 / sqrt(magnitude));
+   return libre_quaternion(quaternion.w * inverse, quaternion.x * inverse, quaternion.y * inverse, quaternion.z * inverse);
+}
+
+libre_quaternion_t libre_quaternion_conjugate(libre_quaternion_t quaternion)
+{
+   return libre_quaternion(quaternion.w, -quaternion.x, -quaternion.y, -quaternion.z);
+}
+
+libre_quaternion_t libre_quaternion_multiply(libre_quaternion_t a, libre_quaternion_t b)
+{
+   return libre_quaternion(a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                           a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                           a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                           a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w);
+}
+
+libre_vec3_t libre_quaternion_rotate(libre_quaternion_t quaternion, libre_vec3_t vector)
+{
+   // v + 2w(q x v) + 2q x (q x v), without building the matrix
+   LIBRE_MATRIX_TYPE tx = 2 * (quaternion.y * vector.z - quaternion.z * vector.y);
+   LIBRE_MATRIX_TYPE ty = 2 * (quaternion.z * vector.x - quaternion.x * vector.z);
+   LIBRE_MATRIX_TYPE tz = 2 * (quaternion.x * vector.y - quaternion.y * vector.x);
+
+   return libre_vec3(vector.x + quaternion.w * tx + quaternion.y * tz - quaternion.z * ty,
+                     vector.y + quaternion.w * ty + quaternion.z * tx - quaternion.x * tz,
+                     vector.z + quaternion.w * tz + quaternion.x * ty - quaternion.y * tx);
+}
+
+libre_quaternion_t libre_quaternion_nlerp(libre_quaternion_t a, libre_quaternion_t b, LIBRE_MATRIX_TYPE t)
+{
+   // q and -q are the same rotation, pick the one on the short arc
+   LIBRE_MATRIX_TYPE s = libre_quaternion_dot(a, b) < 0 ? -t : t;
+   LIBRE_MATRIX_TYPE r = 1 - t;
+
+   return libre_quaternion_normalize(libre_quaternion(a.w * r + b.w * s, a.x * r + b.x * s, a.y * r + b.y * s, a.z * r + b.z * s));
+}
+
+libre_quaternion_t libre_quaternion_slerp(libre_quaternion_t a, libre_quaternion_t b, LIBRE_MATRIX_TYPE t)
+{
+   LIBRE_MATRIX_TYPE cosine = libre_quaternion_dot(a, b);
+   if (cosine < 0)
+   {
+      b = libre_quaternion(-b.w, -b.x, -b.y, -b.z);
+      cosine = -cosine;
+   }
+
+   if (cosine > LIBRE_QUATERNION_SLERP_THRESHOLD)
+      return libre_quaternion_nlerp(a, b, t);
+
+   double angle = acos(cosine);
+   double sine = sin(angle);
+   LIBRE_MATRIX_TYPE r = (LIBRE_MATRIX_TYPE)(sin((1 - t) * angle) / sine);
+   LIBRE_MATRIX_TYPE s = (LIBRE_MATRIX_TYPE)(sin(t * angle) / sine);
+
+   return libre_quaternion(a.w * r + b.w * s, a.x * r + b.x * s, a.y * r + b.y * s, a.z * r + b.z * s);
+}
+
+int libre_quaternion_nlerp_batch(const libre_quaternion_t *a, const libre_quaternion_t *b, const LIBRE_MATRIX_TYPE *t, libre_quaternion_t *destination, int count)
+{
+   if (!a || !b || !t || !destination || count < 0)
+      return -1;
+
+   for (int i = 0; i < count; i++)
+   {
+      LIBRE_MATRIX_TYPE s = libre_quaternion_dot(a[i], b[i]) < 0 ? -t[i] : t[i];
+      LIBRE_MATRIX_TYPE r = 1 - t[i];
+
+      LIBRE_MATRIX_TYPE w = a[i].w * r + b[i].w * s;
+      LIBRE_MATRIX_TYPE x = a[i].x * r + b[i].x * s;
+      LIBRE_MATRIX_TYPE y = a[i].y * r + b[i].y * s;
+      LIBRE_MATRIX_TYPE z = a[i].z * r + b[i].z * s;
+
+      LIBRE_MATRIX_TYPE magnitude = w * w + x * x + y * y + z * z;
+      LIBRE_MATRIX_TYPE inverse = magnitude > 0 ? (LIBRE_MATRIX_TYPE)1.0 / (LIBRE_MATRIX_TYPE)sqrt(magnitude) : 0;
+
+      destination[i].w = magnitude > 0 ? w * inverse : (LIBRE_MATRIX_TYPE)1.0;
+      destination[i].x = x * inverse;
+      destination[i].y = y * inverse;
+      destination[i].z = z * inverse;
+   }
+
+   return 0;
+}
+
+void libre_quaternion_to_matrix(libre_quaternion_t quaternion, LIBRE_MATRIX_TYPE *destination)
+{
+   LIBRE_MATRIX_TYPE w = quaternion.w, x = quaternion.x, y = quaternion.y, z = quaternion.z;
+   LIBRE_MATRIX_TYPE xx = 2 * x * x, yy = 2 * y * y, zz = 2 * z * z;
+   LIBRE_MATRIX_TYPE xy = 2 * x * y, xz = 2 * x * z, yz = 2 * y * z;
+   LIBRE_MATRIX_TYPE wx = 2 * w * x, wy = 2 * w * y, wz = 2 * w * z;
+
+   destination[0] = 1 - yy - zz;
+   destination[1] = xy - wz;
+   destination[2] = xz + wy;
+   destination[3] = 0;
+
+   destination[4] = xy + wz;
+   destination[5] = 1 - xx - zz;
+   destination[6] = yz - wx;
+   destination[7] = 0;
+
+   destination[8] = xz - wy;
+   destination[9] = yz + wx;
+   destination[10] = 1 - xx - yy;
+   destination[11] = 0;
+
+   destination[12] = 0;
+   destination[13] = 0;
+   destination[14] = 0;
+   destination[15] = 1;
+}
+
+libre_mat4_t libre_quaternion_to_mat4(libre_quaternion_t quaternion)
+{
+   libre_mat4_t matrix;
+   libre_quaternion_to_matrix(quaternion, matrix.data);
+
+   return matrix;
+}
+
+int libre_quaternion_to_matrix_batch(const libre_quaternion_t *quaternions, LIBRE_MATRIX_TYPE *destination, int count)
+{
+   if (!quaternions || !destination || count < 0)
+      return -1;
+
+   for (int i = 0; i < count; i++)
+      libre_quaternion_to_matrix(quaternions[i], destination + i * 16);
+
+   return 0;
+}
@@ -0,0 +1,286 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/renderer.h"
+#include "opengl_state.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+int libre_renderer(libre_window_t window, int max_vertices, int max_indices, libre_renderer_t *renderer)
+{
+    if (!renderer)
+        return -1;
+    memset(renderer, 0, sizeof(*renderer));
+
+    if (max_vertices < 4 || max_indices < 6)
+        return -1;
+
+    renderer->window = window;
+    renderer->max_vertices = max_vertices;
+    renderer->max_indices = max_indices;
+
+    renderer->vertices = malloc(max_vertices * sizeof(*renderer->vertices));
+    renderer->indices = malloc(max_indices * sizeof(*renderer->indices));
+    if (!renderer->vertices || !renderer->indices)
+    {
+        libre_renderer_destroy(renderer);
+        return -1;
+    }
+
+    // the index buffer is bound while it is created, so the vao has to exist first
+    renderer->vao = libre_opengl_vao(window);
+    libre_opengl_vao_bind(renderer->vao);
+
+    if (libre_opengl_stream_buffer(window, GL_ARRAY_BUFFER, max_vertices * sizeof(*renderer->vertices), 3, &renderer->vbo))
+    {
+        libre_renderer_destroy(renderer);
+        return -1;
+    }
+
+    if (libre_opengl_stream_buffer(window, GL_ELEMENT_ARRAY_BUFFER, max_indices * sizeof(*renderer->indices), 3, &renderer->ibo))
+    {
+        libre_renderer_destroy(renderer);
+        return -1;
+    }
+
+    libre_opengl_vao_bind(renderer->vao);
+    libre_opengl_buffer_object_bind(renderer->vbo.buffer_object);
+    libre_opengl_buffer_object_bind(renderer->ibo.buffer_object);
+
+    // regions are selected with the base vertex and the index offset, so the attributes always start at zero
+    GLsizei stride = sizeof(libre_renderer_vertex_t);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(libre_renderer_vertex_t, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(libre_renderer_vertex_t, u));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(libre_renderer_vertex_t, r));
+
+    return 0;
+}
+
+void libre_renderer_begin(libre_renderer_t *renderer)
+{
+    if (!renderer)
+        return;
+
+    renderer->vertex_count = 0;
+    renderer->index_count = 0;
+    renderer->command_count = 0;
+    memset(&renderer->stats, 0, sizeof(renderer->stats));
+}
+
+int libre_renderer_submit(libre_renderer_t *renderer, int layer, libre_opengl_shader_t shader, libre_opengl_texture_t texture, const libre_renderer_vertex_t *vertices, int vertex_count, const uint32_t *indices, int index_count)
+{
+    if (!renderer || !vertices || !indices || vertex_count <= 0 || index_count <= 0)
+        return -1;
+    if (vertex_count > renderer->max_vertices || index_count > renderer->max_indices)
+        return -1;
+
+    if (renderer->vertex_count + vertex_count > renderer->max_vertices || renderer->index_count + index_count > renderer->max_indices)
+        libre_renderer_flush(renderer);
+
+    if (renderer->command_count == renderer->command_capacity)
+    {
+        int capacity = renderer->command_capacity ? renderer->command_capacity * 2 : 256;
+        libre_renderer_command_t *commands = realloc(renderer->commands, capacity * sizeof(*commands));
+        if (!commands)
+            return -1;
+
+        renderer->commands = commands;
+        renderer->command_capacity = capacity;
+    }
+
+    libre_renderer_command_t *command = &renderer->commands[renderer->command_count];
+    command->layer = layer;
+    command->sequence = renderer->command_count++;
+    command->shader = shader.id;
+    command->texture = texture.id;
+    command->first_index = renderer->index_count;
+    command->index_count = index_count;
+
+    memcpy(&renderer->vertices[renderer->vertex_count], vertices, vertex_count * sizeof(*vertices));
+
+    uint32_t base = renderer->vertex_count;
+    uint32_t *dest = &renderer->indices[renderer->index_count];
+    for (int i = 0; i < index_count; i++)
+        dest[i] = indices[i] + base;
+
+    renderer->vertex_count += vertex_count;
+    renderer->index_count += index_count;
+    renderer->stats.submissions++;
+
+    return 0;
+}
+
+int libre_renderer_quad(libre_renderer_t *renderer, int layer, libre_opengl_shader_t shader, libre_opengl_texture_t texture, float x, float y, float width, float height, float u0, float v0, float u1, float v1, uint32_t color)
+{
+    static const uint32_t indices[6] = {0, 1, 2, 0, 2, 3};
+
+    uint8_t r = (uint8_t)(color >> 24), g = (uint8_t)(color >> 16), b = (uint8_t)(color >> 8), a = (uint8_t)color;
+    libre_renderer_vertex_t vertices[4] = {
+        {x, y + height, 0, u0, v1, r, g, b, a},
+        {x, y, 0, u0, v0, r, g, b, a},
+        {x + width, y, 0, u1, v0, r, g, b, a},
+        {x + width, y + height, 0, u1, v1, r, g, b, a},
+    };
+
+    return libre_renderer_submit(renderer, layer, shader, texture, vertices, 4, indices, 6);
+}
+
+static int libre_renderer_compare(const void *a, const void *b)
+{
+    const libre_renderer_command_t *x = a, *y = b;
+
+    if (x->layer != y->layer)
+        return x->layer < y->layer ? -1 : 1;
+    if (x->shader != y->shader)
+        return x->shader < y->shader ? -1 : 1;
+    if (x->texture != y->texture)
+        return x->texture < y->texture ? -1 : 1;
+
+    // keeps submissions with the same state in the order they were made
+    return x->sequence < y->sequence ? -1 : x->sequence > y->sequence;
+}
+
+void libre_renderer_flush(libre_renderer_t *renderer)
+{
+    if (!renderer || renderer->command_count == 0)
+        return;
+
+    qsort(renderer->commands, renderer->command_count, sizeof(*renderer->commands), libre_renderer_compare);
+
+    // mapping the index buffer binds GL_ELEMENT_ARRAY_BUFFER, which belongs to whatever vao is bound
+    libre_opengl_vao_bind(renderer->vao);
+
+    libre_renderer_vertex_t *vertices = libre_opengl_stream_buffer_map(&renderer->vbo);
+    uint32_t *indices = libre_opengl_stream_buffer_map(&renderer->ibo);
+    if (vertices)
+        memcpy(vertices, renderer->vertices, renderer->vertex_count * sizeof(*vertices));
+    if (indices)
+    {
+        // indices are written in sorted order so every run of equal state is one contiguous range
+        int offset = 0;
+        for (int i = 0; i < renderer->command_count; i++)
+        {
+            libre_renderer_command_t *command = &renderer->commands[i];
+            memcpy(&indices[offset], &renderer->indices[command->first_index], command->index_count * sizeof(*indices));
+            command->first_index = offset;
+            offset += command->index_count;
+        }
+    }
+    libre_opengl_stream_buffer_unmap(&renderer->vbo);
+    libre_opengl_stream_buffer_unmap(&renderer->ibo);
+    libre_opengl_state_count(renderer->window, 0, (vertices ? renderer->vertex_count * sizeof(*vertices) : 0) + (indices ? renderer->index_count * sizeof(*indices) : 0), 0);
+
+    if (vertices && indices)
+    {
+        GLint base_vertex = (GLint)(renderer->vbo.offset / (GLintptr)sizeof(libre_renderer_vertex_t));
+        GLuint shader = 0, texture = 0;
+        bool first = true;
+
+        for (int i = 0; i < renderer->command_count;)
+        {
+            libre_renderer_command_t *command = &renderer->commands[i];
+
+            int count = 0, j = i;
+            for (; j < renderer->command_count; j++)
+            {
+                libre_renderer_command_t *next = &renderer->commands[j];
+                if (next->layer != command->layer || next->shader != command->shader || next->texture != command->texture)
+                    break;
+                count += next->index_count;
+            }
+
+            if (first || command->shader != shader)
+            {
+                libre_opengl_shader_t program = {.window = renderer->window, .id = command->shader};
+                libre_opengl_shader_use(program);
+                renderer->stats.shader_changes++;
+            }
+            if (first || command->texture != texture)
+            {
+                libre_opengl_texture_t bound = {.window = renderer->window, .id = command->texture};
+                libre_opengl_texture_bind(bound);
+                renderer->stats.texture_changes++;
+            }
+            shader = command->shader;
+            texture = command->texture;
+            first = false;
+
+            GLintptr offset = renderer->ibo.offset + command->first_index * (GLintptr)sizeof(uint32_t);
+            glDrawElementsBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void *)offset, base_vertex);
+            renderer->stats.draws++;
+            libre_opengl_state_count(renderer->window, 1, 0, 0);
+
+            i = j;
+        }
+
+        renderer->stats.vertices += renderer->vertex_count;
+        renderer->stats.indices += renderer->index_count;
+    }
+
+    libre_opengl_stream_buffer_advance(&renderer->vbo);
+    libre_opengl_stream_buffer_advance(&renderer->ibo);
+
+    renderer->vertex_count = 0;
+    renderer->index_count = 0;
+    renderer->command_count = 0;
+}
+
+libre_renderer_stats_t libre_renderer_end(libre_renderer_t *renderer)
+{
+    libre_renderer_stats_t stats = {0};
+    if (!renderer)
+        return stats;
+
+    libre_renderer_flush(renderer);
+    return renderer->stats;
+}
+
+void libre_renderer_destroy(libre_renderer_t *renderer)
+{
+    if (!renderer)
+        return;
+
+    if (renderer->vao.id)
+        libre_opengl_vao_destroy(renderer->vao);
+    if (renderer->ibo.buffer_object.id)
+        libre_opengl_stream_buffer_destroy(&renderer->ibo);
+    if (renderer->vbo.buffer_object.id)
+        libre_opengl_stream_buffer_destroy(&renderer->vbo);
+
+    free(renderer->commands);
+    free(renderer->indices);
+    free(renderer->vertices);
+    memset(renderer, 0, sizeof(*renderer));
+}
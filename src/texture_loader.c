@@ -0,0 +1,348 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <GL/glew.h>
+
+#include "libre/texture_loader.h"
+#include "opengl_state.h"
+#include "thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct libre_texture_loader_worker
+{
+    libre_thread_t thread;
+    libre_mutex_t mutex;
+    libre_cond_t work;
+    bool stop;
+
+    libre_texture_request_t *queue_head, *queue_tail;
+    libre_texture_request_t *done_head, *done_tail;
+} libre_texture_loader_worker_t;
+
+static void libre_texture_loader_append(libre_texture_request_t **head, libre_texture_request_t **tail, libre_texture_request_t *request)
+{
+    request->next = NULL;
+    if (*tail)
+        (*tail)->next = request;
+    else
+        *head = request;
+    *tail = request;
+}
+
+static void libre_texture_loader_main(void *argument)
+{
+    libre_texture_loader_worker_t *worker = argument;
+
+    libre_mutex_lock(&worker->mutex);
+    while (true)
+    {
+        while (!worker->stop && !worker->queue_head)
+            libre_cond_wait(&worker->work, &worker->mutex);
+        if (worker->stop)
+            break;
+
+        libre_texture_request_t *request = worker->queue_head;
+        worker->queue_head = request->next;
+        if (!worker->queue_head)
+            worker->queue_tail = NULL;
+
+        libre_mutex_unlock(&worker->mutex);
+        request->result = request->decode(request->argument, &request->image);
+        libre_mutex_lock(&worker->mutex);
+
+        libre_texture_loader_append(&worker->done_head, &worker->done_tail, request);
+    }
+    libre_mutex_unlock(&worker->mutex);
+}
+
+int libre_texture_loader(libre_window_t window, size_t budget, libre_texture_loader_t *loader)
+{
+    if (!loader)
+        return -1;
+    memset(loader, 0, sizeof(*loader));
+
+    if (budget == 0)
+        return -1;
+
+    libre_texture_loader_worker_t *worker = calloc(1, sizeof(*worker));
+    if (!worker)
+        return -1;
+
+    libre_mutex_init(&worker->mutex);
+    libre_cond_init(&worker->work);
+    if (libre_thread_create(&worker->thread, libre_texture_loader_main, worker))
+    {
+        libre_cond_destroy(&worker->work);
+        libre_mutex_destroy(&worker->mutex);
+        free(worker);
+        return -1;
+    }
+
+    loader->window = window;
+    loader->budget = budget;
+    loader->worker = worker;
+
+    for (int i = 0; i < LIBRE_TEXTURE_LOADER_PBOS; i++)
+        loader->pbos[i] = libre_opengl_buffer_object(window, GL_PIXEL_UNPACK_BUFFER);
+
+    return 0;
+}
+
+libre_texture_request_t *libre_texture_loader_load(libre_texture_loader_t *loader, libre_texture_decode_t decode, void *argument, GLint wrap, GLint filter)
+{
+    if (!loader || !loader->worker || !decode)
+        return NULL;
+
+    libre_texture_request_t *request = calloc(1, sizeof(*request));
+    if (!request)
+        return NULL;
+    request->decode = decode;
+    request->argument = argument;
+    request->wrap = wrap;
+    request->filter = filter;
+    request->status = LIBRE_TEXTURE_LOADER_PENDING;
+
+    libre_texture_loader_worker_t *worker = loader->worker;
+    libre_mutex_lock(&worker->mutex);
+    libre_texture_loader_append(&worker->queue_head, &worker->queue_tail, request);
+    libre_cond_signal(&worker->work);
+    libre_mutex_unlock(&worker->mutex);
+
+    return request;
+}
+
+static void libre_texture_loader_finish(libre_texture_loader_t *loader, int status)
+{
+    libre_texture_request_t *request = loader->head;
+    loader->head = request->next;
+    if (!loader->head)
+        loader->tail = NULL;
+
+    free(request->image.pixels);
+    request->image.pixels = NULL;
+    request->status = status;
+
+    if (request->released)
+    {
+        if (request->texture.id)
+            libre_opengl_texture_destroy(request->texture);
+        free(request);
+    }
+}
+
+size_t libre_texture_loader_update(libre_texture_loader_t *loader)
+{
+    if (!loader || !loader->worker)
+        return 0;
+    loader->bytes_uploaded = 0;
+
+    libre_texture_loader_worker_t *worker = loader->worker;
+    libre_mutex_lock(&worker->mutex);
+    if (worker->done_head)
+    {
+        if (loader->tail)
+            loader->tail->next = worker->done_head;
+        else
+            loader->head = worker->done_head;
+        loader->tail = worker->done_tail;
+
+        worker->done_head = NULL;
+        worker->done_tail = NULL;
+    }
+    libre_mutex_unlock(&worker->mutex);
+
+    if (!loader->head)
+        return 0;
+
+    libre_opengl_state_t *state = libre_opengl_state(loader->window);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    while (loader->head)
+    {
+        libre_texture_request_t *request = loader->head;
+        libre_texture_image_t *image = &request->image;
+        if (request->result || !image->pixels || image->width <= 0 || image->height <= 0)
+        {
+            libre_texture_loader_finish(loader, LIBRE_TEXTURE_LOADER_FAILED);
+            continue;
+        }
+
+        if (!request->texture.id && libre_opengl_texture_storage(loader->window, GL_RGBA8, image->width, image->height, 0, request->wrap, request->filter, &request->texture))
+        {
+            libre_texture_loader_finish(loader, LIBRE_TEXTURE_LOADER_FAILED);
+            continue;
+        }
+
+        size_t row_size = (size_t)image->width * 4;
+        while (request->row < image->height)
+        {
+            size_t remaining = loader->budget > loader->bytes_uploaded ? loader->budget - loader->bytes_uploaded : 0;
+            GLsizei rows = (GLsizei)(remaining / row_size);
+
+            // a single row larger than the whole budget still goes through, one per frame
+            if (rows == 0 && loader->bytes_uploaded > 0)
+                goto out;
+            if (rows == 0)
+                rows = 1;
+            if (rows > image->height - request->row)
+                rows = image->height - request->row;
+
+            GLsync *fence = &loader->fences[loader->pbo];
+            if (*fence)
+            {
+                if (glClientWaitSync(*fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                    goto out;
+
+                glDeleteSync(*fence);
+                *fence = NULL;
+            }
+
+            libre_opengl_buffer_object_t *pbo = &loader->pbos[loader->pbo];
+            GLsizeiptr size = (GLsizeiptr)(rows * row_size);
+            if (libre_opengl_buffer_object_reserve(pbo, size))
+            {
+                libre_texture_loader_finish(loader, LIBRE_TEXTURE_LOADER_FAILED);
+                break;
+            }
+
+            libre_opengl_buffer_object_bind(*pbo);
+            void *dest = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!dest)
+            {
+                libre_texture_loader_finish(loader, LIBRE_TEXTURE_LOADER_FAILED);
+                break;
+            }
+            memcpy(dest, image->pixels + request->row * row_size, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            libre_opengl_texture_bind(request->texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, request->row, image->width, rows, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+            *fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            loader->pbo = (loader->pbo + 1) % LIBRE_TEXTURE_LOADER_PBOS;
+
+            request->row += rows;
+            loader->bytes_uploaded += size;
+            libre_opengl_state_count(loader->window, 0, 0, size);
+        }
+
+        if (loader->head == request && request->row == image->height)
+        {
+            libre_opengl_texture_bind(request->texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            libre_texture_loader_finish(loader, LIBRE_TEXTURE_LOADER_DONE);
+        }
+    }
+
+out:
+    libre_opengl_state_buffer(state, GL_PIXEL_UNPACK_BUFFER, 0);
+    return loader->bytes_uploaded;
+}
+
+int libre_texture_loader_poll(const libre_texture_request_t *request, libre_opengl_texture_t *texture)
+{
+    if (!request)
+        return LIBRE_TEXTURE_LOADER_FAILED;
+
+    if (request->status == LIBRE_TEXTURE_LOADER_DONE && texture)
+        *texture = request->texture;
+
+    return request->status;
+}
+
+void libre_texture_loader_release(libre_texture_loader_t *loader, libre_texture_request_t *request)
+{
+    if (!request)
+        return;
+
+    // the texture is owned by the caller once the request is done, pending requests are freed by the loader
+    if (request->status != LIBRE_TEXTURE_LOADER_PENDING)
+    {
+        if (request->status != LIBRE_TEXTURE_LOADER_DONE && request->texture.id)
+            libre_opengl_texture_destroy(request->texture);
+        free(request);
+        return;
+    }
+
+    request->released = true;
+}
+
+static void libre_texture_loader_discard(libre_texture_request_t *request)
+{
+    while (request)
+    {
+        libre_texture_request_t *next = request->next;
+
+        free(request->image.pixels);
+        request->image.pixels = NULL;
+        if (request->texture.id)
+        {
+            libre_opengl_texture_destroy(request->texture);
+            request->texture.id = 0;
+        }
+        request->status = LIBRE_TEXTURE_LOADER_FAILED;
+
+        if (request->released)
+            free(request);
+        request = next;
+    }
+}
+
+void libre_texture_loader_destroy(libre_texture_loader_t *loader)
+{
+    if (!loader || !loader->worker)
+        return;
+
+    libre_texture_loader_worker_t *worker = loader->worker;
+    libre_mutex_lock(&worker->mutex);
+    worker->stop = true;
+    libre_cond_broadcast(&worker->work);
+    libre_mutex_unlock(&worker->mutex);
+
+    libre_thread_join(worker->thread);
+
+    libre_texture_loader_discard(worker->queue_head);
+    libre_texture_loader_discard(worker->done_head);
+    libre_texture_loader_discard(loader->head);
+
+    libre_cond_destroy(&worker->work);
+    libre_mutex_destroy(&worker->mutex);
+    free(worker);
+
+    libre_opengl_state(loader->window);
+    for (int i = 0; i < LIBRE_TEXTURE_LOADER_PBOS; i++)
+    {
+        if (loader->fences[i])
+            glDeleteSync(loader->fences[i]);
+        libre_opengl_buffer_object_destroy(loader->pbos[i]);
+    }
+
+    memset(loader, 0, sizeof(*loader));
+}
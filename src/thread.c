@@ -0,0 +1,218 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "thread.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct libre_thread_start
+{
+    void (*function)(void *);
+    void *argument;
+} libre_thread_start_t;
+
+#ifdef _WIN32
+static DWORD WINAPI libre_thread_main(LPVOID parameter)
+#else
+static void *libre_thread_main(void *parameter)
+#endif
+{
+    libre_thread_start_t start = *(libre_thread_start_t *)parameter;
+    free(parameter);
+
+    start.function(start.argument);
+    return 0;
+}
+
+int libre_thread_create(libre_thread_t *thread, void (*function)(void *), void *argument)
+{
+    libre_thread_start_t *start = malloc(sizeof(*start));
+    if (!start)
+        return -1;
+    start->function = function;
+    start->argument = argument;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, libre_thread_main, start, 0, NULL);
+    if (!*thread)
+#else
+    if (pthread_create(thread, NULL, libre_thread_main, start))
+#endif
+    {
+        free(start);
+        return -1;
+    }
+
+    return 0;
+}
+
+void libre_thread_join(libre_thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+int libre_thread_hardware_concurrency(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+void libre_mutex_init(libre_mutex_t *mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void libre_mutex_destroy(libre_mutex_t *mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void libre_mutex_lock(libre_mutex_t *mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void libre_mutex_unlock(libre_mutex_t *mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void libre_cond_init(libre_cond_t *cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+void libre_cond_destroy(libre_cond_t *cond)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void libre_cond_wait(libre_cond_t *cond, libre_mutex_t *mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void libre_cond_signal(libre_cond_t *cond)
+{
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void libre_cond_broadcast(libre_cond_t *cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+void *libre_atomic_compare_exchange_pointer(void *volatile *target, void *expected, void *desired)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchangePointer(target, desired, expected);
+#else
+    return __sync_val_compare_and_swap(target, expected, desired);
+#endif
+}
+
+double libre_clock_seconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+void libre_clock_sleep(double seconds)
+{
+    if (seconds <= 0.0)
+        return;
+
+#ifdef _WIN32
+    Sleep((DWORD)(seconds * 1000.0));
+#else
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - (double)duration.tv_sec) * 1e9);
+    while (nanosleep(&duration, &duration) && errno == EINTR)
+        ;
+#endif
+}
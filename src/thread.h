@@ -0,0 +1,71 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _MSC_VER
+#define LIBRE_THREAD_LOCAL __declspec(thread)
+#else
+#define LIBRE_THREAD_LOCAL __thread
+#endif
+
+#ifdef _WIN32
+typedef HANDLE libre_thread_t;
+typedef CRITICAL_SECTION libre_mutex_t;
+typedef CONDITION_VARIABLE libre_cond_t;
+#else
+typedef pthread_t libre_thread_t;
+typedef pthread_mutex_t libre_mutex_t;
+typedef pthread_cond_t libre_cond_t;
+#endif
+
+int libre_thread_create(libre_thread_t *thread, void (*function)(void *), void *argument);
+void libre_thread_join(libre_thread_t thread);
+int libre_thread_hardware_concurrency(void);
+
+void libre_mutex_init(libre_mutex_t *mutex);
+void libre_mutex_destroy(libre_mutex_t *mutex);
+void libre_mutex_lock(libre_mutex_t *mutex);
+void libre_mutex_unlock(libre_mutex_t *mutex);
+
+void libre_cond_init(libre_cond_t *cond);
+void libre_cond_destroy(libre_cond_t *cond);
+void libre_cond_wait(libre_cond_t *cond, libre_mutex_t *mutex);
+void libre_cond_signal(libre_cond_t *cond);
+void libre_cond_broadcast(libre_cond_t *cond);
+
+void *libre_atomic_compare_exchange_pointer(void *volatile *target, void *expected, void *desired);
+
+double libre_clock_seconds(void);
+void libre_clock_sleep(double seconds);
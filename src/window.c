@@ -26,12 +26,85 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <GL/glew.h>
+
 #include "libre/window.h"
+#include "opengl_state.h"
+#include "thread.h"
 
 #include <GLFW/glfw3.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef LIBRE_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define LIBRE_WINDOW_EGL_DISPLAYS 8
+#define LIBRE_WINDOW_EGL_DEVICES 16
+
+/*
+Displays are shared by the whole process, so libre only terminates the ones it initialized itself, once the last
+headless window on them is destroyed. Like glfw windows, headless windows are created and destroyed on one thread.
+*/
+typedef struct libre_window_egl_display
+{
+    EGLDisplay display;
+    int references;
+} libre_window_egl_display_t;
+
+static libre_window_egl_display_t libre_window_egl_displays[LIBRE_WINDOW_EGL_DISPLAYS];
+
+static bool libre_window_egl_acquire(EGLDisplay display)
+{
+    if (display == EGL_NO_DISPLAY)
+        return false;
+
+    libre_window_egl_display_t *unused = NULL;
+    for (int i = 0; i < LIBRE_WINDOW_EGL_DISPLAYS; i++)
+    {
+        libre_window_egl_display_t *entry = &libre_window_egl_displays[i];
+        if (entry->references > 0 && entry->display == display)
+        {
+            entry->references++;
+            return true;
+        }
+        if (entry->references == 0 && !unused)
+            unused = entry;
+    }
+
+    // initialized by the application, which then stays responsible for terminating it
+    if (eglQueryString(display, EGL_VENDOR))
+        return true;
+
+    if (!eglInitialize(display, NULL, NULL))
+        return false;
+
+    // without a free entry the display is simply never terminated
+    if (unused)
+    {
+        unused->display = display;
+        unused->references = 1;
+    }
+    return true;
+}
+
+static void libre_window_egl_release(EGLDisplay display)
+{
+    for (int i = 0; i < LIBRE_WINDOW_EGL_DISPLAYS; i++)
+    {
+        libre_window_egl_display_t *entry = &libre_window_egl_displays[i];
+        if (entry->references > 0 && entry->display == display)
+        {
+            if (--entry->references == 0)
+                eglTerminate(display);
+            return;
+        }
+    }
+}
+#endif
+
 int libre_window_init(void)
 {
     return glfwInit() == GLFW_TRUE ? 0 : -1;
@@ -71,16 +144,21 @@ int libre_window_create(libre_window_t *window, int width, int height, char *tit
 
 void libre_window_show(libre_window_t window)
 {
-    glfwShowWindow(window.window);
+    if (window.window)
+        glfwShowWindow(window.window);
 }
 
 void libre_window_hide(libre_window_t window)
 {
-    glfwHideWindow(window.window);
+    if (window.window)
+        glfwHideWindow(window.window);
 }
 
 void libre_window_fullsreen(libre_window_t window, bool fullscreen)
 {
+    if (!window.window)
+        return;
+
     if (fullscreen)
     {
         GLFWmonitor *monitor = glfwGetPrimaryMonitor();
@@ -95,21 +173,56 @@ void libre_window_fullsreen(libre_window_t window, bool fullscreen)
 
 bool libre_window_should_close(libre_window_t window)
 {
+    if (!window.window)
+        return false;
+
     return glfwWindowShouldClose(window.window) ? true : false;
 }
 
 void libre_window_destroy(libre_window_t window)
 {
-    glfwDestroyWindow(window.window);
+    libre_opengl_state_release(window);
+
+    if (window.window)
+    {
+        glfwDestroyWindow(window.window);
+        return;
+    }
+
+#ifdef LIBRE_HAVE_EGL
+    if (!window.display)
+        return;
+
+    if (eglGetCurrentContext() == window.context)
+        eglMakeCurrent(window.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (window.surface != EGL_NO_SURFACE)
+        eglDestroySurface(window.display, window.surface);
+    if (window.context != EGL_NO_CONTEXT)
+        eglDestroyContext(window.display, window.context);
+    libre_window_egl_release(window.display);
+#endif
 }
 
 void libre_window_swap_buffers(libre_window_t window)
 {
-    glfwSwapBuffers(window.window);
+    if (window.window)
+    {
+        glfwSwapBuffers(window.window);
+        return;
+    }
+
+#ifdef LIBRE_HAVE_EGL
+    // a pbuffer is single buffered, so this only finishes the frame, a surfaceless context has nothing to swap
+    if (window.display && window.surface != EGL_NO_SURFACE)
+        eglSwapBuffers(window.display, window.surface);
+#endif
 }
 
 void libre_window_center(libre_window_t window)
 {
+    if (!window.window)
+        return;
+
     GLFWmonitor *monitor = glfwGetPrimaryMonitor();
     int xpos, ypos, width, height;
     glfwGetMonitorWorkarea(monitor, &xpos, &ypos, &width, &height);
@@ -119,3 +232,376 @@ void libre_window_center(libre_window_t window)
 
     glfwSetWindowPos(window.window, xpos + width / 2 - windowWidth / 2, ypos + height / 2 - windowHeight / 2);
 }
+
+#ifdef LIBRE_HAVE_EGL
+static EGLDisplay libre_window_egl_software_display(const char *extensions)
+{
+    if (!extensions || !strstr(extensions, "EGL_EXT_device_enumeration") || !strstr(extensions, "EGL_EXT_platform_device"))
+        return EGL_NO_DISPLAY;
+
+    PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    PFNEGLQUERYDEVICESTRINGEXTPROC queryDeviceString = (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!queryDevices || !queryDeviceString || !getPlatformDisplay)
+        return EGL_NO_DISPLAY;
+
+    EGLDeviceEXT devices[LIBRE_WINDOW_EGL_DEVICES];
+    EGLint count = 0;
+    if (!queryDevices(LIBRE_WINDOW_EGL_DEVICES, devices, &count))
+        return EGL_NO_DISPLAY;
+
+    for (EGLint i = 0; i < count; i++)
+    {
+        const char *deviceExtensions = queryDeviceString(devices[i], EGL_EXTENSIONS);
+        if (!deviceExtensions || !strstr(deviceExtensions, "EGL_MESA_device_software"))
+            continue;
+
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+        if (libre_window_egl_acquire(display))
+            return display;
+    }
+
+    return EGL_NO_DISPLAY;
+}
+
+static EGLDisplay libre_window_egl_display(bool software)
+{
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    // mesa exposes llvmpipe as a device of its own, selecting it leaves the environment of the process alone
+    if (software)
+        return libre_window_egl_software_display(extensions);
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    // the surfaceless platform needs neither x11 nor wayland nor a drm device, which is what a ci runner has
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+        {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (libre_window_egl_acquire(display))
+                return display;
+        }
+    }
+#else
+    (void)extensions;
+#endif
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (libre_window_egl_acquire(display))
+        return display;
+
+    return EGL_NO_DISPLAY;
+}
+
+static int libre_window_egl_create(libre_window_t *window, int width, int height, bool software)
+{
+    EGLDisplay display = libre_window_egl_display(software);
+    if (display == EGL_NO_DISPLAY)
+        return -1;
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        libre_window_egl_release(display);
+        return -1;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_DONT_CARE,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount < 1)
+    {
+        libre_window_egl_release(display);
+        return -1;
+    }
+
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        libre_window_egl_release(display);
+        return -1;
+    }
+
+    // prefer a pbuffer so the default framebuffer exists, the surfaceless platform has no pbuffer configs though
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLint surfaceType = 0;
+    eglGetConfigAttrib(display, config, EGL_SURFACE_TYPE, &surfaceType);
+    if (surfaceType & EGL_PBUFFER_BIT)
+    {
+        const EGLint surfaceAttributes[] = {
+            EGL_WIDTH, width,
+            EGL_HEIGHT, height,
+            EGL_NONE,
+        };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    }
+
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+    if ((surface == EGL_NO_SURFACE && !surfaceless) || !eglMakeCurrent(display, surface, surface, context))
+    {
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        eglDestroyContext(display, context);
+        libre_window_egl_release(display);
+        return -1;
+    }
+
+    window->display = display;
+    window->context = context;
+    window->surface = surface;
+    window->width = width;
+    window->height = height;
+
+    return 0;
+}
+#endif
+
+int libre_window_create_headless(libre_window_t *window, int width, int height)
+{
+    if (!window || width <= 0 || height <= 0)
+        return -1;
+    memset(window, 0, sizeof(*window));
+
+#ifdef LIBRE_HAVE_EGL
+    if (libre_window_egl_create(window, width, height, false) == 0)
+        return 0;
+
+    // no usable gpu driver, mesa can still render on the cpu with llvmpipe
+    return libre_window_egl_create(window, width, height, true);
+#else
+    return -1;
+#endif
+}
+
+void libre_window_make_current(libre_window_t window)
+{
+    if (window.window || !window.context)
+    {
+        glfwMakeContextCurrent(window.window);
+        return;
+    }
+
+#ifdef LIBRE_HAVE_EGL
+    eglMakeCurrent(window.display, window.surface, window.surface, window.context);
+#endif
+}
+
+bool libre_window_is_current(libre_window_t window)
+{
+    if (window.window || !window.context)
+        return glfwGetCurrentContext() == window.window;
+
+#ifdef LIBRE_HAVE_EGL
+    return eglGetCurrentContext() == window.context;
+#else
+    return false;
+#endif
+}
+
+void libre_window_get_size(libre_window_t window, int *width, int *height)
+{
+    if (window.window)
+    {
+        glfwGetFramebufferSize(window.window, width, height);
+        return;
+    }
+
+    if (width)
+        *width = window.width;
+    if (height)
+        *height = window.height;
+}
+
+int libre_window_swap_interval(libre_window_t window, int interval)
+{
+    libre_opengl_state(window);
+
+    if (window.window)
+    {
+        // late frames may only tear when the driver says so, otherwise -1 is not a valid interval
+        if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            interval = 1;
+
+        glfwSwapInterval(interval);
+        return interval;
+    }
+
+#ifdef LIBRE_HAVE_EGL
+    if (interval < 0)
+        interval = 1;
+    if (window.display && window.surface != EGL_NO_SURFACE && eglSwapInterval(window.display, interval))
+        return interval;
+#endif
+
+    return 0;
+}
+
+void libre_window_pacer_rate(libre_window_pacer_t *pacer, double rate)
+{
+    if (!pacer)
+        return;
+
+    pacer->period = rate > 0.0 ? 1.0 / rate : 0.0;
+    pacer->deadline = libre_clock_seconds() + pacer->period;
+}
+
+int libre_window_pacer(libre_window_t window, int mode, double rate, int frames_in_flight, libre_window_pacer_t *pacer)
+{
+    if (!pacer)
+        return -1;
+    memset(pacer, 0, sizeof(*pacer));
+
+    if (mode < LIBRE_WINDOW_PACING_UNCAPPED || mode > LIBRE_WINDOW_PACING_ADAPTIVE || rate < 0.0 || frames_in_flight < 0 || frames_in_flight > LIBRE_WINDOW_PACER_FRAMES_MAX)
+        return -1;
+
+    pacer->window = window;
+    pacer->mode = mode;
+    pacer->frames_in_flight = frames_in_flight;
+    pacer->margin = 0.001;
+
+    int interval = 0;
+    if (mode == LIBRE_WINDOW_PACING_VSYNC)
+        interval = 1;
+    else if (mode == LIBRE_WINDOW_PACING_ADAPTIVE)
+        interval = -1;
+    pacer->interval = libre_window_swap_interval(window, interval);
+
+    libre_window_pacer_rate(pacer, rate);
+    pacer->last = libre_clock_seconds();
+
+    return 0;
+}
+
+static void libre_window_pacer_limit(libre_window_pacer_t *pacer)
+{
+    if (pacer->period <= 0.0)
+        return;
+
+    // sleep most of the way, the scheduler is too coarse for the rest so the last part is spun
+    double now = libre_clock_seconds();
+    double sleep = pacer->deadline - now - pacer->margin;
+    if (sleep > 0.0)
+    {
+        libre_clock_sleep(sleep);
+
+        double after = libre_clock_seconds();
+        double overshoot = (after - now - sleep) * 1.5;
+        pacer->margin = overshoot > pacer->margin ? overshoot : pacer->margin * 0.99;
+        if (pacer->margin < 0.0002)
+            pacer->margin = 0.0002;
+        if (pacer->margin > 0.004)
+            pacer->margin = 0.004;
+        now = after;
+    }
+
+    while (now < pacer->deadline)
+        now = libre_clock_seconds();
+
+    // a missed deadline starts a new schedule instead of rushing the next frames to catch up
+    pacer->deadline += pacer->period;
+    if (pacer->deadline < now)
+        pacer->deadline = now + pacer->period;
+}
+
+void libre_window_pacer_swap(libre_window_pacer_t *pacer)
+{
+    if (!pacer)
+        return;
+
+    libre_window_pacer_limit(pacer);
+    libre_window_swap_buffers(pacer->window);
+
+    if (pacer->frames_in_flight > 0)
+    {
+        libre_opengl_state(pacer->window);
+
+        // waiting before the new fence goes in keeps the ring small, the frame just swapped is never waited on
+        while (pacer->fence_count >= pacer->frames_in_flight)
+        {
+            GLsync fence = (GLsync)pacer->fences[pacer->fence];
+            GLenum status;
+            do
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            while (status == GL_TIMEOUT_EXPIRED);
+
+            glDeleteSync(fence);
+            pacer->fences[pacer->fence] = NULL;
+            pacer->fence = (pacer->fence + 1) % LIBRE_WINDOW_PACER_FRAMES_MAX;
+            pacer->fence_count--;
+        }
+
+        pacer->fences[(pacer->fence + pacer->fence_count) % LIBRE_WINDOW_PACER_FRAMES_MAX] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pacer->fence_count++;
+    }
+
+    double now = libre_clock_seconds();
+    pacer->samples[pacer->sample] = now - pacer->last;
+    pacer->sample = (pacer->sample + 1) % LIBRE_WINDOW_PACER_SAMPLES;
+    if (pacer->sample_count < LIBRE_WINDOW_PACER_SAMPLES)
+        pacer->sample_count++;
+    pacer->last = now;
+}
+
+static int libre_window_compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+libre_window_frame_stats_t libre_window_pacer_stats(const libre_window_pacer_t *pacer)
+{
+    libre_window_frame_stats_t stats = {0};
+    if (!pacer || pacer->sample_count == 0)
+        return stats;
+
+    double samples[LIBRE_WINDOW_PACER_SAMPLES];
+    int count = pacer->sample_count;
+    memcpy(samples, pacer->samples, count * sizeof(*samples));
+    qsort(samples, count, sizeof(*samples), libre_window_compare_doubles);
+
+    double sum = 0.0;
+    for (int i = 0; i < count; i++)
+        sum += samples[i];
+
+    int p99 = (count * 99 + 99) / 100 - 1;
+    stats.count = count;
+    stats.last = pacer->samples[(pacer->sample + LIBRE_WINDOW_PACER_SAMPLES - 1) % LIBRE_WINDOW_PACER_SAMPLES];
+    stats.min = samples[0];
+    stats.avg = sum / count;
+    stats.p99 = samples[p99 < count ? p99 : count - 1];
+    stats.max = samples[count - 1];
+
+    return stats;
+}
+
+void libre_window_pacer_destroy(libre_window_pacer_t *pacer)
+{
+    if (!pacer)
+        return;
+
+    if (pacer->fence_count > 0)
+    {
+        libre_opengl_state(pacer->window);
+        for (int i = 0; i < pacer->fence_count; i++)
+            glDeleteSync((GLsync)pacer->fences[(pacer->fence + i) % LIBRE_WINDOW_PACER_FRAMES_MAX]);
+    }
+
+    memset(pacer, 0, sizeof(*pacer));
+}
@@ -0,0 +1,357 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <libre/matrix.h>
+#include <libre/pool.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MIN_SECONDS 0.2
+#define REFERENCE_TIMING_SIZE 1024
+#define SAMPLES 256
+
+typedef struct bench_result
+{
+    const char *op;
+    int size;
+    double ns_per_op, gflops, allocs_per_op, reference_gflops;
+    float max_error;
+    bool checked;
+} bench_result_t;
+
+typedef void (*bench_function_t)(void *argument);
+
+static unsigned long allocations = 0;
+static volatile float sink = 0;
+
+static void *counting_alloc(void *user, size_t size)
+{
+    allocations++;
+    return malloc(size);
+}
+
+static void counting_free(void *user, void *pointer)
+{
+    free(pointer);
+}
+
+static const libre_allocator_t counting_allocator = {counting_alloc, counting_free, NULL};
+
+static double seconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+// runs function until MIN_SECONDS have passed and returns seconds per call, allocations are counted per call
+static double measure(bench_function_t function, void *argument, double *allocs_per_op)
+{
+    function(argument);
+
+    long iterations = 1;
+    while (true)
+    {
+        allocations = 0;
+        double start = seconds();
+        for (long i = 0; i < iterations; i++)
+            function(argument);
+        double elapsed = seconds() - start;
+
+        if (elapsed >= MIN_SECONDS || iterations >= 1L << 30)
+        {
+            *allocs_per_op = (double)allocations / iterations;
+            return elapsed / iterations;
+        }
+
+        iterations = elapsed > MIN_SECONDS / 64 ? (long)(iterations * MIN_SECONDS * 1.2 / elapsed) + 1 : iterations * 8;
+    }
+}
+
+typedef struct matrices
+{
+    libre_matrix_t a, b, c;
+} matrices_t;
+
+static void bench_multiply(void *argument)
+{
+    matrices_t *m = argument;
+    libre_matrix_destroy(libre_matrix_multiply(m->a, m->b, NULL, NULL));
+}
+
+static void bench_add(void *argument)
+{
+    matrices_t *m = argument;
+    libre_matrix_destroy(libre_matrix_add(m->a, m->b, NULL, NULL));
+}
+
+static void bench_scale(void *argument)
+{
+    matrices_t *m = argument;
+    libre_matrix_scale(m->c, 1.0f);
+}
+
+static void bench_matrix_translation(void *argument)
+{
+    libre_matrix_destroy(libre_matrix_translation(1.0f, 2.0f, 3.0f, NULL));
+}
+
+static void bench_matrix_rotation(void *argument)
+{
+    libre_matrix_destroy(libre_matrix_rotation(1.0f, 0.5f, 0.25f, 0.125f, NULL));
+}
+
+static void bench_matrix_projection_ortho(void *argument)
+{
+    libre_matrix_destroy(libre_matrix_projection_ortho(-1.0f, 1.0f, 1.0f, -1.0f, 0.1f, 100.0f, NULL));
+}
+
+static void bench_mat4_chain(void *argument)
+{
+    libre_mat4_t transform = libre_mat4_multiply(libre_mat4_projection_ortho(-1.0f, 1.0f, 1.0f, -1.0f, 0.1f, 100.0f), libre_mat4_multiply(libre_mat4_translation(1.0f, 2.0f, 3.0f), libre_mat4_rotation(1.0f, 0.5f, 0.25f, 0.125f)));
+    sink += transform.data[3];
+}
+
+static void bench_batch_transform4(void *argument)
+{
+    matrices_t *m = argument;
+    libre_matrix_batch_transform4(m->a.data, m->b.data, m->c.data, m->b.rows);
+}
+
+static void naive_multiply(libre_matrix_t a, libre_matrix_t b, libre_matrix_t product)
+{
+    for (int i = 0; i < product.rows; i++)
+        for (int j = 0; j < product.columns; j++)
+        {
+            float sum = 0;
+            for (int k = 0; k < a.columns; k++)
+                sum += LIBRE_MATRIX_GET(a, i, k) * LIBRE_MATRIX_GET(b, k, j);
+
+            LIBRE_MATRIX_SET(product, i, j, sum);
+        }
+}
+
+static float naive_element(libre_matrix_t a, libre_matrix_t b, int i, int j)
+{
+    float sum = 0;
+    for (int k = 0; k < a.columns; k++)
+        sum += LIBRE_MATRIX_GET(a, i, k) * LIBRE_MATRIX_GET(b, k, j);
+    return sum;
+}
+
+static void fill(libre_matrix_t matrix, int seed)
+{
+    for (int i = 0; i < matrix.rows * matrix.columns; i++)
+        matrix.data[i] = (float)((i * seed) % 17) / 7.0f - 1.0f;
+}
+
+// the error is divided by the inner dimension so that large sizes are not penalized for longer sums
+static float check_multiply(libre_matrix_t a, libre_matrix_t b, double *reference_gflops)
+{
+    int n = a.rows;
+    libre_matrix_t product = libre_matrix_multiply(a, b, NULL, NULL);
+    float error = 0;
+
+    *reference_gflops = -1;
+    if (n <= REFERENCE_TIMING_SIZE)
+    {
+        libre_matrix_t reference;
+        libre_matrix_create(&reference, n, n);
+
+        double start = seconds();
+        naive_multiply(a, b, reference);
+        double elapsed = seconds() - start;
+        if (elapsed > 0)
+            *reference_gflops = 2.0 * n * n * n / elapsed * 1e-9;
+
+        for (int i = 0; i < n * n; i++)
+            if (fabsf(reference.data[i] - product.data[i]) > error)
+                error = fabsf(reference.data[i] - product.data[i]);
+
+        libre_matrix_destroy(reference);
+    }
+    else
+        for (int s = 0; s < SAMPLES; s++)
+        {
+            int i = (s * 7919) % n, j = (s * 104729) % n;
+            float difference = fabsf(naive_element(a, b, i, j) - LIBRE_MATRIX_GET(product, i, j));
+            if (difference > error)
+                error = difference;
+        }
+
+    libre_matrix_destroy(product);
+    return error / n;
+}
+
+static void print_result(bench_result_t result, bool json, bool first)
+{
+    if (json)
+    {
+        printf("%s    {\"op\": \"%s\", \"size\": %d, \"ns_per_op\": %.1f, \"gflops\": %.3f, \"allocs_per_op\": %.2f", first ? "" : ",\n", result.op, result.size, result.ns_per_op, result.gflops, result.allocs_per_op);
+        if (result.checked)
+            printf(", \"max_error\": %g", result.max_error);
+        if (result.reference_gflops >= 0)
+            printf(", \"reference_gflops\": %.3f", result.reference_gflops);
+        printf("}");
+        return;
+    }
+
+    printf("%-24s %6d %14.1f %10.3f %10.2f", result.op, result.size, result.ns_per_op, result.gflops, result.allocs_per_op);
+    if (result.checked)
+        printf(" %12g", result.max_error);
+    else
+        printf(" %12s", "-");
+    if (result.reference_gflops >= 0)
+        printf(" %10.3f", result.reference_gflops);
+    printf("\n");
+}
+
+static bench_result_t run(const char *op, int size, double flops, bench_function_t function, void *argument)
+{
+    bench_result_t result = {0};
+    result.op = op;
+    result.size = size;
+    result.reference_gflops = -1;
+
+    double time = measure(function, argument, &result.allocs_per_op);
+    result.ns_per_op = time * 1e9;
+    result.gflops = flops / time * 1e-9;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    bool json = false;
+    int max = 2048, threads = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--json"))
+            json = true;
+        else if (!strcmp(argv[i], "--max") && i + 1 < argc)
+            max = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else
+        {
+            printf("usage: %s [--json] [--max size] [--threads count]\n", argv[0]);
+            return -1;
+        }
+    }
+
+    if (threads != 1 && libre_pool_init(threads))
+    {
+        printf("failed to start thread pool\n");
+        return -1;
+    }
+
+    libre_matrix_set_allocator(&counting_allocator);
+
+    if (json)
+        printf("{\n  \"isa\": %d,\n  \"threads\": %d,\n  \"results\": [\n", libre_matrix_isa(), libre_pool_threads());
+    else
+    {
+        printf("isa: %d, threads: %d\n", libre_matrix_isa(), libre_pool_threads());
+        printf("%-24s %6s %14s %10s %10s %12s %10s\n", "op", "size", "ns/op", "GFLOP/s", "allocs/op", "max error", "naive");
+    }
+
+    bool first = true;
+    bench_result_t result;
+
+    result = run("matrix_translation", 4, 0, bench_matrix_translation, NULL);
+    print_result(result, json, first);
+    first = false;
+    print_result(run("matrix_rotation", 4, 0, bench_matrix_rotation, NULL), json, first);
+    print_result(run("matrix_projection_ortho", 4, 0, bench_matrix_projection_ortho, NULL), json, first);
+    print_result(run("mat4_chain", 4, 2 * 112.0, bench_mat4_chain, NULL), json, first);
+
+    for (int n = 4; n <= max; n *= 2)
+    {
+        matrices_t m;
+        if (libre_matrix_create(&m.a, n, n) || libre_matrix_create(&m.b, n, n) || libre_matrix_create(&m.c, n, n))
+        {
+            printf("error\n");
+            return -1;
+        }
+        fill(m.a, 7919);
+        fill(m.b, 104729);
+        fill(m.c, 31);
+
+        result = run("multiply", n, 2.0 * n * n * n, bench_multiply, &m);
+        result.max_error = check_multiply(m.a, m.b, &result.reference_gflops);
+        result.checked = true;
+        print_result(result, json, first);
+
+        print_result(run("add", n, (double)n * n, bench_add, &m), json, first);
+        print_result(run("scale", n, (double)n * n, bench_scale, &m), json, first);
+
+        libre_matrix_destroy(m.c);
+        libre_matrix_destroy(m.b);
+        libre_matrix_destroy(m.a);
+    }
+
+    for (int count = 64; count <= 65536; count *= 32)
+    {
+        matrices_t m;
+        libre_matrix_create(&m.a, 4, 4);
+        libre_matrix_create(&m.b, count, 4);
+        libre_matrix_create(&m.c, count, 4);
+        fill(m.a, 7919);
+        fill(m.b, 104729);
+
+        print_result(run("batch_transform4", count, 28.0 * count, bench_batch_transform4, &m), json, first);
+
+        libre_matrix_destroy(m.c);
+        libre_matrix_destroy(m.b);
+        libre_matrix_destroy(m.a);
+    }
+
+    if (json)
+        printf("\n  ]\n}\n");
+
+    libre_matrix_set_allocator(NULL);
+    libre_pool_terminate();
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <GL/glew.h>
+
+#include <libre/atlas.h>
+#include <libre/opengl.h>
+#include <libre/profiler.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+// checks for the parts of the gl modules that run without a context
+
+static void put_u32(uint8_t *data, uint32_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+static void fourcc(uint8_t *data, const char *code)
+{
+    memcpy(data, code, 4);
+}
+
+static int test_ktx(void)
+{
+    static const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    uint8_t data[128] = {0};
+    memcpy(data, identifier, sizeof(identifier));
+    uint32_t fields[13] = {0x04030201, GL_UNSIGNED_BYTE, 1, GL_RGBA, GL_RGBA8, GL_RGBA, 4, 2, 0, 0, 1, 3, 8};
+    for (int i = 0; i < 13; i++)
+        put_u32(data + 12 + i * 4, fields[i]);
+
+    int status = 0;
+    libre_opengl_texture_header_t header;
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) || header.internal_format != GL_RGBA8 || header.format != GL_RGBA || header.type != GL_UNSIGNED_BYTE || header.width != 4 || header.height != 2 || header.levels != 3 || header.compressed || header.offset != 72)
+        status = -1;
+
+    // generated mipmaps for compressed data
+    put_u32(data + 16, 0);
+    put_u32(data + 56, 0);
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) == 0)
+        status = -1;
+    put_u32(data + 16, GL_UNSIGNED_BYTE);
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) || header.levels != 0)
+        status = -1;
+
+    // arrays and key value data past the end
+    put_u32(data + 48, 2);
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) == 0)
+        status = -1;
+    put_u32(data + 48, 0);
+    put_u32(data + 60, 65);
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) == 0)
+        status = -1;
+    put_u32(data + 60, 8);
+
+    data[1] = 'k';
+    if (libre_opengl_texture_ktx_header(data, sizeof(data), &header) == 0 || libre_opengl_texture_ktx_header(data, 63, &header) == 0)
+        status = -1;
+
+    if (status)
+        printf("ktx mismatch\n");
+    return status;
+}
+
+static int test_dds(void)
+{
+    uint8_t data[160] = {0};
+    fourcc(data, "DDS ");
+    put_u32(data + 4, 124);
+    put_u32(data + 8, 0x20000);
+    put_u32(data + 12, 8);
+    put_u32(data + 16, 16);
+    put_u32(data + 28, 4);
+    put_u32(data + 80, 0x4);
+    fourcc(data + 84, "DXT1");
+
+    int status = 0;
+    libre_opengl_texture_header_t header;
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) || header.internal_format != GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || header.width != 16 || header.height != 8 || header.levels != 4 || !header.compressed || header.block_size != 8 || header.offset != 128)
+        status = -1;
+
+    // without the mipmap flag the level count is ignored
+    put_u32(data + 8, 0);
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) || header.levels != 1)
+        status = -1;
+
+    fourcc(data + 84, "DX10");
+    put_u32(data + 128, 98);
+    put_u32(data + 132, 3);
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) || header.internal_format != GL_COMPRESSED_RGBA_BPTC_UNORM || header.block_size != 16 || header.offset != 148)
+        status = -1;
+    if (libre_opengl_texture_dds_header(data, 147, &header) == 0)
+        status = -1;
+
+    // texture arrays, cube maps and unknown formats
+    put_u32(data + 140, 2);
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) == 0)
+        status = -1;
+    put_u32(data + 140, 0);
+    put_u32(data + 112, 0x200);
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) == 0)
+        status = -1;
+    put_u32(data + 112, 0);
+    fourcc(data + 84, "RGBG");
+    if (libre_opengl_texture_dds_header(data, sizeof(data), &header) == 0)
+        status = -1;
+
+    if (status)
+        printf("dds mismatch\n");
+    return status;
+}
+
+static int test_skyline(void)
+{
+    libre_atlas_skyline_t skyline;
+    if (libre_atlas_skyline(8, 8, &skyline))
+        return -1;
+
+    int status = 0;
+    int expected[4][2] = {{0, 0}, {4, 0}, {0, 4}, {4, 4}};
+    for (int i = 0; i < 4; i++)
+    {
+        int x, y;
+        if (libre_atlas_skyline_pack(&skyline, 4, 4, &x, &y) || x != expected[i][0] || y != expected[i][1])
+            status = -1;
+    }
+
+    // a full area, then segments of equal height merging back into one
+    int x, y;
+    if (skyline.used != 64 || libre_atlas_skyline_pack(&skyline, 1, 1, &x, &y) == 0 || skyline.node_count != 1)
+        status = -1;
+    libre_atlas_skyline_reset(&skyline);
+    if (libre_atlas_skyline_pack(&skyline, 9, 1, &x, &y) == 0 || libre_atlas_skyline_pack(&skyline, 8, 8, &x, &y) || x != 0 || y != 0)
+        status = -1;
+    libre_atlas_skyline_destroy(&skyline);
+
+    // packed rectangles stay inside the area and never overlap
+    int rects[256][4], count = 0;
+    if (libre_atlas_skyline(64, 64, &skyline))
+        return -1;
+    for (int i = 0; i < 256; i++)
+    {
+        int width = 1 + (i * 7919) % 13, height = 1 + (i * 104729) % 11;
+        if (libre_atlas_skyline_pack(&skyline, width, height, &x, &y))
+            continue;
+
+        rects[count][0] = x;
+        rects[count][1] = y;
+        rects[count][2] = width;
+        rects[count][3] = height;
+        count++;
+    }
+
+    long area = 0;
+    for (int i = 0; i < count; i++)
+    {
+        area += (long)rects[i][2] * rects[i][3];
+        if (rects[i][0] < 0 || rects[i][1] < 0 || rects[i][0] + rects[i][2] > 64 || rects[i][1] + rects[i][3] > 64)
+            status = -1;
+        for (int j = 0; j < i; j++)
+            if (rects[i][0] < rects[j][0] + rects[j][2] && rects[j][0] < rects[i][0] + rects[i][2] && rects[i][1] < rects[j][1] + rects[j][3] && rects[j][1] < rects[i][1] + rects[i][3])
+                status = -1;
+    }
+    if (count == 0 || area != skyline.used)
+        status = -1;
+    libre_atlas_skyline_destroy(&skyline);
+
+    if (status)
+        printf("skyline mismatch\n");
+    return status;
+}
+
+static float read_float(const uint8_t *data, size_t offset)
+{
+    float value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+}
+
+static int test_std140(void)
+{
+    libre_mat3_t rotation;
+    libre_mat4_t translation = libre_mat4_translation(1.0f, 2.0f, 3.0f);
+    for (int i = 0; i < 9; i++)
+        rotation.data[i] = (float)i;
+    float weights[2] = {0.25f, 0.75f};
+
+    // float a; vec3 b; float c; mat3 m; vec2 d; float e[2]; mat4 n; int f;
+    uint8_t data[256];
+    memset(data, 0xFF, sizeof(data));
+    libre_opengl_std140_t writer;
+    libre_opengl_std140(&writer, data, sizeof(data));
+    libre_opengl_std140_float(&writer, 1.0f);
+    libre_opengl_std140_vec3(&writer, libre_vec3(2.0f, 3.0f, 4.0f));
+    libre_opengl_std140_float(&writer, 5.0f);
+    libre_opengl_std140_mat3(&writer, &rotation);
+    libre_opengl_std140_vec2(&writer, 6.0f, 7.0f);
+    libre_opengl_std140_float_array(&writer, weights, 2);
+    libre_opengl_std140_mat4(&writer, &translation);
+    libre_opengl_std140_int(&writer, 42);
+
+    int status = 0;
+    int32_t last;
+    memcpy(&last, data + 192, sizeof(last));
+    if (writer.overflow || writer.offset != 196 || last != 42)
+        status = -1;
+    if (read_float(data, 0) != 1.0f || read_float(data, 16) != 2.0f || read_float(data, 24) != 4.0f || read_float(data, 28) != 5.0f)
+        status = -1;
+    if (read_float(data, 80) != 6.0f || read_float(data, 84) != 7.0f || read_float(data, 96) != 0.25f || read_float(data, 112) != 0.75f)
+        status = -1;
+
+    // matrices are stored column by column, every mat3 column padded to a vec4
+    for (int column = 0; column < 3; column++)
+        for (int row = 0; row < 3; row++)
+            if (read_float(data, 32 + column * 16 + row * 4) != rotation.data[row * 3 + column])
+                status = -1;
+    if (read_float(data, 128 + 3 * 16) != 1.0f || read_float(data, 128 + 3 * 16 + 8) != 3.0f || read_float(data, 128 + 12) != 0.0f)
+        status = -1;
+
+    // a value that does not fit is dropped and flagged, smaller ones still fit behind it
+    libre_opengl_std140(&writer, data, 8);
+    libre_opengl_std140_vec3(&writer, libre_vec3(1.0f, 1.0f, 1.0f));
+    if (!writer.overflow || writer.offset != 0)
+        status = -1;
+    libre_opengl_std140_vec2(&writer, 1.0f, 1.0f);
+    if (writer.offset != 8)
+        status = -1;
+
+    if (status)
+        printf("std140 mismatch\n");
+    return status;
+}
+
+static int test_trace_string(void)
+{
+    static const char *names[] = {"draw", "say \"hi\"", "c:\\path", "tab\tline\n", "\x01\x1f", "", NULL};
+    static const char *expected[] = {"\"draw\"", "\"say \\\"hi\\\"\"", "\"c:\\\\path\"", "\"tab\\u0009line\\u000a\"", "\"\\u0001\\u001f\"", "\"\"", "\"\""};
+
+    int status = 0;
+    for (int i = 0; i < 7 && !status; i++)
+    {
+        FILE *file = tmpfile();
+        if (!file)
+            return -1;
+
+        libre_profiler_trace_string(file, names[i]);
+
+        char written[64] = {0};
+        rewind(file);
+        size_t length = fread(written, 1, sizeof(written) - 1, file);
+        fclose(file);
+
+        if (length != strlen(expected[i]) || strcmp(written, expected[i]))
+            status = -1;
+    }
+
+    if (status)
+        printf("trace string mismatch\n");
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    if (test_ktx() || test_dds())
+        return -1;
+
+    if (test_skyline() || test_std140() || test_trace_string())
+        return -1;
+
+    return 0;
+}
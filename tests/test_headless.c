@@ -0,0 +1,986 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <GL/glew.h>
+
+#include <libre/window.h>
+#include <libre/atlas.h>
+#include <libre/opengl.h>
+#include <libre/profiler.h>
+#include <libre/renderer.h>
+#include <libre/texture_loader.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+// runs the gl paths on an offscreen context, machines without egl or a usable driver skip it
+
+static char vertex_source[] = "#version 330 core\nin vec2 position;\nvoid main() {\ngl_Position = vec4(position, 0, 1.0);\n}\n";
+static char fragment_source[] = "#version 330 core\nuniform vec4 color;\nout vec4 frag_color;\nvoid main() {\nfrag_color = color;\n}\n";
+
+static int pixel_is(const uint8_t *pixels, GLsizei width, int x, int y, uint8_t r, uint8_t g, uint8_t b)
+{
+    const uint8_t *pixel = &pixels[((size_t)y * width + x) * 4];
+    return pixel[0] == r && pixel[1] == g && pixel[2] == b;
+}
+
+static int read_framebuffer(libre_window_t window, const libre_opengl_framebuffer_t *framebuffer, uint8_t *pixels)
+{
+    libre_opengl_readback_t readback;
+    GLsizei width = 0, height = 0;
+
+    int status = 0;
+    if (libre_opengl_readback(window, framebuffer->width, framebuffer->height, GL_RGBA, GL_UNSIGNED_BYTE, 2, &readback) || libre_opengl_readback_request(&readback, framebuffer, 0, 0, 0, framebuffer->width, framebuffer->height) || libre_opengl_readback_wait(&readback, pixels, &width, &height) != 1)
+        status = -1;
+    else if (width != framebuffer->width || height != framebuffer->height)
+        status = -1;
+
+    libre_opengl_readback_destroy(&readback);
+    return status;
+}
+
+static int test_framebuffer(libre_window_t window, GLsizei samples)
+{
+    GLenum color_format = GL_RGBA8;
+    libre_opengl_framebuffer_t framebuffer;
+    if (libre_opengl_framebuffer(window, 32, 32, &color_format, 1, GL_DEPTH_COMPONENT24, samples, &framebuffer))
+    {
+        printf("failed to create framebuffer\n");
+        return -1;
+    }
+
+    libre_opengl_shader_t shader;
+    if (libre_opengl_shader(window, vertex_source, fragment_source, &shader))
+    {
+        printf("failed to build shader\n");
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+
+    // the left half of the target
+    float vbo_data[6 * 2] = {-1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 1.0f};
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_update(&vbo, vbo_data, sizeof(vbo_data));
+
+    libre_opengl_vao_t vao = libre_opengl_vao(window);
+    libre_opengl_buffer_object_bind(vbo);
+    libre_opengl_vao_pointer(vao, libre_opengl_shader_attrib_location(shader, "position"), 2, GL_FLOAT, sizeof(float) * 2, 0);
+
+    libre_opengl_framebuffer_bind(&framebuffer);
+    glClearColor(0, 0, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    libre_opengl_shader_use(shader);
+    glUniform4f(libre_opengl_shader_uniform_location(shader, "color"), 0, 1.0f, 0, 1.0f);
+    libre_opengl_vao_bind(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    if (samples > 1)
+        libre_opengl_framebuffer_resolve(&framebuffer);
+
+    int status = 0;
+    uint8_t pixels[32 * 32 * 4];
+    if (read_framebuffer(window, &framebuffer, pixels) || !pixel_is(pixels, 32, 4, 16, 0, 255, 0) || !pixel_is(pixels, 32, 28, 16, 0, 0, 255))
+        status = -1;
+
+    if (status)
+        printf("framebuffer mismatch with %d samples\n", samples);
+
+    libre_opengl_vao_destroy(vao);
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_opengl_shader_destroy(shader);
+    libre_opengl_framebuffer_destroy(&framebuffer);
+    return status;
+}
+
+static int test_buffer_ranges(libre_window_t window)
+{
+    uint8_t expected[320] = {0};
+    libre_opengl_buffer_object_t buffer_object = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_update(&buffer_object, expected, 64);
+
+    // direct updates, growing keeps what was already uploaded
+    uint8_t bytes[16];
+    for (int i = 0; i < 16; i++)
+        bytes[i] = (uint8_t)(i + 1);
+    libre_opengl_buffer_object_update_range(&buffer_object, 8, bytes, 4);
+    libre_opengl_buffer_object_update_range(&buffer_object, 120, bytes, 8);
+    memcpy(&expected[8], bytes, 4);
+    memcpy(&expected[120], bytes, 8);
+
+    // shadowed updates are merged into dirty ranges and only reach gl on flush
+    int status = 0;
+    libre_opengl_buffer_object_shadow(&buffer_object, true);
+    libre_opengl_buffer_object_update_range(&buffer_object, 32, bytes, 4);
+    libre_opengl_buffer_object_update_range(&buffer_object, 36, bytes + 4, 4);
+    libre_opengl_buffer_object_update_range(&buffer_object, 100, bytes, 16);
+    memcpy(&expected[32], bytes, 8);
+    memcpy(&expected[100], bytes, 16);
+    if (buffer_object.dirty_count != 2 || buffer_object.dirty[0].begin != 32 || buffer_object.dirty[0].end != 40)
+        status = -1;
+
+    libre_opengl_buffer_object_update_range(&buffer_object, 300, bytes, 16);
+    memcpy(&expected[300], bytes, 16);
+    libre_opengl_buffer_object_flush(&buffer_object);
+    if (buffer_object.dirty_count != 0 || buffer_object.size != 316)
+        status = -1;
+
+    uint8_t contents[316];
+    libre_opengl_buffer_object_bind(buffer_object);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(contents), contents);
+    if (memcmp(contents, expected, sizeof(contents)))
+        status = -1;
+
+    if (status)
+        printf("buffer range mismatch\n");
+    libre_opengl_buffer_object_destroy(buffer_object);
+    return status;
+}
+
+static void bind_all(libre_opengl_shader_t shader, libre_opengl_vao_t vao, libre_opengl_buffer_object_t vbo)
+{
+    libre_opengl_shader_use(shader);
+    libre_opengl_vao_bind(vao);
+    libre_opengl_buffer_object_bind(vbo);
+}
+
+static int test_state_cache(libre_window_t window)
+{
+    libre_opengl_shader_t shader;
+    if (libre_opengl_shader(window, vertex_source, fragment_source, &shader))
+        return -1;
+    libre_opengl_vao_t vao = libre_opengl_vao(window);
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+
+    // once to get the bindings in place, after that repeats are skipped until the cache is invalidated
+    bind_all(shader, vao, vbo);
+
+    int status = 0;
+    libre_opengl_state_counters_t issued[3], skipped[3];
+    libre_opengl_state_stats(window, &issued[0], &skipped[0]);
+    bind_all(shader, vao, vbo);
+    bind_all(shader, vao, vbo);
+    libre_opengl_state_stats(window, &issued[1], &skipped[1]);
+    libre_opengl_state_invalidate(window);
+    bind_all(shader, vao, vbo);
+    libre_opengl_state_stats(window, &issued[2], &skipped[2]);
+
+    if (skipped[1].programs - skipped[0].programs != 2 || skipped[1].vaos - skipped[0].vaos != 2 || skipped[1].buffers - skipped[0].buffers != 2)
+        status = -1;
+    if (issued[1].programs != issued[0].programs || issued[1].vaos != issued[0].vaos || issued[1].buffers != issued[0].buffers)
+        status = -1;
+    if (issued[2].programs - issued[1].programs != 1 || issued[2].vaos - issued[1].vaos != 1 || issued[2].buffers - issued[1].buffers != 1)
+        status = -1;
+    if (skipped[2].programs != skipped[1].programs || skipped[2].vaos != skipped[1].vaos || skipped[2].buffers != skipped[1].buffers)
+        status = -1;
+
+    if (status)
+        printf("state cache mismatch\n");
+
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_opengl_vao_destroy(vao);
+    libre_opengl_shader_destroy(shader);
+    return status;
+}
+
+static int test_renderer(libre_window_t window)
+{
+    static char vertex_shader[] = "#version 330 core\nlayout(location = 0) in vec3 position;\nlayout(location = 2) in vec4 color;\nout vec4 vertex_color;\nvoid main() {\nvertex_color = color;\ngl_Position = vec4(position, 1.0);\n}\n";
+    static char fragment_shader[] = "#version 330 core\nin vec4 vertex_color;\nout vec4 frag_color;\nvoid main() {\nfrag_color = vertex_color;\n}\n";
+
+    GLenum color_format = GL_RGBA8;
+    libre_opengl_framebuffer_t framebuffer;
+    libre_opengl_shader_t shader;
+    libre_renderer_t renderer;
+    if (libre_opengl_framebuffer(window, 32, 32, &color_format, 1, 0, 1, &framebuffer))
+        return -1;
+    if (libre_opengl_shader(window, vertex_shader, fragment_shader, &shader))
+    {
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+    if (libre_renderer(window, 64, 96, &renderer))
+    {
+        libre_opengl_shader_destroy(shader);
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+
+    // the renderer must leave the element buffer of a vao bound by the application alone
+    GLuint caller_vao, caller_ibo;
+    glGenVertexArrays(1, &caller_vao);
+    glGenBuffers(1, &caller_ibo);
+    glBindVertexArray(caller_vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, caller_ibo);
+    libre_opengl_state_invalidate(window);
+
+    int status = 0;
+    libre_opengl_texture_t texture = {.window = window};
+    uint8_t pixels[32 * 32 * 4];
+    for (int frame = 0; frame < 3 && !status; frame++)
+    {
+        libre_opengl_framebuffer_bind(&framebuffer);
+        glClearColor(0, 0, 0, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // the higher layer is submitted first and still ends up on top
+        libre_renderer_begin(&renderer);
+        libre_renderer_quad(&renderer, 1, shader, texture, -1.0f, -1.0f, 1.0f, 2.0f, 0, 0, 1.0f, 1.0f, 0x00FF00FF);
+        libre_renderer_quad(&renderer, 0, shader, texture, -1.0f, -1.0f, 2.0f, 2.0f, 0, 0, 1.0f, 1.0f, 0xFF0000FF);
+        libre_renderer_stats_t stats = libre_renderer_end(&renderer);
+
+        if (stats.submissions != 2 || stats.draws != 2 || stats.indices != 12)
+            status = -1;
+        if (read_framebuffer(window, &framebuffer, pixels) || !pixel_is(pixels, 32, 4, 16, 0, 255, 0) || !pixel_is(pixels, 32, 28, 16, 255, 0, 0))
+            status = -1;
+    }
+
+    GLint bound = 0;
+    glBindVertexArray(caller_vao);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &bound);
+    if ((GLuint)bound != caller_ibo)
+        status = -1;
+    glBindVertexArray(0);
+    glDeleteBuffers(1, &caller_ibo);
+    glDeleteVertexArrays(1, &caller_vao);
+    libre_opengl_state_invalidate(window);
+
+    if (status)
+        printf("renderer mismatch\n");
+
+    libre_renderer_destroy(&renderer);
+    libre_opengl_shader_destroy(shader);
+    libre_opengl_framebuffer_destroy(&framebuffer);
+    return status;
+}
+
+static char instanced_vertex_shader[] = "#version 330 core\nlayout(location = 0) in vec2 position;\nlayout(location = 1) in vec2 offset;\nvoid main() {\ngl_Position = vec4(position + offset, 0, 1.0);\n}\n";
+static char white_fragment_shader[] = "#version 330 core\nout vec4 frag_color;\nvoid main() {\nfrag_color = vec4(1.0);\n}\n";
+
+static int clear_target(libre_window_t window, libre_opengl_framebuffer_t *framebuffer)
+{
+    GLenum color_format = GL_RGBA8;
+    if (libre_opengl_framebuffer(window, 32, 32, &color_format, 1, 0, 1, framebuffer))
+        return -1;
+
+    libre_opengl_framebuffer_bind(framebuffer);
+    glClearColor(0, 0, 0, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return 0;
+}
+
+// the bottom left and top right quarters are white, the rest stays black
+static int check_quarters(libre_window_t window, const libre_opengl_framebuffer_t *framebuffer)
+{
+    uint8_t pixels[32 * 32 * 4];
+    if (read_framebuffer(window, framebuffer, pixels))
+        return -1;
+
+    if (!pixel_is(pixels, 32, 8, 8, 255, 255, 255) || !pixel_is(pixels, 32, 24, 24, 255, 255, 255))
+        return -1;
+    if (!pixel_is(pixels, 32, 24, 8, 0, 0, 0) || !pixel_is(pixels, 32, 8, 24, 0, 0, 0))
+        return -1;
+
+    return 0;
+}
+
+static int test_instancing(libre_window_t window)
+{
+    libre_opengl_framebuffer_t framebuffer;
+    libre_opengl_shader_t shader;
+    if (clear_target(window, &framebuffer))
+        return -1;
+    if (libre_opengl_shader(window, instanced_vertex_shader, white_fragment_shader, &shader))
+    {
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+
+    float quad[6 * 2] = {-1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f};
+    float offsets[2 * 2] = {0.0f, 0.0f, 1.0f, 1.0f};
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_t instances = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_update(&vbo, quad, sizeof(quad));
+    libre_opengl_buffer_object_update(&instances, offsets, sizeof(offsets));
+
+    libre_opengl_vao_t vao = libre_opengl_vao(window);
+    libre_opengl_buffer_object_bind(vbo);
+    libre_opengl_vao_pointer_ex(vao, 0, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0, 0);
+    libre_opengl_buffer_object_bind(instances);
+    libre_opengl_vao_pointer_ex(vao, 1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 2, 0, 1);
+
+    libre_opengl_shader_use(shader);
+    libre_opengl_draw_arrays_instanced(vao, GL_TRIANGLES, 0, 6, 2);
+
+    int status = check_quarters(window, &framebuffer);
+    if (status)
+        printf("instancing mismatch\n");
+
+    libre_opengl_vao_destroy(vao);
+    libre_opengl_buffer_object_destroy(instances);
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_opengl_shader_destroy(shader);
+    libre_opengl_framebuffer_destroy(&framebuffer);
+    return status;
+}
+
+static int test_indirect(libre_window_t window, bool shadow)
+{
+    static char vertex_shader[] = "#version 330 core\nlayout(location = 0) in vec2 position;\nvoid main() {\ngl_Position = vec4(position, 0, 1.0);\n}\n";
+
+    libre_opengl_framebuffer_t framebuffer;
+    libre_opengl_shader_t shader;
+    if (clear_target(window, &framebuffer))
+        return -1;
+    if (libre_opengl_shader(window, vertex_shader, white_fragment_shader, &shader))
+    {
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+
+    // both quads share the indices, the second command reaches its vertices through base_vertex
+    float vertices[8 * 2] = {-1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    uint32_t indices[6] = {0, 1, 2, 0, 2, 3};
+    libre_opengl_draw_elements_command_t commands[2] = {{6, 1, 0, 0, 0}, {6, 1, 0, 4, 0}};
+
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_t ibo = libre_opengl_buffer_object(window, GL_ELEMENT_ARRAY_BUFFER);
+    libre_opengl_buffer_object_t indirect = libre_opengl_buffer_object(window, GL_DRAW_INDIRECT_BUFFER);
+    libre_opengl_buffer_object_update(&vbo, vertices, sizeof(vertices));
+    libre_opengl_buffer_object_update(&ibo, indices, sizeof(indices));
+    libre_opengl_buffer_object_shadow(&indirect, shadow);
+    libre_opengl_buffer_object_update_range(&indirect, 0, commands, sizeof(commands));
+
+    libre_opengl_vao_t vao = libre_opengl_vao(window);
+    libre_opengl_buffer_object_bind(vbo);
+    libre_opengl_vao_pointer(vao, 0, 2, GL_FLOAT, sizeof(float) * 2, 0);
+    libre_opengl_vao_bind(vao);
+    libre_opengl_buffer_object_bind(ibo);
+
+    libre_opengl_shader_use(shader);
+    int status = 0;
+    if (libre_opengl_multi_draw_elements_indirect(vao, GL_TRIANGLES, GL_UNSIGNED_INT, &indirect, 0, 2, 0) || check_quarters(window, &framebuffer))
+        status = -1;
+
+    // commands past the end of the buffer are refused
+    if (libre_opengl_multi_draw_elements_indirect(vao, GL_TRIANGLES, GL_UNSIGNED_INT, &indirect, sizeof(commands[0]), 2, 0) == 0)
+        status = -1;
+
+    if (status)
+        printf("indirect mismatch%s\n", shadow ? " with a shadow" : "");
+
+    libre_opengl_vao_destroy(vao);
+    libre_opengl_buffer_object_destroy(indirect);
+    libre_opengl_buffer_object_destroy(ibo);
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_opengl_shader_destroy(shader);
+    libre_opengl_framebuffer_destroy(&framebuffer);
+    return status;
+}
+
+static int decode_gradient(void *argument, libre_texture_image_t *image)
+{
+    if (!argument)
+        return -1;
+
+    image->width = 40;
+    image->height = 24;
+    image->pixels = malloc((size_t)image->width * image->height * 4);
+    if (!image->pixels)
+        return -1;
+
+    for (int i = 0; i < image->width * image->height * 4; i++)
+        image->pixels[i] = (uint8_t)(i * 31);
+    return 0;
+}
+
+static int test_texture_loader(libre_window_t window)
+{
+    // a budget below one image splits the upload over several updates
+    libre_texture_loader_t loader;
+    if (libre_texture_loader(window, 1024, &loader))
+        return -1;
+
+    int argument = 1;
+    libre_texture_request_t *request = libre_texture_loader_load(&loader, decode_gradient, &argument, GL_CLAMP_TO_EDGE, GL_NEAREST);
+    libre_texture_request_t *failing = libre_texture_loader_load(&loader, decode_gradient, NULL, GL_CLAMP_TO_EDGE, GL_NEAREST);
+
+    int status = 0, updates = 0;
+    libre_opengl_texture_t texture = {0};
+    while ((libre_texture_loader_poll(request, &texture) == LIBRE_TEXTURE_LOADER_PENDING || libre_texture_loader_poll(failing, NULL) == LIBRE_TEXTURE_LOADER_PENDING) && updates < 1000000)
+    {
+        if (libre_texture_loader_update(&loader) > 1024)
+            status = -1;
+        updates++;
+    }
+
+    if (libre_texture_loader_poll(request, &texture) != LIBRE_TEXTURE_LOADER_DONE || libre_texture_loader_poll(failing, NULL) != LIBRE_TEXTURE_LOADER_FAILED)
+        status = -1;
+    else if (texture.width != 40 || texture.height != 24)
+        status = -1;
+    else
+    {
+        uint8_t expected[40 * 24 * 4], pixels[40 * 24 * 4];
+        for (int i = 0; i < (int)sizeof(expected); i++)
+            expected[i] = (uint8_t)(i * 31);
+
+        libre_opengl_texture_bind(texture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        if (memcmp(pixels, expected, sizeof(pixels)))
+            status = -1;
+        libre_opengl_texture_destroy(texture);
+    }
+
+    if (status)
+        printf("texture loader mismatch\n");
+
+    libre_texture_loader_release(&loader, failing);
+    libre_texture_loader_release(&loader, request);
+    libre_texture_loader_destroy(&loader);
+    return status;
+}
+
+static void put_u32(uint8_t *data, uint32_t value)
+{
+    memcpy(data, &value, sizeof(value));
+}
+
+static int test_texture_files(libre_window_t window)
+{
+    static const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    // a 4x2 rgba8 ktx file with all three levels, every level prefixed with its size
+    uint8_t ktx[64 + 3 * 4 + 32 + 8 + 4] = {0};
+    memcpy(ktx, identifier, sizeof(identifier));
+    uint32_t fields[13] = {0x04030201, GL_UNSIGNED_BYTE, 1, GL_RGBA, GL_RGBA8, GL_RGBA, 4, 2, 0, 0, 1, 3, 0};
+    for (int i = 0; i < 13; i++)
+        put_u32(ktx + 12 + i * 4, fields[i]);
+
+    size_t offset = 64;
+    uint32_t level_sizes[3] = {32, 8, 4};
+    for (int level = 0; level < 3; level++)
+    {
+        put_u32(ktx + offset, level_sizes[level]);
+        offset += 4;
+        for (uint32_t i = 0; i < level_sizes[level]; i++)
+            ktx[offset + i] = (uint8_t)(level * 64 + i);
+        offset += level_sizes[level];
+    }
+
+    int status = 0;
+    libre_opengl_texture_t texture;
+    if (libre_opengl_texture_ktx(window, ktx, sizeof(ktx), GL_CLAMP_TO_EDGE, GL_NEAREST_MIPMAP_NEAREST, &texture) || texture.levels != 3)
+        status = -1;
+    else
+    {
+        uint8_t pixels[8];
+        libre_opengl_texture_bind(texture);
+        glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        if (memcmp(pixels, ktx + 64 + 4 + 32 + 4, sizeof(pixels)))
+            status = -1;
+        libre_opengl_texture_destroy(texture);
+    }
+
+    // a truncated last level leaves nothing behind
+    if (libre_opengl_texture_ktx(window, ktx, sizeof(ktx) - 1, GL_CLAMP_TO_EDGE, GL_NEAREST, &texture) == 0 || texture.id != 0)
+        status = -1;
+
+    // one white dxt1 block, compressed formats need immutable storage
+    if ((GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) && GLEW_EXT_texture_compression_s3tc)
+    {
+        uint8_t dds[128 + 8] = {0};
+        memcpy(dds, "DDS ", 4);
+        put_u32(dds + 4, 124);
+        put_u32(dds + 12, 4);
+        put_u32(dds + 16, 4);
+        put_u32(dds + 80, 0x4);
+        memcpy(dds + 84, "DXT1", 4);
+        put_u32(dds + 128, 0xFFFF);
+
+        if (libre_opengl_texture_dds(window, dds, sizeof(dds), GL_CLAMP_TO_EDGE, GL_NEAREST, &texture) || texture.levels != 1)
+            status = -1;
+        else
+        {
+            uint8_t pixels[4 * 4 * 4], white[4 * 4 * 4];
+            memset(white, 0xFF, sizeof(white));
+            libre_opengl_texture_bind(texture);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            if (memcmp(pixels, white, sizeof(pixels)))
+                status = -1;
+            libre_opengl_texture_destroy(texture);
+        }
+    }
+
+    if (status)
+        printf("texture file mismatch\n");
+    return status;
+}
+
+static int test_atlas(libre_window_t window)
+{
+    libre_atlas_t atlas;
+    if (libre_atlas(window, 64, 64, GL_R8, 1, GL_LINEAR, true, &atlas))
+        return -1;
+
+    static uint8_t image[60 * 60];
+    memset(image, 7, sizeof(image));
+
+    // a removed handle stays dead once its slot is reused
+    int status = 0;
+    int stale = libre_atlas_add(&atlas, 30, 30, image);
+    libre_atlas_remove(&atlas, stale);
+    int handle = libre_atlas_add(&atlas, 30, 30, image);
+    libre_atlas_rect_t uv;
+    if (stale < 0 || handle < 0 || handle == stale || libre_atlas_contains(&atlas, stale) || libre_atlas_uv(&atlas, stale, &uv) == 0)
+        status = -1;
+    libre_atlas_remove(&atlas, stale);
+    if (!libre_atlas_contains(&atlas, handle) || libre_atlas_uv(&atlas, handle, &uv))
+        status = -1;
+
+    // the image and the border repeated into its padding
+    uint8_t texels[64 * 64];
+    libre_opengl_texture_bind(atlas.texture);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    int x = (int)(uv.u0 * 64.0f + 0.5f), y = (int)(uv.v0 * 64.0f + 0.5f);
+    if (x < 1 || y < 1 || texels[y * 64 + x] != 7 || texels[(y - 1) * 64 + x - 1] != 7)
+        status = -1;
+
+    // images used during the current frame are never evicted, even when the atlas is full
+    int handles[16], count = 0;
+    while (count < 16 && (handles[count] = libre_atlas_add(&atlas, 14, 14, image)) >= 0)
+        count++;
+    if (count == 0 || count == 16 || !libre_atlas_contains(&atlas, handle))
+        status = -1;
+    for (int i = 0; i < count; i++)
+        if (!libre_atlas_contains(&atlas, handles[i]))
+            status = -1;
+
+    // a frame later they are, least recently used first
+    libre_atlas_frame(&atlas);
+    int large = libre_atlas_add(&atlas, 60, 60, image);
+    if (large < 0 || libre_atlas_contains(&atlas, handle) || libre_atlas_uv(&atlas, large, &uv))
+        status = -1;
+
+    if (status)
+        printf("atlas mismatch\n");
+    libre_atlas_destroy(&atlas);
+    return status;
+}
+
+static void remove_directory(const char *directory)
+{
+#ifndef _WIN32
+    DIR *dir = opendir(directory);
+    if (!dir)
+        return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)))
+    {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        remove(path);
+    }
+    closedir(dir);
+    rmdir(directory);
+#else
+    (void)directory;
+#endif
+}
+
+static int test_shader_cache(libre_window_t window)
+{
+#ifdef _WIN32
+    // headless contexts come from egl, which windows builds do not use
+    (void)window;
+    return 0;
+#else
+    // a fresh directory every run, so the first build is always a miss that stores and the second a hit
+    char directory[] = "/tmp/libre_shader_cache_XXXXXX";
+    if (!mkdtemp(directory))
+        return -1;
+
+    libre_opengl_shader_cache_t cache;
+    if (libre_opengl_shader_cache(window, directory, &cache))
+    {
+        remove_directory(directory);
+        return -1;
+    }
+
+    int status = 0;
+    libre_opengl_shader_t shaders[2];
+    for (int i = 0; i < 2; i++)
+    {
+        if (libre_opengl_shader_cached(&cache, window, vertex_source, fragment_source, &shaders[i]))
+        {
+            status = -1;
+            shaders[i].id = 0;
+            continue;
+        }
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(shaders[i].id, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE || libre_opengl_shader_uniform_location(shaders[i], "color") < 0 || libre_opengl_shader_attrib_location(shaders[i], "position") < 0)
+            status = -1;
+    }
+
+    libre_opengl_shader_cache_stats_t stats = libre_opengl_shader_cache_stats(&cache);
+    if (cache.supported && (stats.misses != 1 || stats.hits != 1 || stats.stored != 1 || stats.rejected != 0))
+        status = -1;
+
+    if (status)
+        printf("shader cache mismatch\n");
+
+    for (int i = 0; i < 2; i++)
+        if (shaders[i].id)
+            libre_opengl_shader_destroy(shaders[i]);
+    libre_opengl_shader_cache_destroy(&cache);
+    remove_directory(directory);
+    return status;
+#endif
+}
+
+static int test_shader_builds(libre_window_t window)
+{
+    static char broken_shader[] = "#version 330 core\nout vec4 frag_color;\nvoid main() {\nfrag_color = undefined;\n}\n";
+
+    // everything is submitted before the first poll so the driver can compile in parallel
+    libre_opengl_shader_compiler_threads(window, 2);
+    libre_opengl_shader_build_t builds[3];
+    int begun = libre_opengl_shader_build_begin(window, vertex_source, fragment_source, &builds[0]) == 0;
+    begun = begun && libre_opengl_shader_build_begin(window, instanced_vertex_shader, white_fragment_shader, &builds[1]) == 0;
+    begun = begun && libre_opengl_shader_build_begin(window, vertex_source, broken_shader, &builds[2]) == 0;
+    if (!begun)
+    {
+        printf("failed to begin shader builds\n");
+        return -1;
+    }
+
+    int status = 0;
+    libre_opengl_shader_t shaders[2];
+    memset(shaders, 0, sizeof(shaders));
+    for (int i = 0; i < 2; i++)
+        if (libre_opengl_shader_build_wait(&builds[i], &shaders[i]) != LIBRE_OPENGL_SHADER_BUILD_READY || !shaders[i].id)
+            status = -1;
+
+    const char *log = NULL;
+    if (libre_opengl_shader_build_wait(&builds[2], NULL) != LIBRE_OPENGL_SHADER_BUILD_FAILED || !(log = libre_opengl_shader_build_log(&builds[2])) || !log[0])
+        status = -1;
+    if (shaders[0].id && libre_opengl_shader_uniform_location(shaders[0], "color") < 0)
+        status = -1;
+
+    // a finished build keeps answering the same way
+    if (libre_opengl_shader_build_poll(&builds[0], NULL) != LIBRE_OPENGL_SHADER_BUILD_READY)
+        status = -1;
+
+    if (status)
+        printf("shader build mismatch\n");
+
+    for (int i = 0; i < 3; i++)
+        libre_opengl_shader_build_destroy(&builds[i]);
+    for (int i = 0; i < 2; i++)
+        if (shaders[i].id)
+            libre_opengl_shader_destroy(shaders[i]);
+    return status;
+}
+
+static int test_uniform_ring(libre_window_t window)
+{
+    static char vertex_shader[] = "#version 330 core\nlayout(std140) uniform material {\nvec4 color;\nvec2 offset;\n};\nin vec2 position;\nvoid main() {\ngl_Position = vec4(position + offset, 0, 1.0);\n}\n";
+    static char fragment_shader[] = "#version 330 core\nlayout(std140) uniform material {\nvec4 color;\nvec2 offset;\n};\nout vec4 frag_color;\nvoid main() {\nfrag_color = color;\n}\n";
+
+    libre_opengl_framebuffer_t framebuffer;
+    libre_opengl_shader_t shader;
+    libre_opengl_uniform_ring_t ring;
+    GLenum color_format = GL_RGBA8;
+    if (libre_opengl_framebuffer(window, 32, 32, &color_format, 1, 0, 1, &framebuffer))
+        return -1;
+    if (libre_opengl_shader(window, vertex_shader, fragment_shader, &shader) || libre_opengl_shader_block_binding(shader, "material", 1))
+    {
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+    if (libre_opengl_uniform_ring(window, 1024, 2, &ring))
+    {
+        libre_opengl_shader_destroy(shader);
+        libre_opengl_framebuffer_destroy(&framebuffer);
+        return -1;
+    }
+
+    float vbo_data[6 * 2] = {-1.0f, -1.0f, 0.0f, -1.0f, 0.0f, 1.0f, -1.0f, -1.0f, 0.0f, 1.0f, -1.0f, 1.0f};
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_update(&vbo, vbo_data, sizeof(vbo_data));
+    libre_opengl_vao_t vao = libre_opengl_vao(window);
+    libre_opengl_buffer_object_bind(vbo);
+    libre_opengl_vao_pointer(vao, libre_opengl_shader_attrib_location(shader, "position"), 2, GL_FLOAT, sizeof(float) * 2, 0);
+
+    // two pushes per frame for more frames than the ring has, each draw has to see its own block
+    int status = 0;
+    uint8_t pixels[32 * 32 * 4];
+    for (int frame = 0; frame < 4 && !status; frame++)
+    {
+        libre_opengl_framebuffer_bind(&framebuffer);
+        glClearColor(0, 0, 0, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        libre_opengl_uniform_ring_begin(&ring);
+        libre_opengl_shader_use(shader);
+        for (int draw = 0; draw < 2; draw++)
+        {
+            uint8_t block[32];
+            libre_opengl_std140_t writer;
+            libre_opengl_std140(&writer, block, sizeof(block));
+            libre_opengl_std140_vec4(&writer, libre_vec4(draw == 0 ? 1.0f : 0, (float)(frame % 2), draw == 1 ? 1.0f : 0, 1.0f));
+            libre_opengl_std140_vec2(&writer, draw == 0 ? 0 : 1.0f, 0);
+
+            if (writer.overflow || libre_opengl_uniform_ring_push(&ring, 1, block, writer.offset))
+                status = -1;
+            libre_opengl_draw_arrays_instanced(vao, GL_TRIANGLES, 0, 6, 1);
+        }
+        libre_opengl_uniform_ring_end(&ring);
+
+        uint8_t green = frame % 2 ? 255 : 0;
+        if (read_framebuffer(window, &framebuffer, pixels) || !pixel_is(pixels, 32, 4, 16, 255, green, 0) || !pixel_is(pixels, 32, 28, 16, 0, green, 255))
+            status = -1;
+    }
+
+    // a block bigger than a frame region is refused rather than overrunning the next frame
+    static uint8_t oversized[2048];
+    libre_opengl_uniform_ring_begin(&ring);
+    if (libre_opengl_uniform_ring_push(&ring, 1, oversized, sizeof(oversized)) != -1)
+        status = -1;
+    libre_opengl_uniform_ring_end(&ring);
+
+    if (status)
+        printf("uniform ring mismatch\n");
+
+    libre_opengl_vao_destroy(vao);
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_opengl_uniform_ring_destroy(&ring);
+    libre_opengl_shader_destroy(shader);
+    libre_opengl_framebuffer_destroy(&framebuffer);
+    return status;
+}
+
+static int test_profiler(libre_window_t window)
+{
+    static const char path[] = "test_profiler.json";
+
+    libre_profiler_t profiler;
+    if (libre_profiler(window, &profiler))
+        return -1;
+    if (libre_profiler_trace(&profiler, path))
+    {
+        libre_profiler_destroy(&profiler);
+        return -1;
+    }
+
+    float data[16] = {0};
+    libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+
+    // more frames than the ring holds, the ones still pending when the trace closes have to be written too
+    int status = 0;
+    int frames = LIBRE_PROFILER_FRAMES + 2;
+    for (int i = 0; i < frames; i++)
+    {
+        libre_profiler_frame_begin(&profiler);
+        libre_profiler_push(&profiler, "upload", true);
+        libre_opengl_buffer_object_update(&vbo, data, sizeof(data));
+        libre_profiler_pop(&profiler);
+        libre_profiler_frame_end(&profiler);
+        glFinish();
+    }
+
+    const libre_profiler_frame_t *report = libre_profiler_report(&profiler);
+    if (!report || report->scope_count != 1 || strcmp(report->scopes[0].name, "upload") || report->buffer_bytes != sizeof(data))
+        status = -1;
+    else if (report->cpu_end < report->cpu_begin || (report->scopes[0].gpu && report->scopes[0].gpu_end < report->scopes[0].gpu_begin))
+        status = -1;
+
+    if (libre_profiler_trace(&profiler, NULL))
+        status = -1;
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        status = -1;
+    else
+    {
+        char trace[16384];
+        size_t size = fread(trace, 1, sizeof(trace) - 1, file);
+        trace[size] = 0;
+        fclose(file);
+
+        int count = 0;
+        for (const char *c = trace; (c = strstr(c, "\"name\":\"frame\"")); c++)
+            count++;
+        if (count != frames || size < 3 || strcmp(trace + size - 3, "\n]\n"))
+            status = -1;
+    }
+    remove(path);
+
+    if (status)
+        printf("profiler mismatch\n");
+
+    libre_opengl_buffer_object_destroy(vbo);
+    libre_profiler_destroy(&profiler);
+    return status;
+}
+
+static uint64_t buffer_bytes(libre_window_t window)
+{
+    libre_opengl_work_counters_t work = {0};
+    libre_opengl_work_stats(window, &work);
+    return work.buffer_bytes;
+}
+
+static int test_upload_counters(libre_window_t window)
+{
+    libre_matrix_t matrices[2];
+    for (int i = 0; i < 2; i++)
+        if (libre_matrix_create(&matrices[i], 4, 4))
+            return -1;
+
+    // the mapped gather of the matrices has to be counted like any other upload
+    int status = 0;
+    libre_opengl_buffer_object_t mapped = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    uint64_t before = buffer_bytes(window);
+    if (libre_opengl_buffer_object_update_matrices(&mapped, matrices, 2) || buffer_bytes(window) - before != 2 * 16 * sizeof(float))
+        status = -1;
+
+    // growing a shadowed buffer uploads the whole cpu copy again, which leaves nothing for the next flush
+    float data[16] = {0};
+    libre_opengl_buffer_object_t shadowed = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
+    libre_opengl_buffer_object_shadow(&shadowed, true);
+    libre_opengl_buffer_object_update(&shadowed, data, sizeof(data));
+    before = buffer_bytes(window);
+    if (libre_opengl_buffer_object_reserve(&shadowed, 1024) || libre_opengl_buffer_object_flush(&shadowed) || buffer_bytes(window) - before != sizeof(data))
+        status = -1;
+
+    if (status)
+        printf("upload counter mismatch\n");
+
+    libre_opengl_buffer_object_destroy(shadowed);
+    libre_opengl_buffer_object_destroy(mapped);
+    for (int i = 0; i < 2; i++)
+        libre_matrix_destroy(matrices[i]);
+    return status;
+}
+
+static int test_pacer(libre_window_t window)
+{
+    libre_window_pacer_t pacer;
+    double rate = 200.0;
+    int frames = 20;
+    if (libre_window_pacer(window, LIBRE_WINDOW_PACING_UNCAPPED, rate, 2, &pacer))
+        return -1;
+
+    for (int i = 0; i < frames; i++)
+    {
+        glClearColor(0, 0, 0, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        libre_window_pacer_swap(&pacer);
+    }
+
+    // the limiter never finishes early, late frames are only allowed a loose bound since the machine may be busy
+    int status = 0;
+    double period = 1.0 / rate;
+    libre_window_frame_stats_t stats = libre_window_pacer_stats(&pacer);
+    if (stats.count != frames || stats.avg < period * 0.95 || stats.avg > period * 1.5)
+        status = -1;
+    if (stats.min > stats.p99 || stats.p99 > stats.max || stats.min < period * 0.5)
+        status = -1;
+    if (pacer.fence_count > pacer.frames_in_flight)
+        status = -1;
+
+    if (status)
+        printf("pacer mismatch\n");
+
+    libre_window_pacer_destroy(&pacer);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    libre_window_t window;
+    if (libre_window_create_headless(&window, 64, 64))
+    {
+        printf("no headless context, skipping\n");
+        return 0;
+    }
+
+    libre_window_make_current(window);
+
+    GLenum glew = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // a glew built for glx has already loaded the gl entry points when it fails to find an x display
+    if (glew == GLEW_ERROR_NO_GLX_DISPLAY)
+        glew = GLEW_OK;
+#endif
+    if (glew != GLEW_OK)
+    {
+        printf("failed to initialize glew\n");
+        libre_window_destroy(window);
+        return -1;
+    }
+
+    int status = 0;
+    if (test_framebuffer(window, 1) || test_framebuffer(window, 4))
+        status = -1;
+    if (test_buffer_ranges(window) || test_state_cache(window) || test_renderer(window))
+        status = -1;
+    if (test_instancing(window) || test_indirect(window, false) || test_indirect(window, true))
+        status = -1;
+    if (test_texture_loader(window) || test_texture_files(window))
+        status = -1;
+    if (test_atlas(window) || test_shader_cache(window) || test_shader_builds(window))
+        status = -1;
+    if (test_uniform_ring(window) || test_profiler(window) || test_upload_counters(window))
+        status = -1;
+    if (test_pacer(window))
+        status = -1;
+
+    libre_window_destroy(window);
+    return status;
+}
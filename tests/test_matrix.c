@@ -27,9 +27,251 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <libre/matrix.h>
+#include <libre/pool.h>
+#include <libre/quaternion.h>
 
 #include <stddef.h>
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+static void fill(libre_matrix_t matrix)
+{
+    for (int i = 0; i < matrix.rows * matrix.columns; i++)
+        matrix.data[i] = (float)(((unsigned)i * 7919u) % 17u) / 8.0f - 1.0f;
+}
+
+static int compare(libre_matrix_t a, libre_matrix_t b, float tolerance)
+{
+    if (a.rows != b.rows || a.columns != b.columns)
+        return -1;
+
+    for (int i = 0; i < a.rows * a.columns; i++)
+        if (fabsf(a.data[i] - b.data[i]) > tolerance)
+            return -1;
+
+    return 0;
+}
+
+static int test_isa(int rows, int inner, int columns)
+{
+    libre_matrix_t a, b, reference;
+    libre_matrix_create(&a, rows, inner);
+    libre_matrix_create(&b, inner, columns);
+    libre_matrix_create(&reference, rows, columns);
+    fill(a);
+    fill(b);
+
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < columns; j++)
+        {
+            float sum = 0;
+            for (int k = 0; k < inner; k++)
+                sum += LIBRE_MATRIX_GET(a, i, k) * LIBRE_MATRIX_GET(b, k, j);
+            LIBRE_MATRIX_SET(reference, i, j, sum);
+        }
+
+    int isa = libre_matrix_isa();
+
+    int status = 0;
+    int isas[] = {LIBRE_MATRIX_ISA_SCALAR, LIBRE_MATRIX_ISA_SSE, LIBRE_MATRIX_ISA_AVX2, LIBRE_MATRIX_ISA_NEON};
+    for (int i = 0; i < 4 && !status; i++)
+    {
+        if (libre_matrix_set_isa(isas[i]))
+            continue;
+
+        int result;
+        libre_matrix_t product = libre_matrix_multiply(a, b, NULL, &result);
+        if (result || compare(product, reference, 1e-3f * inner))
+        {
+            printf("isa %d mismatch for %dx%d * %dx%d\n", isas[i], rows, inner, inner, columns);
+            status = -1;
+        }
+        libre_matrix_destroy(product);
+    }
+
+    libre_matrix_set_isa(isa);
+
+    libre_matrix_destroy(reference);
+    libre_matrix_destroy(b);
+    libre_matrix_destroy(a);
+    return status;
+}
+
+static int test_pool(int rows, int columns)
+{
+    libre_matrix_t a, b, sum[2], product[2];
+    libre_matrix_create(&a, rows, columns);
+    libre_matrix_create(&b, columns, rows);
+    fill(a);
+    fill(b);
+
+    int result = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        if (i == 1 && libre_pool_init(4))
+            return -1;
+
+        sum[i] = libre_matrix_add(a, a, NULL, &result);
+        libre_matrix_scale(sum[i], 0.75f);
+        product[i] = libre_matrix_multiply(a, b, NULL, &result);
+    }
+    libre_pool_terminate();
+
+    int status = 0;
+    if (memcmp(sum[0].data, sum[1].data, sizeof(float) * rows * columns) || memcmp(product[0].data, product[1].data, sizeof(float) * rows * rows))
+    {
+        printf("pool mismatch for %dx%d\n", rows, columns);
+        status = -1;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        libre_matrix_destroy(product[i]);
+        libre_matrix_destroy(sum[i]);
+    }
+    libre_matrix_destroy(b);
+    libre_matrix_destroy(a);
+    return status;
+}
+
+static int test_batch(int count)
+{
+    libre_mat4_t view_projection = libre_mat4_multiply(libre_mat4_projection_ortho(-2.0f, 2.0f, 1.0f, -1.0f, 0.1f, 10.0f), libre_mat4_rotation(0.9f, 0.1f, 0.3f, 0.2f));
+
+    libre_mat4_t models[64], products[64];
+    float vectors[64 * 4], positions[64 * 3], x[64], y[64], z[64], tx[64], ty[64], tz[64], tw[64];
+    for (int i = 0; i < count; i++)
+    {
+        models[i] = libre_mat4_translation((float)i, -(float)i, 0.5f * i);
+        for (int j = 0; j < 4; j++)
+            vectors[i * 4 + j] = (float)((i * 4 + j) % 7) - 3.0f;
+        for (int j = 0; j < 3; j++)
+            positions[i * 3 + j] = vectors[i * 4 + j];
+        x[i] = vectors[i * 4];
+        y[i] = vectors[i * 4 + 1];
+        z[i] = vectors[i * 4 + 2];
+    }
+
+    int isa = libre_matrix_isa();
+
+    int status = 0;
+    int isas[] = {LIBRE_MATRIX_ISA_SCALAR, LIBRE_MATRIX_ISA_SSE, LIBRE_MATRIX_ISA_AVX2, LIBRE_MATRIX_ISA_NEON};
+    for (int n = 0; n < 4 && !status; n++)
+    {
+        if (libre_matrix_set_isa(isas[n]))
+            continue;
+
+        // chain starts with the shared matrix and is overwritten in place, every element still has to see the original,
+        // models[0] is the identity so the chain starts at models[1]
+        libre_mat4_t chain[64];
+        chain[0] = view_projection;
+
+        float transformed[64 * 4], moved[64 * 3];
+        memcpy(moved, positions, sizeof(float) * count * 3);
+        if (libre_matrix_batch_multiply(view_projection.data, models[0].data, products[0].data, count) ||
+            libre_matrix_batch_multiply(chain[0].data, models[1].data, chain[0].data, count - 1) ||
+            libre_matrix_batch_transform4(view_projection.data, vectors, transformed, count) ||
+            libre_matrix_batch_transform3(view_projection.data, moved, moved, count) ||
+            libre_matrix_batch_transform_soa(view_projection.data, x, y, z, tx, ty, tz, tw, count))
+            status = -1;
+
+        for (int i = 0; i < count && !status; i++)
+        {
+            libre_mat4_t product = libre_mat4_multiply(view_projection, models[i]);
+            libre_vec4_t vector = libre_mat4_transform(view_projection, libre_vec4(vectors[i * 4], vectors[i * 4 + 1], vectors[i * 4 + 2], vectors[i * 4 + 3]));
+            libre_vec4_t position = libre_mat4_transform(view_projection, libre_vec4(x[i], y[i], z[i], 1.0f));
+
+            for (int j = 0; j < 16; j++)
+                if (fabsf(product.data[j] - products[i].data[j]) > 1e-4f || (i > 0 && fabsf(product.data[j] - chain[i - 1].data[j]) > 1e-4f))
+                    status = -1;
+
+            float expected[4] = {vector.x, vector.y, vector.z, vector.w};
+            float expected_position[4] = {position.x, position.y, position.z, position.w};
+            float soa[4] = {tx[i], ty[i], tz[i], tw[i]};
+            for (int j = 0; j < 4; j++)
+                if (fabsf(expected[j] - transformed[i * 4 + j]) > 1e-4f || fabsf(expected_position[j] - soa[j]) > 1e-4f || (j < 3 && fabsf(expected_position[j] - moved[i * 3 + j]) > 1e-4f))
+                    status = -1;
+        }
+
+        if (status)
+            printf("isa %d batch mismatch\n", isas[n]);
+    }
+
+    libre_matrix_set_isa(isa);
+    return status;
+}
+
+static int test_arena(void)
+{
+    libre_arena_t arena;
+    if (libre_arena_create(&arena, 4096))
+        return -1;
+    libre_matrix_set_allocator(&arena.allocator);
+
+    int status = 0;
+    for (int frame = 0; frame < 3 && !status; frame++)
+    {
+        int result;
+        libre_matrix_t translation = libre_matrix_translation(1.0f, 2.0f, 3.0f, &result);
+        libre_matrix_t rotation = libre_matrix_rotation(1.0f, 0.0f, 0.0f, 0.0f, &result);
+        libre_matrix_t product = libre_matrix_multiply(translation, rotation, NULL, &result);
+
+        if (result || (uintptr_t)product.data % LIBRE_ARENA_ALIGNMENT || (unsigned char *)product.data < arena.data || (unsigned char *)product.data >= arena.data + arena.size || LIBRE_MATRIX_GET(product, 2, 3) != 3.0f)
+        {
+            printf("arena mismatch\n");
+            status = -1;
+        }
+
+        libre_matrix_destroy(product);
+        libre_matrix_destroy(rotation);
+        libre_matrix_destroy(translation);
+        libre_arena_reset(&arena);
+    }
+
+    // alignments above the block alignment have to hold for the address, not just the offset
+    libre_arena_alloc(&arena, 1, 1);
+    void *wide = libre_arena_alloc(&arena, 16, 256);
+    if (!status && (!wide || (uintptr_t)wide % 256))
+    {
+        printf("arena alignment mismatch\n");
+        status = -1;
+    }
+
+    libre_matrix_set_allocator(NULL);
+    libre_arena_destroy(&arena);
+    return status;
+}
+
+static int test_quaternion(void)
+{
+    libre_quaternion_t a = libre_quaternion_normalize(libre_quaternion(1.0f, 0.5f, 0.25f, 0.125f));
+    libre_quaternion_t b = libre_quaternion_axis_angle(0.0f, 0.0f, 1.0f, 1.5707963f);
+
+    libre_mat4_t expected = libre_mat4_multiply(libre_mat4_rotation(a.w, a.x, a.y, a.z), libre_mat4_rotation(b.w, b.x, b.y, b.z));
+    libre_mat4_t composed = libre_quaternion_to_mat4(libre_quaternion_multiply(a, b));
+
+    libre_quaternion_t half = libre_quaternion_slerp(libre_quaternion_identity(), b, 0.5f);
+    libre_quaternion_t eighth = libre_quaternion_axis_angle(0.0f, 0.0f, 1.0f, 0.7853982f);
+    libre_vec3_t rotated = libre_quaternion_rotate(b, libre_vec3(1.0f, 0.0f, 0.0f));
+
+    libre_quaternion_t starts[2] = {a, b}, ends[2] = {b, a}, blended[2];
+    float t[2] = {0.25f, 0.75f};
+    libre_quaternion_nlerp_batch(starts, ends, t, blended, 2);
+    libre_quaternion_t single = libre_quaternion_nlerp(a, b, 0.25f);
+
+    int status = 0;
+    for (int i = 0; i < 16; i++)
+        if (fabsf(expected.data[i] - composed.data[i]) > 1e-5f)
+            status = -1;
+    if (fabsf(libre_quaternion_dot(half, eighth) - 1.0f) > 1e-5f || fabsf(rotated.y - 1.0f) > 1e-5f || fabsf(libre_quaternion_dot(single, blended[0]) - 1.0f) > 1e-5f)
+        status = -1;
+
+    if (status)
+        printf("quaternion mismatch\n");
+    return status;
+}
 
 int main(int argc, char **argv)
 {
@@ -67,5 +309,44 @@ int main(int argc, char **argv)
     libre_matrix_destroy(product);
     libre_matrix_destroy(b);
     libre_matrix_destroy(a);
+
+    libre_mat4_t transform = libre_mat4_multiply(libre_mat4_translation(1.0f, 2.0f, 3.0f), libre_mat4_rotation(1.0f, 0.5f, 0.25f, 0.125f));
+
+    libre_matrix_t translation = libre_matrix_translation(1.0f, 2.0f, 3.0f, &result);
+    libre_matrix_t rotation = libre_matrix_rotation(1.0f, 0.5f, 0.25f, 0.125f, &result);
+    product = libre_matrix_multiply(translation, rotation, NULL, &result);
+
+    if (result)
+    {
+        printf("error\n");
+        return -1;
+    }
+
+    libre_mat4_t converted;
+    if (libre_mat4_from_matrix(product, &converted) || memcmp(converted.data, transform.data, sizeof(transform.data)))
+    {
+        printf("mat4 mismatch\n");
+        return -1;
+    }
+
+    libre_matrix_print(product);
+
+    libre_matrix_destroy(product);
+    libre_matrix_destroy(rotation);
+    libre_matrix_destroy(translation);
+
+    if (test_isa(4, 4, 4) || test_isa(37, 29, 41) || test_isa(64, 64, 64) || test_isa(130, 300, 3100))
+        return -1;
+    printf("isa: %d\n", libre_matrix_isa());
+
+    if (test_pool(700, 500))
+        return -1;
+
+    if (test_arena() || test_quaternion())
+        return -1;
+
+    if (test_batch(1) || test_batch(37) || test_batch(64))
+        return -1;
+
     return 0;
 }
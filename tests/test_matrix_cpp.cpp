@@ -0,0 +1,97 @@
+/*
+BSD 2-Clause License
+
+Copyright (c) 2023, Caleb Heydon
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <libre/matrix.hpp>
+
+#include <cmath>
+#include <cstdio>
+
+template <typename A, typename B>
+static bool near(const A &a, const B &b)
+{
+    if (a.rows() != b.rows() || a.columns() != b.columns())
+        return false;
+
+    for (int i = 0; i < a.rows(); i++)
+        for (int j = 0; j < a.columns(); j++)
+            if (std::fabs(a(i, j) - b(i, j)) > 1e-3f)
+                return false;
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    libre_mat4_t projection = libre_mat4_projection_ortho(-2.0f, 2.0f, 1.0f, -1.0f, 0.1f, 10.0f);
+    libre_mat4_t view = libre_mat4_rotation(0.9f, 0.1f, 0.3f, 0.2f);
+    libre_mat4_t model = libre_mat4_translation(1.0f, 2.0f, 3.0f);
+    libre_mat4_t expected = libre_mat4_add(libre_mat4_multiply(libre_mat4_multiply(projection, view), model), libre_mat4_scale(model, 0.5f));
+
+    libre::mat4 p(projection.data), v(view.data), m(model.data);
+    libre::mat4 chain = p * v * m + 0.5f * m;
+    if (!near(chain, libre::mat4(expected.data)))
+    {
+        std::printf("fixed chain mismatch\n");
+        return -1;
+    }
+
+    libre::matrix a(37, 29), b(29, 41), c(37, 41);
+    for (int i = 0; i < 37 * 29; i++)
+        a.data()[i] = (float)(i % 13) / 6.0f - 1.0f;
+    for (int i = 0; i < 29 * 41; i++)
+        b.data()[i] = (float)(i % 7) / 3.0f - 1.0f;
+    for (int i = 0; i < 37 * 41; i++)
+        c.data()[i] = (float)(i % 5);
+
+    int result;
+    libre_matrix_t product = libre_matrix_multiply(a.get(), b.get(), NULL, &result);
+    libre::matrix reference = libre::matrix::adopt(libre_matrix_add(product, c.get(), NULL, &result));
+    libre_matrix_destroy(product);
+
+    libre::matrix fused = a * b + c;
+    libre::matrix scaled = 2.0f * c - c;
+    if (!near(fused, reference) || !near(scaled, c))
+    {
+        std::printf("dynamic chain mismatch\n");
+        return -1;
+    }
+
+    // the destination is also an operand of the product
+    fused = a * b + c;
+    c = a * b + c;
+    libre::mat4 rotated = v;
+    rotated = rotated * rotated;
+    if (!near(c, fused) || !near(rotated, v * v))
+    {
+        std::printf("aliasing mismatch\n");
+        return -1;
+    }
+
+    std::printf("ok\n");
+    return 0;
+}
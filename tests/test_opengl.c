@@ -63,7 +63,7 @@ int main(int argc, char **argv)
     libre_window_center(window);
     libre_window_show(window);
 
-    glfwMakeContextCurrent(window.window);
+    libre_window_make_current(window);
 
     if (glewInit() != GLEW_OK)
     {
@@ -96,10 +96,10 @@ int main(int argc, char **argv)
     ibo_data[5] = 3;
 
     libre_opengl_buffer_object_t vbo = libre_opengl_buffer_object(window, GL_ARRAY_BUFFER);
-    libre_opengl_buffer_object_update(vbo, vbo_data, sizeof(vbo_data));
+    libre_opengl_buffer_object_update(&vbo, vbo_data, sizeof(vbo_data));
 
     libre_opengl_buffer_object_t ibo = libre_opengl_buffer_object(window, GL_ELEMENT_ARRAY_BUFFER);
-    libre_opengl_buffer_object_update(ibo, ibo_data, sizeof(ibo_data));
+    libre_opengl_buffer_object_update(&ibo, ibo_data, sizeof(ibo_data));
 
     libre_opengl_shader_t shader;
     if (libre_opengl_shader(window, "#version 330 core\nin vec2 position;\nvoid main() {\ngl_Position = vec4(position, 0, 1.0);\n}\n", "#version 330 core\nout vec4 frag_color;\nvoid main() {\nfrag_color = vec4(0, 1.0, 0, 1.0);\n}\n", &shader))
@@ -111,14 +111,12 @@ int main(int argc, char **argv)
     libre_opengl_vao_t vao = libre_opengl_vao(window);
     libre_opengl_vao_pointer(vao, libre_opengl_shader_attrib_location(shader, "position"), 2, GL_FLOAT, sizeof(float) * 2, 0);
 
+    libre_window_pacer_t pacer;
+    libre_window_pacer(window, LIBRE_WINDOW_PACING_VSYNC, 0.0, 2, &pacer);
+
     while (!libre_window_should_close(window))
     {
-        glfwMakeContextCurrent(window.window);
-        glfwSwapInterval(1);
-
-        int width, height;
-        glfwGetWindowSize(window.window, &width, &height);
-        glViewport(0, 0, width, height);
+        libre_opengl_framebuffer_bind_default(window);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -129,10 +127,18 @@ int main(int argc, char **argv)
 
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
 
-        libre_window_swap_buffers(window);
+        libre_window_pacer_swap(&pacer);
         libre_window_poll_events();
     }
 
+    libre_window_frame_stats_t frame_stats = libre_window_pacer_stats(&pacer);
+    printf("frame time min: %.2f ms, avg: %.2f ms, p99: %.2f ms\n", frame_stats.min * 1000.0, frame_stats.avg * 1000.0, frame_stats.p99 * 1000.0);
+    libre_window_pacer_destroy(&pacer);
+
+    libre_opengl_state_counters_t issued, skipped;
+    if (!libre_opengl_state_stats(window, &issued, &skipped))
+        printf("state changes issued: %llu, skipped: %llu\n", (unsigned long long)(issued.contexts + issued.programs + issued.vaos + issued.buffers + issued.textures + issued.framebuffers), (unsigned long long)(skipped.contexts + skipped.programs + skipped.vaos + skipped.buffers + skipped.textures + skipped.framebuffers));
+
     libre_opengl_vao_destroy(vao);
     libre_opengl_shader_destroy(shader);
     libre_opengl_buffer_object_destroy(ibo);